@@ -0,0 +1,207 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "APLLSteering.h"
+//#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#include "esp_log.h"
+#include "soc/soc.h"
+#include "soc/rtc.h"
+#include "soc/io_mux_reg.h"
+#include "soc/i2s_struct.h"
+#include "driver/periph_ctrl.h"
+#include "esp_system.h"
+#include <math.h>
+
+static const char* TAG = "APLLSteering";
+
+#ifndef APLL_TASK_PRI
+#define APLL_TASK_PRI 5
+#endif
+
+#ifndef APLL_TASK_CORE
+#define APLL_TASK_CORE 0
+#endif
+
+// the divider is rewritten this often to dither between codes
+#define DITHER_MS       100
+
+#define XTAL_HZ         40000000.0
+// fout = xtal * (4 + sdm2 + sdm1/2^8 + sdm0/2^16) / (2 * (o_div + 2)), vco 350-500MHz
+#define APLL_ODIV       8           // 400MHz / 20 = 20MHz
+#define APLL_HZ         (APLLSteering::OUTPUT_HZ * 2)
+#define VCO_HZ          ((double)APLL_HZ * 2 * (APLL_ODIV + 2))
+// I2S0 MCLK = APLL / 2
+#define I2S_DIV         2
+
+// crystal errors beyond this are not believed
+#define MAX_ERROR       (100.0/1000000.0)
+// weight of a new measurement in the frequency lock
+#define FLL_ALPHA       (1.0/8.0)
+
+// APLL analog registers, from soc/src/esp32/i2c_apll.h which is private to IDF
+#define I2C_APLL            0x6d
+#define I2C_APLL_HOSTID     3
+#define I2C_APLL_SDM_STOP   5
+#define I2C_APLL_DSDM0      8
+#define I2C_APLL_DSDM1      9
+#define APLL_SDM_STOP_VAL_1 0x09
+#define APLL_SDM_STOP_VAL_2 0x49        // rev1 and later
+
+extern "C" void rom_i2c_writeReg(uint8_t block, uint8_t host_id, uint8_t reg_add, uint8_t data);
+
+APLLSteering::APLLSteering(PPS& pps)
+: _pps(&pps)
+{
+}
+
+bool APLLSteering::begin()
+{
+    // rev0 silicon ignores sdm0/sdm1, there is no fraction to steer
+    esp_chip_info_t info;
+    esp_chip_info(&info);
+    if (info.revision == 0)
+    {
+        ESP_LOGW(TAG, "::begin APLL fractional divider not usable on rev0 silicon");
+        return false;
+    }
+
+    _code = (VCO_HZ / XTAL_HZ - 4.0) * 65536.0;
+    apply((uint32_t)_code);
+
+    ESP_LOGI(TAG, "::begin APLL %0.0fHz (vco %0.0fHz) code=%0.0f", (double)APLL_HZ, VCO_HZ, _code);
+
+    periph_module_enable(PERIPH_I2S0_MODULE);
+    I2S0.clkm_conf.clka_en      = 1;    // clock from APLL
+    I2S0.clkm_conf.clkm_div_num = I2S_DIV;
+    I2S0.clkm_conf.clkm_div_b   = 0;
+    I2S0.clkm_conf.clkm_div_a   = 1;
+    I2S0.clkm_conf.clk_en       = 1;
+
+    // CLK_OUT1 (GPIO0) = I2S0 MCLK
+    PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO0_U, FUNC_GPIO0_CLK_OUT1);
+    WRITE_PERI_REG(PIN_CTRL, READ_PERI_REG(PIN_CTRL) & 0xFFFFFFF0);
+
+    ESP_LOGI(TAG, "::begin create APLL task at priority %d core %d", APLL_TASK_PRI, APLL_TASK_CORE);
+    xTaskCreatePinnedToCore(task, "APLL", 2048, this, APLL_TASK_PRI, &_task, APLL_TASK_CORE);
+    return true;
+}
+
+/**
+ * set the GPS PPS the crystal error is measured on, the smoothed error is kept
+ * as both receivers measure the same crystal.
+*/
+void APLLSteering::setReference(PPS& pps)
+{
+    _pps_time = 0;
+    _pps      = &pps;
+}
+
+/**
+ * get the correction in ppm applied to the APLL
+*/
+float APLLSteering::getCorrection()
+{
+    return -_error * 1000000.0;
+}
+
+/**
+ * get the (fractional) divider code being generated
+*/
+float APLLSteering::getCode()
+{
+    return _code;
+}
+
+/**
+ * write the divider code, the dither only moves sdm0/sdm1 so those are written
+ * directly and the full enable (which waits on a calibration) is only done when
+ * the integer part changes.
+*/
+void APLLSteering::apply(uint32_t code)
+{
+    if (_applied == 0 || (code >> 16) != (_applied >> 16))
+    {
+        rtc_clk_apll_enable(true, code & 0xff, (code >> 8) & 0xff, code >> 16, APLL_ODIV);
+    }
+    else
+    {
+        rom_i2c_writeReg(I2C_APLL, I2C_APLL_HOSTID, I2C_APLL_DSDM0, code & 0xff);
+        rom_i2c_writeReg(I2C_APLL, I2C_APLL_HOSTID, I2C_APLL_DSDM1, (code >> 8) & 0xff);
+        rom_i2c_writeReg(I2C_APLL, I2C_APLL_HOSTID, I2C_APLL_SDM_STOP, APLL_SDM_STOP_VAL_1);
+        rom_i2c_writeReg(I2C_APLL, I2C_APLL_HOSTID, I2C_APLL_SDM_STOP, APLL_SDM_STOP_VAL_2);
+    }
+    _applied = code;
+}
+
+void APLLSteering::task(void* data)
+{
+    APLLSteering* apll = static_cast<APLLSteering*>(data);
+    ESP_LOGI(TAG, "::task - starting!");
+    TickType_t wake = xTaskGetTickCount();
+    while (true)
+    {
+        apll->process();
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(DITHER_MS));
+    }
+}
+
+/**
+ * once a second fold the crystal error measured on the PPS into the divider
+ * code, every call pick the code that keeps the average on the fraction.
+*/
+void APLLSteering::process()
+{
+    PPS*   pps = _pps;
+    time_t now = pps->getSeconds();
+    if (now != _pps_time)
+    {
+        _pps_time = now;
+        double ticks = pps->getTicksPerSecond();
+        if (ticks != 0.0)
+        {
+            double error = ticks / MicroSecondTimer::TICKS_PER_SEC - 1.0;
+            if (fabs(error) < MAX_ERROR)
+            {
+                _error += (error - _error) * FLL_ALPHA;
+                _code   = (VCO_HZ / (XTAL_HZ * (1.0 + _error)) - 4.0) * 65536.0;
+                ESP_LOGD(TAG, "::process error=%0.3fppm code=%0.3f", _error * 1000000.0, _code);
+            }
+        }
+    }
+
+    // first order sigma-delta, the accumulated fraction selects floor or ceil
+    double   whole = floor(_code);
+    uint32_t code  = (uint32_t)whole;
+    _dither += _code - whole;
+    if (_dither >= 1.0)
+    {
+        _dither -= 1.0;
+        code    += 1;
+    }
+    if (code != _applied)
+    {
+        apply(code);
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _APLL_STEERING_H
+#define _APLL_STEERING_H
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "PPS.h"
+
+//
+// Steer the audio PLL to GPS and output it as a frequency standard.  The APLL
+// runs from the same crystal as APB (and so our timer) so the crystal error
+// measured on the GPS PPS interval is removed from the APLL fractional divider.
+// The divider step is about 1.5ppm so the code is dithered (first order
+// sigma-delta) to get the average frequency right.
+//
+// The output is APLL -> I2S0 MCLK -> CLK_OUT1 which is only on GPIO0.  The
+// timer groups can only be clocked from APB so this does not discipline
+// MicroSecondTimer, the software scaling in PPS still does that.
+//
+class APLLSteering
+{
+public:
+    static const uint32_t OUTPUT_HZ = 10000000;
+
+    explicit APLLSteering(PPS& pps);
+    bool  begin();
+    void  setReference(PPS& pps);
+    float getCorrection();  // ppm
+    float getCode();        // fractional divider in 1/65536 units
+
+private:
+    PPS*         _pps;
+    TaskHandle_t _task          = nullptr;
+    time_t       _pps_time      = 0;
+    double       _error         = 0.0;  // crystal frequency error, smoothed
+    double       _code          = 0.0;  // desired divider code
+    double       _dither        = 0.0;  // sigma-delta accumulator
+    uint32_t     _applied       = 0;    // divider code last written
+
+    void process();
+    void apply(uint32_t code);
+    static void task(void* data);
+};
+
+#endif // _APLL_STEERING_H
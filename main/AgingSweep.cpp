@@ -0,0 +1,311 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "AgingSweep.h"
+#include <math.h>
+#include <string.h>
+
+// register steps from the center, each is measured above then below the center
+static const int8_t steps[] = {0, 20, -20, 40, -40, 60, -60, 80, -80};
+
+// seconds at each point, the first SETTLE are not used for the slope.  A point is
+// cut short as soon as the phase moves more than MOVE_MAX us so the RTC never gets
+// far enough off to force a time correction, it is dropped if that leaves less than
+// MIN_FIT/2 seconds of fit.
+#define DWELL    90
+#define SETTLE   20
+#define MIN_FIT  20
+#define MOVE_MAX 200.0
+
+// minimum points and plausible gain range for a valid characterisation
+#define MIN_POINTS 5
+#define GAIN_MIN   0.01
+#define GAIN_MAX   1.0
+
+AgingSweep::AgingSweep()
+{
+    memset(&_result, 0, sizeof(_result));
+}
+
+void AgingSweep::start(float center, float offset, uint32_t now)
+{
+    _center = round(center);
+    _reason = "";
+    _points = 0;
+    for (uint32_t i = 0; i < sizeof(steps)/sizeof(steps[0]) && _points < MAX_POINTS; ++i)
+    {
+        float aging = _center + steps[i];
+        if (aging >= -127 && aging <= 127)
+        {
+            _aging[_points++] = aging;
+        }
+    }
+    _point = 0;
+    _state = RUNNING;
+    _start = now;
+    _first = offset;
+    _n     = 0;
+    _st    = 0;
+    _sx    = 0;
+    _stt   = 0;
+    _stx   = 0;
+}
+
+void AgingSweep::abort()
+{
+    if (_state == RUNNING)
+    {
+        _reason = "aborted";
+        _state  = FAILED;
+    }
+}
+
+float AgingSweep::output() const
+{
+    return _point < _points ? _aging[_point] : _center;
+}
+
+/**
+ * the next point starts from the offset the last one ended on
+*/
+void AgingSweep::nextPoint(float offset, uint32_t now)
+{
+    _point += 1;
+    _start  = now;
+    _first  = offset;
+    _n      = 0;
+    _st     = 0;
+    _sx     = 0;
+    _stt    = 0;
+    _stx    = 0;
+}
+
+/**
+ * the phase moved too fast to measure the current point, leave it out of the fit
+*/
+void AgingSweep::dropPoint(float offset, uint32_t now)
+{
+    for (uint32_t i = _point; i + 1 < _points; ++i)
+    {
+        _aging[i] = _aging[i+1];
+    }
+    _points -= 1;
+    _point  -= 1;
+    nextPoint(offset, now);
+}
+
+/**
+ * feed the offset (us) for this interval, returns the aging output to apply
+*/
+float AgingSweep::update(float offset, uint32_t now)
+{
+    if (_state != RUNNING)
+    {
+        return _center;
+    }
+
+    uint32_t t = now - _start;
+    if (t >= SETTLE)
+    {
+        _n   += 1;
+        _st  += t;
+        _sx  += offset;
+        _stt += (double)t*t;
+        _stx += t*(double)offset;
+    }
+
+    bool moved = fabs(offset - _first) > MOVE_MAX;
+    if (t < DWELL && !moved)
+    {
+        return output();
+    }
+
+    double d = _n*_stt - _st*_st;
+    if (_n < MIN_FIT/2 || d == 0)
+    {
+        if (!moved)
+        {
+            _reason = "no offset samples";
+            _state  = FAILED;
+            return _center;
+        }
+        dropPoint(offset, now);
+    }
+    else
+    {
+        _slope[_point] = (_n*_stx - _st*_sx) / d;
+        nextPoint(offset, now);
+    }
+
+    if (_point < _points)
+    {
+        return output();
+    }
+
+    if (!fit())
+    {
+        _state = FAILED;
+        return _center;
+    }
+    _state = DONE;
+    return _center;
+}
+
+/**
+ * least squares fit of slope = freq + gain*x + curve*x^2 with x = aging - center
+*/
+bool AgingSweep::fit()
+{
+    if (_points < MIN_POINTS)
+    {
+        _reason = "too few points";
+        return false;
+    }
+
+    // normal equations, A is symmetric with A[i][j] = sum(x^(i+j))
+    double s[5] = {0};
+    double r[3] = {0};
+    for (uint32_t i = 0; i < _points; ++i)
+    {
+        double x  = _aging[i] - _center;
+        double xp = 1;
+        for (int k = 0; k < 5; ++k)
+        {
+            s[k] += xp;
+            if (k < 3)
+            {
+                r[k] += xp * _slope[i];
+            }
+            xp *= x;
+        }
+    }
+    double A[3][4] = {
+        {s[0], s[1], s[2], r[0]},
+        {s[1], s[2], s[3], r[1]},
+        {s[2], s[3], s[4], r[2]},
+    };
+    for (int col = 0; col < 3; ++col)
+    {
+        int pivot = col;
+        for (int row = col+1; row < 3; ++row)
+        {
+            if (fabs(A[row][col]) > fabs(A[pivot][col]))
+            {
+                pivot = row;
+            }
+        }
+        if (fabs(A[pivot][col]) < 1e-12)
+        {
+            _reason = "singular fit";
+            return false;
+        }
+        for (int k = 0; k < 4; ++k)
+        {
+            double tmp  = A[col][k];
+            A[col][k]   = A[pivot][k];
+            A[pivot][k] = tmp;
+        }
+        for (int row = 0; row < 3; ++row)
+        {
+            if (row == col)
+            {
+                continue;
+            }
+            double f = A[row][col] / A[col][col];
+            for (int k = col; k < 4; ++k)
+            {
+                A[row][k] -= f * A[col][k];
+            }
+        }
+    }
+
+    _result.version = VERSION;
+    _result.center  = _center;
+    _result.freq    = A[0][3] / A[0][0];
+    _result.gain    = A[1][3] / A[1][1];
+    _result.curve   = A[2][3] / A[2][2];
+    _result.points  = _points;
+
+    double sq = 0;
+    for (uint32_t i = 0; i < _points; ++i)
+    {
+        double x = _aging[i] - _center;
+        double e = _slope[i] - (_result.freq + _result.gain*x + _result.curve*x*x);
+        sq += e*e;
+    }
+    _result.residual = sqrt(sq / _points);
+
+    if (!isValid(_result))
+    {
+        _reason = "gain out of range";
+        return false;
+    }
+    return true;
+}
+
+bool AgingSweep::isValid(const Result& result)
+{
+    return result.version == VERSION
+        && result.points >= MIN_POINTS
+        && result.gain >= GAIN_MIN
+        && result.gain <= GAIN_MAX;
+}
+
+/**
+ * the aging value where the fitted frequency is zero, from the gain at the center
+*/
+float AgingSweep::getZero(const Result& result)
+{
+    return result.center - result.freq / result.gain;
+}
+
+/**
+ * the gain (ppm per LSB) of the fitted model at an aging value
+*/
+float AgingSweep::getGain(const Result& result, float aging)
+{
+    float gain = result.gain + 2 * result.curve * (aging - result.center);
+    if (gain < GAIN_MIN)
+    {
+        gain = GAIN_MIN;
+    }
+    return gain;
+}
+
+const char* AgingSweep::getStateName(State state)
+{
+    switch (state)
+    {
+        case IDLE:
+            return "idle";
+        case RUNNING:
+            return "running";
+        case DONE:
+            return "done";
+        case FAILED:
+            return "failed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _AGING_SWEEP_H
+#define _AGING_SWEEP_H
+
+#include <stdint.h>
+
+//
+// Characterisation of the DS3231 aging register.  The register is stepped to a
+// set of values around the steady state value, alternating above and below it so
+// the RTC phase walks back and forth instead of away, and at each one the RTC
+// frequency is measured from the slope of the offset.  A quadratic fit of
+// frequency against the register value gives the per unit gain (ppm per LSB) and
+// its nonlinearity.  Called once per PID interval, no ESP-IDF dependencies.
+//
+class AgingSweep
+{
+public:
+    enum State
+    {
+        IDLE = 0,
+        RUNNING,
+        DONE,
+        FAILED,
+    };
+
+    static const uint32_t VERSION    = 1;
+    static const uint32_t MAX_POINTS = 9;
+
+    // fitted model: frequency(ppm) = freq + gain*(u-center) + curve*(u-center)^2
+    struct Result
+    {
+        uint32_t version;
+        float    center;     // aging value the fit is centered on
+        float    freq;       // RTC frequency error at center, ppm
+        float    gain;       // ppm per LSB at center
+        float    curve;      // ppm per LSB^2
+        float    residual;   // RMS fit error, ppm
+        uint32_t points;
+    };
+
+    AgingSweep();
+    void  start(float center, float offset, uint32_t now);
+    void  abort();
+    float update(float offset, uint32_t now);
+    bool  isRunning() const  { return _state == RUNNING; }
+    State getState() const   { return _state; }
+    const char* getReason() const { return _reason; }
+    uint32_t getPoint() const { return _point; }
+    const Result& getResult() const { return _result; }
+
+    static bool  isValid(const Result& result);
+    static float getGain(const Result& result, float aging);
+    static float getZero(const Result& result);
+    static const char* getStateName(State state);
+
+private:
+    State       _state  = IDLE;
+    const char* _reason = "";
+    Result      _result;
+    float       _center = 0;
+    uint32_t    _point  = 0;     // index of the current point
+    uint32_t    _points = 0;     // number of points to measure
+    uint32_t    _start  = 0;     // start of the current point
+    float       _first  = 0;     // offset at the start of the current point
+    float       _aging[MAX_POINTS];
+    float       _slope[MAX_POINTS];
+    double      _n, _st, _sx, _stt, _stx;
+
+    float output() const;
+    void  nextPoint(float offset, uint32_t now);
+    void  dropPoint(float offset, uint32_t now);
+    bool  fit();
+};
+
+#endif // _AGING_SWEEP_H
@@ -0,0 +1,223 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "ClockKalman.h"
+#include <math.h>
+
+// default process noise, white phase noise (us^2/s), random walk frequency
+// noise (ppm^2/s) and random walk aging for a TCXO like the DS3231
+#define Q_PHASE 0.01
+#define Q_FREQ  1.0e-4
+#define Q_AGING 1.0e-12
+
+// initial uncertainty of the frequency (ppm) and aging (ppm/s)
+#define P_FREQ  4.0
+#define P_AGING 1.0e-10
+
+// innovations larger than GATE standard deviations are treated as outliers, but
+// after GATE_RUN in a row the clock is assumed to have really stepped
+#define GATE     5.0
+#define GATE_RUN 3
+
+// the process noise is scaled up or down to keep the average normalised innovation
+// squared near 1, NIS_ALPHA is the averaging and Q_SCALE_MIN/MAX limit the scale
+#define NIS_ALPHA   (1.0/64.0)
+#define Q_SCALE_MIN 0.1
+#define Q_SCALE_MAX 100.0
+
+ClockKalman::ClockKalman(float gain, bool aging)
+: _gain(gain),
+  _states(aging ? 3 : 2)
+{
+    setProcessNoise(Q_PHASE, Q_FREQ, Q_AGING);
+}
+
+void ClockKalman::setProcessNoise(float q_phase, float q_freq, float q_aging)
+{
+    _q[0] = q_phase;
+    _q[1] = q_freq;
+    _q[2] = q_aging;
+}
+
+/**
+ * start the model from a measured phase, the frequency is not known yet so its
+ * variance is wide enough that the first few updates can pull it in.
+*/
+void ClockKalman::reset(float phase, float frequency)
+{
+    for (int i = 0; i < STATES; ++i)
+    {
+        _x[i] = 0;
+        for (int j = 0; j < STATES; ++j)
+        {
+            _P[i][j] = 0;
+        }
+    }
+    _x[0]         = phase;
+    _x[1]         = frequency;
+    _P[0][0]      = 1.0;
+    _P[1][1]      = P_FREQ;
+    _P[2][2]      = _states > 2 ? P_AGING : 0;
+    _q_scale      = 1.0;
+    _nis          = 1.0;
+    _innovation   = 0;
+    _rejected_run = 0;
+    _valid        = true;
+}
+
+/**
+ * propagate the state dt seconds with the aging register at control.
+ *   phase += dt*(freq + gain*control) + dt^2/2*aging
+ *   freq  += dt*aging
+*/
+void ClockKalman::predict(float control, float dt)
+{
+    float F[STATES][STATES] = {
+        {1, dt, dt*dt/2},
+        {0, 1,  dt},
+        {0, 0,  1},
+    };
+
+    float x[STATES] = {0};
+    for (int i = 0; i < _states; ++i)
+    {
+        for (int j = 0; j < _states; ++j)
+        {
+            x[i] += F[i][j] * _x[j];
+        }
+    }
+    x[0] += dt * _gain * control;
+
+    // P = F*P*F' + Q
+    float FP[STATES][STATES] = {{0}};
+    for (int i = 0; i < _states; ++i)
+    {
+        for (int j = 0; j < _states; ++j)
+        {
+            for (int k = 0; k < _states; ++k)
+            {
+                FP[i][j] += F[i][k] * _P[k][j];
+            }
+        }
+    }
+    for (int i = 0; i < _states; ++i)
+    {
+        _x[i] = x[i];
+        for (int j = 0; j < _states; ++j)
+        {
+            float v = 0;
+            for (int k = 0; k < _states; ++k)
+            {
+                v += FP[i][k] * F[j][k];
+            }
+            _P[i][j] = v;
+        }
+        _P[i][i] += _q[i] * _q_scale * dt;
+    }
+}
+
+/**
+ * advance the model dt seconds and fold in a measured offset (us) with the given
+ * measurement variance (us^2).  control is the aging value that was in effect over
+ * the interval.  Returns false if the measurement was rejected as an outlier.
+ * After invalidate() (a phase step) the model restarts from the offset but keeps
+ * the frequency it had learned.
+*/
+bool ClockKalman::update(float offset, float variance, float control, float dt)
+{
+    if (!_valid)
+    {
+        reset(offset, _x[1]);
+        return true;
+    }
+
+    predict(control, dt);
+
+    float S     = _P[0][0] + variance;
+    _innovation = offset - _x[0];
+    float nis   = _innovation * _innovation / S;
+
+    if (nis > GATE*GATE && ++_rejected_run <= GATE_RUN)
+    {
+        _rejected += 1;
+        return false;
+    }
+    _rejected_run = 0;
+
+    // adapt the process noise so the innovations match their predicted variance
+    _nis += (nis - _nis) * NIS_ALPHA;
+    if (_nis > 2.0 && _q_scale < Q_SCALE_MAX)
+    {
+        _q_scale *= 1.05;
+    }
+    else if (_nis < 0.5 && _q_scale > Q_SCALE_MIN)
+    {
+        _q_scale *= 0.95;
+    }
+
+    // H = [1 0 0] so K = P(:,0)/S and P = (I - K*H)*P
+    float K[STATES];
+    for (int i = 0; i < _states; ++i)
+    {
+        K[i] = _P[i][0] / S;
+    }
+    for (int i = 0; i < _states; ++i)
+    {
+        _x[i] += K[i] * _innovation;
+    }
+    float P0[STATES];
+    for (int j = 0; j < _states; ++j)
+    {
+        P0[j] = _P[0][j];
+    }
+    for (int i = 0; i < _states; ++i)
+    {
+        for (int j = 0; j < _states; ++j)
+        {
+            _P[i][j] -= K[i] * P0[j];
+        }
+    }
+    return true;
+}
+
+/**
+ * the aging value that cancels the estimated frequency error and removes the
+ * phase error to target over tau seconds.  The result is not rounded or clamped.
+*/
+float ClockKalman::getControl(float target, float tau) const
+{
+    float freq = (target - _x[0]) / tau - _x[1] - _x[2] * tau / 2;
+    return freq / _gain;
+}
+
+float ClockKalman::getPhaseStdDev() const
+{
+    return sqrt(_P[0][0] > 0 ? _P[0][0] : 0);
+}
+
+float ClockKalman::getFrequencyStdDev() const
+{
+    return sqrt(_P[1][1] > 0 ? _P[1][1] : 0);
+}
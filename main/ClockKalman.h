@@ -0,0 +1,79 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _CLOCK_KALMAN_H
+#define _CLOCK_KALMAN_H
+
+#include <stdint.h>
+
+//
+// Kalman filter model of the RTC clock against GPS.  The state is the phase
+// offset in microseconds, the natural frequency error of the RTC in microseconds
+// per second (ppm) and optionally the aging rate of that frequency error in ppm
+// per second.  The DS3231 aging register is the control input, each LSB moves the
+// frequency by gain ppm.  Like PPSModel it has no ESP-IDF dependencies so a
+// recorded offset log can be replayed through it on a host.
+//
+class ClockKalman
+{
+public:
+    static const int STATES = 3;
+
+    ClockKalman(float gain, bool aging = false);
+    void  reset(float phase, float frequency = 0.0);
+    void  invalidate() { _valid = false; }
+    void  adjustFrequency(float delta) { _x[1] += delta; }
+    void  setGain(float gain) { _gain = gain; }
+    bool  update(float offset, float variance, float control, float dt);
+    float getControl(float target, float tau) const;
+    void  setProcessNoise(float q_phase, float q_freq, float q_aging);
+
+    bool     isValid() const       { return _valid; }
+    float    getPhase() const      { return _x[0]; }
+    float    getFrequency() const  { return _x[1]; }
+    float    getAging() const      { return _x[2]; }
+    float    getInnovation() const { return _innovation; }
+    float    getPhaseStdDev() const;
+    float    getFrequencyStdDev() const;
+    float    getNoiseScale() const { return _q_scale; }
+    uint32_t getRejected() const   { return _rejected; }
+
+private:
+    float    _gain;
+    int      _states;
+    bool     _valid          = false;
+    float    _x[STATES]      = {0};
+    float    _P[STATES][STATES] = {{0}};
+    float    _q[STATES];
+    float    _q_scale        = 1.0;
+    float    _nis            = 1.0;  // average normalised innovation squared
+    float    _innovation     = 0.0;
+    uint32_t _rejected       = 0;
+    uint32_t _rejected_run   = 0;
+
+    void predict(float control, float dt);
+};
+
+#endif // _CLOCK_KALMAN_H
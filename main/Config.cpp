@@ -31,8 +31,20 @@ static const char* KEY_WIFI_SSID = "wifi_ssid";
 static const char* KEY_WIFI_PASS = "wifi_pass";
 static const char* KEY_BIAS      = "bias";
 static const char* KEY_TARGET    = "target";
+static const char* KEY_ENGINE    = "engine";
+static const char* KEY_KP        = "kp";
+static const char* KEY_KI        = "ki";
+static const char* KEY_KD        = "kd";
+
+// PID gains until they are tuned
+#define DEFAULT_KP 3.2
+#define DEFAULT_KI 0.1
+#define DEFAULT_KD 0.8
 
 Config::Config()
+: _kp(DEFAULT_KP),
+  _ki(DEFAULT_KI),
+  _kd(DEFAULT_KD)
 {
     setWiFiSSID("");
     setWiFiPassword("");
@@ -138,6 +150,58 @@ float Config::getFloat(const char* key, float def_value)
     return value;
 }
 
+/**
+ * read a fixed size blob stored by setBlob, fails if it is missing or the size differs
+*/
+bool Config::getBlob(const char* key, void* value, size_t size)
+{
+    size_t len;
+    esp_err_t err = nvs_get_blob(_nvs, key, nullptr, &len);
+    if (err != ESP_OK)
+    {
+        return false;
+    }
+    if (len != size)
+    {
+        ESP_LOGE(TAG, "wrong size for value of '%s' %d != %d", key, len, size);
+        return false;
+    }
+    err = nvs_get_blob(_nvs, key, value, &len);
+    return err == ESP_OK;
+}
+
+/**
+ * write and commit a blob, this is for state that is saved by the application
+ * itself rather than by the SAVE button.
+*/
+bool Config::setBlob(const char* key, const void* value, size_t size)
+{
+    esp_err_t err = nvs_set_blob(_nvs, key, value, size);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::setBlob failed to set '%s': %d (%s)", key, err, esp_err_to_name(err));
+        return false;
+    }
+    err = nvs_commit(_nvs);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::setBlob failed to commit '%s': %d (%s)", key, err, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+uint8_t Config::getUInt8(const char* key, uint8_t def_value)
+{
+    uint8_t value;
+    esp_err_t err = nvs_get_u8(_nvs, key, &value);
+    if (err != ESP_OK)
+    {
+        return def_value;
+    }
+    return value;
+}
+
 bool Config::load()
 {
     ESP_LOGI(TAG, "::load()");
@@ -157,7 +221,14 @@ bool Config::load()
 
     _target = getFloat(KEY_TARGET);
 
-    ESP_LOGI(TAG, "::load: ssid=%s pass=%s bias=%0f target=%0f", _wifi_ssid, _wifi_pass, _bias, _target);
+    _engine = getUInt8(KEY_ENGINE);
+
+    _kp = getFloat(KEY_KP, DEFAULT_KP);
+    _ki = getFloat(KEY_KI, DEFAULT_KI);
+    _kd = getFloat(KEY_KD, DEFAULT_KD);
+
+    ESP_LOGI(TAG, "::load: ssid=%s pass=%s bias=%0f target=%0f engine=%u kp=%0f ki=%0f kd=%0f",
+                  _wifi_ssid, _wifi_pass, _bias, _target, _engine, _kp, _ki, _kd);
     return true;
 }
 
@@ -189,6 +260,30 @@ bool Config::save()
         ESP_LOGE(TAG, "::save failed to set '%s=%f': %d (%s)", KEY_TARGET, _target, err, esp_err_to_name(err));
         ret = false;
     }
+    err = nvs_set_u8(_nvs, KEY_ENGINE, _engine);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::save failed to set '%s=%u': %d (%s)", KEY_ENGINE, _engine, err, esp_err_to_name(err));
+        ret = false;
+    }
+    err = nvs_set_blob(_nvs, KEY_KP, &_kp, sizeof(_kp));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::save failed to set '%s=%f': %d (%s)", KEY_KP, _kp, err, esp_err_to_name(err));
+        ret = false;
+    }
+    err = nvs_set_blob(_nvs, KEY_KI, &_ki, sizeof(_ki));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::save failed to set '%s=%f': %d (%s)", KEY_KI, _ki, err, esp_err_to_name(err));
+        ret = false;
+    }
+    err = nvs_set_blob(_nvs, KEY_KD, &_kd, sizeof(_kd));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::save failed to set '%s=%f': %d (%s)", KEY_KD, _kd, err, esp_err_to_name(err));
+        ret = false;
+    }
     return ret;
 }
 
@@ -247,3 +342,43 @@ float Config::getTarget()
 {
     return _target;
 }
+
+void Config::setEngine(uint8_t engine)
+{
+    _engine = engine;
+}
+
+uint8_t Config::getEngine()
+{
+    return _engine;
+}
+
+void Config::setKp(float kp)
+{
+    _kp = kp;
+}
+
+float Config::getKp()
+{
+    return _kp;
+}
+
+void Config::setKi(float ki)
+{
+    _ki = ki;
+}
+
+float Config::getKi()
+{
+    return _ki;
+}
+
+void Config::setKd(float kd)
+{
+    _kd = kd;
+}
+
+float Config::getKd()
+{
+    return _kd;
+}
@@ -45,15 +45,31 @@ public:
     float getBias();
     void setTarget(float target);
     float getTarget();
+    void setEngine(uint8_t engine);
+    uint8_t getEngine();
+    void setKp(float kp);
+    float getKp();
+    void setKi(float ki);
+    float getKi();
+    void setKd(float kd);
+    float getKd();
+
+    bool getBlob(const char* key, void* value, size_t size);
+    bool setBlob(const char* key, const void* value, size_t size);
 private:
     nvs_handle_t _nvs;
     char*        _wifi_ssid = nullptr;
     char*        _wifi_pass = nullptr;
     float        _bias = 0.0;
     float        _target = 10.0;
+    uint8_t      _engine = 0;
+    float        _kp;
+    float        _ki;
+    float        _kd;
     char* getString(const char* key, const char* def_value = "");
     void  getString(const char* key, const char** valuep, const char* def_value = "");
     float getFloat(const char* key, float def_value = 0.0);
+    uint8_t getUInt8(const char* key, uint8_t def_value = 0);
     char* copyString(const char* str);
 };
 
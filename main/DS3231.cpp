@@ -67,7 +67,12 @@ bool DS3231::begin()
     ESP_LOGI(TAG, "status:  0x%02x", data[STATUS]);
     ESP_LOGI(TAG, "aging:   %d",     (int8_t)data[AGEOFFSET]);
 
-    _age_offset = (int8_t)data[AGEOFFSET];
+    _age_offset  = (int8_t)data[AGEOFFSET];
+    _osc_stopped = (data[STATUS] & OSC_STOP_FLAG) != 0;
+    if (_osc_stopped)
+    {
+        ESP_LOGW(TAG, "oscillator was stopped, time is not valid!");
+    }
 
     updateReg(CONTROL, SQWAVE_1HZ, EOSC|BBSQW|SQWAVE_MASK|INTCN);
     updateReg(STATUS, 0, OSC_STOP_FLAG);
@@ -109,10 +114,8 @@ bool DS3231::getTime(struct tm *time)
     return true;
 }
 
-bool DS3231::setTime(struct tm* time)
+void DS3231::encodeTime(struct tm* time, uint8_t* data)
 {
-    uint8_t data[7];
-
     /* time/date data */
     data[0] = dec2bcd(time->tm_sec);
     data[1] = dec2bcd(time->tm_min);
@@ -123,10 +126,63 @@ bool DS3231::setTime(struct tm* time)
     data[4] = dec2bcd(time->tm_mday);
     data[5] = dec2bcd(time->tm_mon + 1);
     data[6] = dec2bcd(time->tm_year - 100);
+}
+
+bool DS3231::setTime(struct tm* time)
+{
+    uint8_t data[7];
+    encodeTime(time, data);
     bool ret = write(SECONDS, sizeof(data), data);
     return ret;
 }
 
+/**
+ * build the I2C transaction to set the time ahead of when it needs to be written,
+ * commitTime() then only has to run it.  Writing the seconds register restarts the
+ * DS3231 countdown chain so the write should complete at the start of the second.
+*/
+bool DS3231::prepareTime(struct tm* time)
+{
+    if (_time_cmd != nullptr)
+    {
+        i2c_cmd_link_delete(_time_cmd);
+    }
+    encodeTime(time, _time_data);
+    _time_cmd = i2c_cmd_link_create();
+    if (_time_cmd == nullptr)
+    {
+        ESP_LOGE(TAG, "::prepareTime failed to create i2c command");
+        return false;
+    }
+    i2c_master_start(_time_cmd);
+    i2c_master_write_byte(_time_cmd, DS3231_ADDR << 1 | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(_time_cmd, SECONDS, true);
+    i2c_master_write(_time_cmd, _time_data, sizeof(_time_data), true);
+    i2c_master_stop(_time_cmd);
+    return true;
+}
+
+/**
+ * run the transaction built by prepareTime
+*/
+bool DS3231::commitTime()
+{
+    if (_time_cmd == nullptr)
+    {
+        ESP_LOGE(TAG, "::commitTime no prepared time!");
+        return false;
+    }
+    esp_err_t err = i2c_master_cmd_begin(_i2c, _time_cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(_time_cmd);
+    _time_cmd = nullptr;
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::commitTime i2c master command failed: %d (%s)", err, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
 int8_t DS3231::getAgeOffset()
 {
     return _age_offset;
@@ -151,6 +207,22 @@ bool DS3231::setAgeOffset(int8_t ageoff)
     return true;
 }
 
+/**
+ * read the die temperature in C, it has a resolution of 0.25C and is updated by
+ * the DS3231 every 64 seconds (and on each aging offset change).
+*/
+bool DS3231::getTemperature(float* temp)
+{
+    uint8_t data[2];
+    if (!read(TEMP_MSB, sizeof(data), data))
+    {
+        ESP_LOGE(TAG, "failed to read temperature from ds3231!");
+        return false;
+    }
+    *temp = (int8_t)data[0] + (data[1] >> 6) * 0.25;
+    return true;
+}
+
 bool DS3231::updateReg(Register reg, uint8_t value, uint8_t mask)
 {
     ESP_LOGD(TAG, "::updateReg: reg: 0x%02x value: 0x%02x mask: 0x%02x", reg, value, mask);
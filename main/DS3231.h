@@ -46,10 +46,15 @@ public:
     
     bool getTime(struct tm* tm);
     bool setTime(struct tm* tm);
+    bool prepareTime(struct tm* tm);
+    bool commitTime();
 
     int8_t getAgeOffset();
     bool setAgeOffset(int8_t ageoff);
 
+    bool getTemperature(float* temp);
+    bool getOscillatorStopped() { return _osc_stopped; }
+
 protected:
     const uint8_t DS3231_ADDR       = 0x68;
     const uint8_t DS3231_12HR       = 0x40;
@@ -109,6 +114,10 @@ private:
     i2c_port_t         _i2c;
     SemaphoreHandle_t  _lock = nullptr;
     int8_t             _age_offset = 0;
+    bool               _osc_stopped = false; // the oscillator stopped before begin(), the time is not valid
+    i2c_cmd_handle_t   _time_cmd   = nullptr; // prepared by prepareTime, run by commitTime
+    uint8_t            _time_data[7];
+    void encodeTime(struct tm* tm, uint8_t* data);
 };
 
 #endif // _DS3231_H
@@ -28,6 +28,7 @@
 //#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
 #include "esp_log.h"
 #include <sys/time.h>
+#include <math.h>
 #include <soc/soc.h>
 
 static const char* TAG = "GPS";
@@ -40,7 +41,14 @@ static const char* TAG = "GPS";
 #define GPS_TASK_CORE 0
 #endif
 
-#define MINUTES2USECS(m) (m*60*1000000)
+// a GST error estimate older than this is not used
+#define GST_MAX_AGE 5000000
+
+// a PUBX,04 UTC status older than this is not used
+#define UTC_MAX_AGE 5000000
+
+// a gap in received data this long means the next data starts a new second
+#define BURST_GAP_TICKS (200*1000*MicroSecondTimer::TICKS_PER_USEC)
 
 typedef union {
     struct minmea_sentence_rmc rmc;
@@ -141,6 +149,13 @@ bool GPS::begin(gpio_num_t tx_pin, gpio_num_t rx_pin)
     //uart_flush_input(_uart_id);
 #endif
 
+#if CONFIG_GPSNTP_GPS_TYPE_UBLOX6M
+    // UBX-CFG-MSG output PUBX,04 every second on this port for the leap second status
+    const uint8_t msg[] = {0xF1, 0x04, 0x01};
+    ESP_LOGI(TAG, "::begin enabling PUBX,04 output");
+    sendUBX(0x06, 0x01, msg, sizeof(msg));
+#endif
+
     ESP_LOGI(TAG, "::begin create GPS task at priority %d core %d", GPS_TASK_PRI, GPS_TASK_CORE);
     xTaskCreatePinnedToCore(task, "GPS", 4096, this, GPS_TASK_PRI, &_task, GPS_TASK_CORE);
 
@@ -194,7 +209,7 @@ bool GPS::getValid(uint32_t max_wait_ms)
     bool ret = false;
     if (xSemaphoreTake(_lock, pdMS_TO_TICKS(max_wait_ms)) == pdTRUE)
     {
-        uint64_t now = _timer.getValue64();
+        uint64_t now = _timer.getMicroSeconds64();
         uint64_t age = now - _last_rmc;
         if (_valid && age > 1500000) // its bad if older than 1.5 seconds
         {
@@ -203,14 +218,9 @@ bool GPS::getValid(uint32_t max_wait_ms)
             xSemaphoreGive(_lock);
             return false;
         }
-        // return valid only if it has been valid for over 20 minutes
-        // because in the first few minutes sometimes the time is off
-        // by a couple of seconds even when GPS sends valid.
-        age = now - _valid_since;
-        if (age > MINUTES2USECS(20))
-        {
-            ret = _valid;
-        }
+        // this is what the receiver reports, GPSValidator decides when the time
+        // can be trusted (early on it can be off by a couple of seconds).
+        ret = _valid;
         xSemaphoreGive(_lock);
     }
     else
@@ -222,7 +232,7 @@ bool GPS::getValid(uint32_t max_wait_ms)
 
 uint32_t GPS::getValidDuration()
 {
-    return _valid ? (_timer.getValue64() - _valid_since) / 1000000 : 0;
+    return _valid ? (_timer.getMicroSeconds64() - _valid_since) / 1000000 : 0;
 }
 
 uint32_t GPS::getValidCount()
@@ -230,6 +240,33 @@ uint32_t GPS::getValidCount()
     return _valid_count;
 }
 
+/**
+ * horizontal position error estimate in meters from GST, negative if the receiver
+ * has not sent one recently.
+*/
+float GPS::getPositionError()
+{
+    if (_last_gst == 0 || _timer.getMicroSeconds64() - _last_gst > GST_MAX_AGE)
+    {
+        return -1;
+    }
+    return _position_error;
+}
+
+/**
+ * whether the receiver has the UTC offset (leap seconds) from the satellites rather
+ * than its firmware default.  Returns false if the receiver has not said recently.
+*/
+bool GPS::getUTCStatus(bool* validp)
+{
+    if (_last_utc == 0 || _timer.getMicroSeconds64() - _last_utc > UTC_MAX_AGE)
+    {
+        return false;
+    }
+    *validp = _utc_valid;
+    return true;
+}
+
 float GPS::getLatitude()
 {
     return _latitude;
@@ -255,6 +292,122 @@ time_t GPS::getZDATime()
     return _zda_time.tv_sec;
 }
 
+/**
+ * get the timer value when the receiver started output for the current second
+*/
+uint32_t GPS::getBurstTimer()
+{
+    return _burst_timer;
+}
+
+/**
+ * set the rate of the receivers timepulse, pulses are aligned to the top of
+ * the second.  Only u-blox receivers are supported.
+*/
+bool GPS::setTimepulseRate(uint32_t rate)
+{
+#if CONFIG_GPSNTP_GPS_TYPE_UBLOX6M
+    // UBX-CFG-TP5 for TIMEPULSE, the same settings locked and unlocked
+    uint32_t length = 1000000 / rate / 4; // us, 25% duty
+    uint32_t flags  = 0x01  // active
+                    | 0x02  // lockGpsFreq
+                    | 0x04  // lockedOtherSet
+                    | 0x08  // isFreq
+                    | 0x10  // isLength
+                    | 0x20  // alignToTow
+                    | 0x40; // polarity rising, gridUtcGps 0 = UTC
+    uint8_t payload[32];
+    memset(payload, 0, sizeof(payload));
+    // tpIdx=0, reserved, antCableDelay=0, rfGroupDelay=0 then the 32 bit fields:
+    // freqPeriod, freqPeriodLock, pulseLenRatio, pulseLenRatioLock, userConfigDelay, flags
+    const uint32_t fields[] = {rate, rate, length, length, 0, flags};
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int b = 0; b < 4; ++b)
+        {
+            payload[8 + i*4 + b] = (fields[i] >> (b*8)) & 0xff;
+        }
+    }
+    ESP_LOGI(TAG, "::setTimepulseRate setting UBLOX6M timepulse to %uHz", rate);
+    sendUBX(0x06, 0x31, payload, sizeof(payload));
+    return true;
+#else
+    if (rate != 1)
+    {
+        ESP_LOGE(TAG, "::setTimepulseRate %uHz timepulse is not supported for this GPS type", rate);
+        return false;
+    }
+    return true;
+#endif
+}
+
+#if CONFIG_GPSNTP_GPS_TYPE_UBLOX6M
+/**
+ * write a UBX message, framing and checksum are added
+*/
+void GPS::sendUBX(uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t length)
+{
+    uint8_t header[6] = {0xB5, 0x62, cls, id, (uint8_t)(length & 0xff), (uint8_t)(length >> 8)};
+    uint8_t ck[2] = {0, 0};
+    for (int i = 2; i < 6 + length; ++i)
+    {
+        ck[0] += i < 6 ? header[i] : payload[i-6];
+        ck[1] += ck[0];
+    }
+    uart_write_bytes(_uart_id, (const char*)header, sizeof(header));
+    uart_write_bytes(_uart_id, (const char*)payload, length);
+    uart_write_bytes(_uart_id, (const char*)ck, sizeof(ck));
+}
+#endif
+
+/**
+ * $PUBX,04,time,date,utc_tow,utc_week,leap_sec,clk_bias,clk_drift,tp_gran*cs, the
+ * leap seconds are marked with a D while they are the firmware default and not
+ * yet received from the satellites.
+*/
+void GPS::processTime(const char* sentence)
+{
+    const char* field = sentence;
+    for (int i = 0; i < 6 && field != nullptr; ++i)
+    {
+        field = strchr(field, ',');
+        if (field != nullptr)
+        {
+            field += 1;
+        }
+    }
+    if (field == nullptr || *field < '0' || *field > '9')
+    {
+        ESP_LOGW(TAG, "::processTime PUBX,04 not parsed: '%s'", sentence);
+        return;
+    }
+    const char* end = field;
+    while (*end >= '0' && *end <= '9')
+    {
+        ++end;
+    }
+    bool valid = *end != 'D';
+    if (valid != _utc_valid)
+    {
+        ESP_LOGI(TAG, "::processTime leap seconds %.*s %s", (int)(end - field), field, valid ? "from satellites" : "firmware default");
+    }
+    _utc_valid = valid;
+    _last_utc  = _timer.getMicroSeconds64();
+}
+
+/**
+ * note the time of the first data after a gap as the start of a second
+*/
+void GPS::noteData()
+{
+    uint32_t now = _timer.getValue();
+    if (now - _last_data > BURST_GAP_TICKS)
+    {
+        _burst_timer = now;
+    }
+    _last_data = now;
+}
+
 void GPS::process(char* sentence)
 {
     minmea_record_t data;
@@ -282,7 +435,7 @@ void GPS::process(char* sentence)
                 _valid = false;
                 ESP_LOGE(TAG, "::process RMC failed to convert date/time!");
             }
-            _last_rmc = _timer.getValue64();
+            _last_rmc = _timer.getMicroSeconds64();
             if (_valid && !was_valid)
             {
                 _valid_since = _last_rmc;
@@ -344,8 +497,23 @@ void GPS::process(char* sentence)
             break;
 
         case MINMEA_SENTENCE_GST:
-            ESP_LOGD(TAG, "::process sentence not implemented: '%s'", sentence);
+        {
+            if (!minmea_parse_gst(&data.gst, sentence))
+            {
+                ESP_LOGE(TAG, "$xxGST sentence is not parsed");
+                break;
+            }
+            float lat = minmea_tofloat(&data.gst.latitude_error_deviation);
+            float lon = minmea_tofloat(&data.gst.longitude_error_deviation);
+            if (isnan(lat) || isnan(lon))
+            {
+                break;
+            }
+            _position_error = sqrtf(lat*lat + lon*lon);
+            _last_gst       = _timer.getMicroSeconds64();
+            ESP_LOGD(TAG, "$xxGST: lat error=%0.1fm lon error=%0.1fm", lat, lon);
             break;
+        }
 
         case MINMEA_SENTENCE_GSV:
             if (!minmea_parse_gsv(&data.gsv, sentence))
@@ -404,6 +572,11 @@ void GPS::process(char* sentence)
                 // TODO: parse $PSTI,00 for not hide it if its timing mode 2
                 break;
             }
+            if (strncmp("$PUBX,04,", sentence, 9) == 0)
+            {
+                processTime(sentence);
+                break;
+            }
 
             ESP_LOGW(TAG, "::process sentence invalid: '%s'", sentence);
             break;
@@ -429,6 +602,7 @@ void GPS::task()
         switch(event.type)
         {
             case UART_DATA:
+                noteData();
                 break;
 
             case UART_FIFO_OVF:
@@ -462,6 +636,7 @@ void GPS::task()
                 break;
 
             case UART_PATTERN_DET:
+                noteData();
                 size_t size;
                 uart_get_buffered_data_len(_uart_id, &size);
                 int pos = uart_pattern_pop_pos(_uart_id);
@@ -52,6 +52,10 @@ public:
     // from GSA
     char  getMode();
     int   getFixType();
+    // from GST
+    float getPositionError();
+    // from PUBX,04 (u-blox)
+    bool  getUTCStatus(bool* validp);
     // from RMC
     bool  getValid(uint32_t max_wait_ms=10);
     uint32_t getValidDuration(); // valid duration in seconds
@@ -61,6 +65,8 @@ public:
     char* getPSTI();
     time_t getRMCTime();
     time_t getZDATime();
+    uint32_t getBurstTimer();
+    bool  setTimepulseRate(uint32_t rate);
 
 protected:
     MicroSecondTimer&   _timer;
@@ -77,6 +83,12 @@ protected:
     // from GSA
     volatile char       _mode = 0;
     volatile int        _fix_type = 0;
+    // from GST
+    volatile float      _position_error = 0;
+    volatile uint64_t   _last_gst = 0;
+    // from PUBX,04
+    volatile bool       _utc_valid = false;
+    volatile uint64_t   _last_utc = 0;
     // from RMC
     volatile bool       _valid = false;
     volatile float      _latitude = 0.0;
@@ -88,6 +100,9 @@ protected:
     volatile uint32_t   _valid_count;
     // from ZDA if present
     struct timespec     _zda_time = {0,0};;
+    // timer value when the output for a second started
+    volatile uint32_t   _burst_timer = 0;
+    uint32_t            _last_data = 0;
 
 private:
     SemaphoreHandle_t   _lock;
@@ -95,6 +110,11 @@ private:
     TaskHandle_t        _task;
 
     void process(char* sentence);
+    void processTime(const char* sentence);
+#if CONFIG_GPSNTP_GPS_TYPE_UBLOX6M
+    void sendUBX(uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t length);
+#endif
+    void noteData();
     void task();
     static void task(void* data);
 
@@ -0,0 +1,174 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "GPSValidator.h"
+#include <math.h>
+
+GPSValidator::GPSValidator(const Thresholds& thresholds)
+: _thresholds(thresholds)
+{
+}
+
+/**
+ * consistent seconds needed now, fewer after a short outage of a receiver that
+ * was valid before and many more the first time if the UTC offset can't be checked.
+*/
+uint32_t GPSValidator::getRequired() const
+{
+    if (_validated && _seconds - _invalid_since <= _thresholds.revalidate_window)
+    {
+        return _thresholds.revalidate_seconds;
+    }
+    if (!_validated && !_utc_seen && _thresholds.utc_wait_seconds > _thresholds.seconds)
+    {
+        return _thresholds.utc_wait_seconds;
+    }
+    return _thresholds.seconds;
+}
+
+/**
+ * the evidence for one second, returns true if the GPS is valid
+*/
+bool GPSValidator::update(const Evidence& e)
+{
+    _seconds += 1;
+
+    int32_t delta      = e.rmc_time - e.pps_second;
+    bool    step       = _have_prev && delta != _prev_delta;
+    bool    zda_fresh  = e.zda_time != 0 && e.zda_time != _prev_zda;
+    float   jitter     = _prev_interval > 0 ? fabs(e.pps_interval - _prev_interval) : 0;
+    _prev_delta        = delta;
+    _prev_zda          = e.zda_time;
+    _prev_interval     = e.pps_fresh ? e.pps_interval : 0;
+    _have_prev         = e.rmc_valid && e.pps_fresh;
+    if (e.utc == UTC_VALID)
+    {
+        _utc_seen = true;
+    }
+
+    // any of these end validity
+    if (!e.rmc_valid)
+    {
+        invalidate("receiver not valid");
+        return false;
+    }
+    if (!e.pps_fresh)
+    {
+        invalidate("no PPS");
+        return false;
+    }
+    if (step)
+    {
+        invalidate("time step against PPS");
+        return false;
+    }
+    if (zda_fresh && e.zda_time != e.rmc_time)
+    {
+        invalidate("ZDA and RMC disagree");
+        return false;
+    }
+    if (e.utc == UTC_PENDING)
+    {
+        invalidate("leap seconds unknown");
+        return false;
+    }
+
+    if (_valid)
+    {
+        return true;
+    }
+
+    // these only gate becoming valid
+    if (fabs(e.pps_interval - 1000000.0) > _thresholds.max_interval_error)
+    {
+        reject("PPS interval");
+        return false;
+    }
+    if (jitter > _thresholds.max_jitter)
+    {
+        reject("PPS jitter");
+        return false;
+    }
+    if (e.fix_type < _thresholds.min_fix_type)
+    {
+        reject("no 3D fix");
+        return false;
+    }
+    if (e.sats < _thresholds.min_sats)
+    {
+        reject("too few satellites");
+        return false;
+    }
+    if (e.position_error >= 0 && e.position_error > _thresholds.max_position_error)
+    {
+        reject("position error");
+        return false;
+    }
+
+    _consistent += 1;
+    if (_consistent < getRequired())
+    {
+        _reason = "checking";
+        return false;
+    }
+    _valid     = true;
+    _validated = true;
+    _reason    = "consistent";
+    return true;
+}
+
+/**
+ * the PPS second counter was set to the RMC time, not a step
+*/
+void GPSValidator::ppsSet()
+{
+    _have_prev = false;
+}
+
+/**
+ * the receiver was valid before a soft reset, it only needs the short check
+*/
+void GPSValidator::setValidated()
+{
+    _validated     = true;
+    _invalid_since = _seconds;
+}
+
+void GPSValidator::invalidate(const char* reason)
+{
+    if (_valid)
+    {
+        _invalid_since = _seconds;
+    }
+    _valid      = false;
+    _consistent = 0;
+    _reason     = reason;
+}
+
+void GPSValidator::reject(const char* reason)
+{
+    _consistent = 0;
+    _reason     = reason;
+}
@@ -0,0 +1,111 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _GPS_VALIDATOR_H
+#define _GPS_VALIDATOR_H
+
+#include <stdint.h>
+#include <time.h>
+
+//
+// Decides when the GPS time can be trusted from evidence instead of a fixed wait.
+// Once a second it is given what the receiver and the GPS PPS say: the RMC (and
+// ZDA) second must advance with the PPS second counter, there must be a new PPS
+// edge with a stable interval, a 3D fix with enough satellites and, if the
+// receiver sends GST, a small position error.  The GPS is valid after enough
+// consecutive consistent seconds.  Once valid the fix quality checks are not
+// applied again, only losing the receiver validity, the PPS or a step of the
+// time against the PPS make it invalid.  None of this catches a stale leap second
+// offset, so the receiver must also say its UTC offset is from the satellites;
+// until a receiver that can say so has, the old long wait is used instead.  No
+// ESP-IDF dependencies.
+//
+class GPSValidator
+{
+public:
+    enum UTCState
+    {
+        UTC_UNKNOWN = 0,    // the receiver does not report it
+        UTC_PENDING,        // leap seconds are the firmware default
+        UTC_VALID           // leap seconds received from the satellites
+    };
+
+    struct Thresholds
+    {
+        uint32_t seconds;            // consistent seconds needed
+        uint32_t revalidate_seconds; // consistent seconds needed after a short outage
+        uint32_t revalidate_window;  // seconds an outage can last and still be short
+        int      min_fix_type;       // GSA fix type, 3 is 3D
+        int      min_sats;           // GGA satellites tracked
+        float    max_position_error; // GST horizontal error, m
+        float    max_jitter;         // change of the PPS interval between seconds, us
+        float    max_interval_error; // PPS interval from 1 second, us
+        uint32_t utc_wait_seconds;   // consistent seconds needed with no UTC status
+    };
+
+    struct Evidence
+    {
+        bool     rmc_valid;       // receiver reports valid
+        time_t   rmc_time;
+        time_t   zda_time;        // 0 if the receiver does not send ZDA
+        time_t   pps_second;      // GPS PPS second counter
+        bool     pps_fresh;       // a new PPS edge since the last second
+        float    pps_interval;    // us
+        int      fix_type;
+        int      sats;
+        float    position_error;  // m, negative if unknown
+        UTCState utc;
+    };
+
+    explicit GPSValidator(const Thresholds& thresholds);
+    bool  update(const Evidence& evidence);
+    void  ppsSet();
+    void  setValidated();
+
+    bool        isValid() const       { return _valid; }
+    bool        isValidated() const   { return _validated; }
+    const char* getReason() const     { return _reason; }
+    uint32_t    getConsistent() const { return _consistent; }
+    uint32_t    getRequired() const;
+
+private:
+    Thresholds  _thresholds;
+    bool        _valid        = false;
+    bool        _validated    = false; // has been valid
+    const char* _reason       = "starting";
+    uint32_t    _consistent   = 0;     // consecutive consistent seconds
+    uint32_t    _seconds      = 0;     // updates seen
+    uint32_t    _invalid_since = 0;    // _seconds when last made invalid
+    bool        _have_prev    = false;
+    int32_t     _prev_delta   = 0;     // rmc - pps second of the previous update
+    time_t      _prev_zda     = 0;
+    float       _prev_interval = 0;
+    bool        _utc_seen     = false; // the receiver has reported UTC valid
+
+    void invalidate(const char* reason);
+    void reject(const char* reason);
+};
+
+#endif // _GPS_VALIDATOR_H
@@ -0,0 +1,195 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "Holdover.h"
+#include <math.h>
+
+Holdover::Holdover(float aging_rate)
+: _aging_rate(aging_rate)
+{
+}
+
+/**
+ * disciplined by GPS with the given error bound in us
+*/
+void Holdover::lock(float bound)
+{
+    if (isHolding())
+    {
+        return;
+    }
+    _state = LOCKED;
+    _bound = bound;
+}
+
+/**
+ * GPS was lost, freeze the aging value and start growing the bound from the
+ * locked bound.  output is the steady state aging value, drift its rate of
+ * change in LSB/s and freq_error the frequency uncertainty in ppm.  Returns false
+ * if never locked as there is nothing to hold.
+*/
+bool Holdover::enter(uint32_t now, float output, float drift, float freq_error)
+{
+    switch (_state)
+    {
+        case UNLOCKED:
+        case HOLDOVER:
+            return false;
+
+        case REACQUIRE:
+            // lost again before the error was measured, carry on from the first holdover
+            _state = HOLDOVER;
+            update(now, freq_error);
+            return true;
+
+        case LOCKED:
+            break;
+    }
+
+    _state       = HOLDOVER;
+    _start       = now;
+    _update      = now;
+    _output      = output;
+    _drift       = drift;
+    _start_bound = _bound;
+    _freq_bound  = 0;
+    return true;
+}
+
+/**
+ * start in holdover from a saved state, bound is the error bound now (grown over
+ * the time the state was saved for).
+*/
+void Holdover::resume(uint32_t now, float output, float drift, float bound)
+{
+    _state       = HOLDOVER;
+    _start       = now;
+    _update      = now;
+    _output      = output;
+    _drift       = drift;
+    _start_bound = bound;
+    _bound       = bound;
+    _freq_bound  = 0;
+}
+
+/**
+ * grow the bound with the frequency uncertainty (ppm) since the last update
+*/
+void Holdover::update(uint32_t now, float freq_error)
+{
+    if (!isHolding())
+    {
+        return;
+    }
+    _freq_bound += fabs(freq_error) * (now - _update);
+    _update      = now;
+    float t      = now - _start;
+    _bound       = _start_bound + _freq_bound + 0.5 * _aging_rate * t * t;
+}
+
+/**
+ * GPS is back, the bound keeps growing until the error is measured
+*/
+void Holdover::reacquire()
+{
+    if (_state == HOLDOVER)
+    {
+        _state = REACQUIRE;
+    }
+}
+
+/**
+ * the first error (us) measured after GPS came back, ends the holdover
+*/
+void Holdover::measure(float error)
+{
+    if (_state != REACQUIRE)
+    {
+        return;
+    }
+    error           = fabs(error);
+    _last_duration  = _update - _start;
+    _last_error     = error;
+    _last_bound     = _bound;
+    _count         += 1;
+    if (error > _bound)
+    {
+        _violations += 1;
+    }
+    float ratio = _bound > 0 ? error / _bound : 0;
+    if (ratio > _worst_ratio)
+    {
+        _worst_ratio = ratio;
+    }
+    _state = LOCKED;
+    _bound = error;
+}
+
+/**
+ * the aging value to hold, the frozen value plus the drift since holdover started
+*/
+float Holdover::getOutput(uint32_t now) const
+{
+    return _output + _drift * (float)(now - _start);
+}
+
+uint32_t Holdover::getElapsed(uint32_t now) const
+{
+    return isHolding() ? now - _start : 0;
+}
+
+/**
+ * NTP stratum for an error bound (us): the reference stratum, one worse once the
+ * bound passes stratum_bound and 16 (unsynchronised, the leap indicator is then
+ * NOSYNC) if never locked or the bound passes max_bound.
+*/
+uint8_t Holdover::getStratum(bool locked, float bound, uint8_t stratum, float stratum_bound, float max_bound)
+{
+    if (!locked || bound > max_bound)
+    {
+        return 16;
+    }
+    if (stratum == 1 && bound > stratum_bound)
+    {
+        return 2;
+    }
+    return stratum;
+}
+
+const char* Holdover::getStateName(State state)
+{
+    switch (state)
+    {
+        case UNLOCKED:
+            return "unlocked";
+        case LOCKED:
+            return "locked";
+        case HOLDOVER:
+            return "holdover";
+        case REACQUIRE:
+            return "reacquire";
+    }
+    return "unknown";
+}
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _HOLDOVER_H
+#define _HOLDOVER_H
+
+#include <stdint.h>
+
+//
+// Holdover state of the RTC discipline.  While GPS disciplined the current error
+// bound is tracked, when GPS is lost the steady state aging value is frozen (plus
+// the estimated drift of it) and the bound grows with the frequency uncertainty
+// and the worst case crystal aging.  When GPS returns the first measured error is
+// compared with the predicted bound so holdover accuracy can be checked on the
+// device.  Times are seconds of uptime, no ESP-IDF dependencies.
+//
+class Holdover
+{
+public:
+    enum State
+    {
+        UNLOCKED = 0, // never disciplined, the RTC time has no known bound
+        LOCKED,       // disciplined by GPS
+        HOLDOVER,     // GPS lost, running on the frozen frequency
+        REACQUIRE,    // GPS back, waiting to measure the holdover error
+    };
+
+    explicit Holdover(float aging_rate);
+    void  lock(float bound);
+    bool  enter(uint32_t now, float output, float drift, float freq_error);
+    void  resume(uint32_t now, float output, float drift, float bound);
+    void  update(uint32_t now, float freq_error);
+    void  reacquire();
+    void  measure(float error);
+
+    State    getState() const      { return _state; }
+    bool     isHolding() const     { return _state == HOLDOVER || _state == REACQUIRE; }
+    float    getOutput(uint32_t now) const;
+    float    getErrorBound() const { return _bound; }
+    float    getDrift() const      { return _drift; }
+    uint32_t getElapsed(uint32_t now) const;
+    uint32_t getCount() const      { return _count; }
+    uint32_t getViolations() const { return _violations; }
+    uint32_t getLastDuration() const { return _last_duration; }
+    float    getLastError() const  { return _last_error; }
+    float    getLastBound() const  { return _last_bound; }
+    float    getWorstRatio() const { return _worst_ratio; }
+
+    static const char* getStateName(State state);
+    static uint8_t     getStratum(bool locked, float bound, uint8_t stratum, float stratum_bound, float max_bound);
+
+private:
+    float    _aging_rate;         // worst case change of the frequency, ppm/s
+    State    _state         = UNLOCKED;
+    float    _bound         = 0;  // current error bound, us
+    float    _start_bound   = 0;  // bound when holdover started
+    uint32_t _start         = 0;  // uptime holdover started
+    uint32_t _update        = 0;  // uptime of the last update
+    float    _output        = 0;  // frozen aging value
+    float    _drift         = 0;  // change of the aging value, LSB/s
+    float    _freq_bound    = 0;  // integral of the frequency uncertainty, us
+    uint32_t _count         = 0;  // holdovers measured
+    uint32_t _violations    = 0;  // measured errors larger than the bound
+    uint32_t _last_duration = 0;
+    float    _last_error    = 0;
+    float    _last_bound    = 0;
+    float    _worst_ratio   = 0;  // largest measured error / predicted bound
+};
+
+#endif // _HOLDOVER_H
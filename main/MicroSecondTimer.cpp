@@ -29,14 +29,14 @@ static const char* TAG = "TIMER";
 
 MicroSecondTimer::MicroSecondTimer()
 {
-    ESP_LOGI(TAG, "::MicroSecondTimer configuring and starting microsecond timer");
+    ESP_LOGI(TAG, "::MicroSecondTimer configuring and starting timer at %uHz", TICKS_PER_SEC);
     timer_config_t tc = {
         .alarm_en    = TIMER_ALARM_DIS,
         .counter_en  = TIMER_PAUSE,
         .intr_type   = TIMER_INTR_LEVEL,
         .counter_dir = TIMER_COUNT_UP,
         .auto_reload = TIMER_AUTORELOAD_DIS,
-        .divider     = 80,  // microseconds second
+        .divider     = MICRO_SECOND_TIMER_DIVIDER,
     };
     esp_err_t err = timer_init(MICRO_SECOND_TIMER_GROUP_NUM, MICRO_SECOND_TIMER_NUM, &tc);
     if (err != ESP_OK)
@@ -29,14 +29,24 @@
 #include "driver/timer.h"
 #include <sys/types.h>
 #include <functional>
+#include "MicroSecondTimerConfig.h"
 
 #define MICRO_SECOND_TIMER_GROUP_NUM TIMER_GROUP_0
 #define MICRO_SECOND_TIMER_GROUP TIMERG0
 #define MICRO_SECOND_TIMER_NUM TIMER_0
 
+//
+// Despite the name the timer ticks at MICRO_SECOND_TIMER_TICKS_PER_SEC, 1MHz by
+// default or 40MHz when CONFIG_GPSNTP_TIMER_RESOLUTION_40MHZ is selected.
+//
 class MicroSecondTimer
 {
 public:
+    static constexpr uint32_t TICKS_PER_SEC  = MICRO_SECOND_TIMER_TICKS_PER_SEC;
+    static constexpr uint32_t TICKS_PER_USEC = MICRO_SECOND_TIMER_TICKS_PER_USEC;
+    // nanoseconds per tick as 16.16 fixed point
+    static constexpr uint32_t NANOS_PER_TICK_Q16 = (uint32_t)((1000000000ULL << 16) / TICKS_PER_SEC);
+
     MicroSecondTimer();
 
     uint32_t inline IRAM_ATTR getValue()
@@ -50,9 +60,31 @@ public:
 
     uint64_t inline IRAM_ATTR getValue64()
     {
-        uint64_t value;
-        timer_get_counter_value(MICRO_SECOND_TIMER_GROUP_NUM, MICRO_SECOND_TIMER_NUM, &value);
-        return value;
+        uint32_t high;
+        uint32_t low;
+        // the PPS ISR also latches the counter so make sure both halves
+        // came from the same latch, a carry between reads will show up in high.
+        do
+        {
+            TIMERG0.hw_timer[TIMER_0].update = 1;
+            while (TIMERG0.hw_timer[TIMER_0].update) {}
+            high = TIMERG0.hw_timer[TIMER_0].cnt_high;
+            low  = TIMERG0.hw_timer[TIMER_0].cnt_low;
+        } while (high != TIMERG0.hw_timer[TIMER_0].cnt_high);
+        return ((uint64_t)high << 32) | low;
+    }
+
+    uint64_t inline getMicroSeconds64()
+    {
+        return getValue64() / TICKS_PER_USEC;
+    }
+
+    /**
+     * convert a tick count (less than a few seconds worth) to nanoseconds.
+    */
+    static inline int64_t IRAM_ATTR ticksToNanos(int64_t ticks)
+    {
+        return (ticks * NANOS_PER_TICK_Q16) / 65536;
     }
 };
 
@@ -0,0 +1,44 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef __MICRO_SECOND_TIMER_CONFIG_H
+#define __MICRO_SECOND_TIMER_CONFIG_H
+
+//
+// Only preprocessor definitions here, this is included by highint5.S
+//
+#include "sdkconfig.h"
+
+#if defined(CONFIG_GPSNTP_TIMER_RESOLUTION_40MHZ)
+#define MICRO_SECOND_TIMER_DIVIDER        2   // 40MHz, 25ns per tick
+#else
+#define MICRO_SECOND_TIMER_DIVIDER        80  // 1MHz, 1us per tick
+#endif
+
+#define MICRO_SECOND_TIMER_APB_HZ         80000000
+#define MICRO_SECOND_TIMER_TICKS_PER_SEC  (MICRO_SECOND_TIMER_APB_HZ/MICRO_SECOND_TIMER_DIVIDER)
+#define MICRO_SECOND_TIMER_TICKS_PER_USEC (MICRO_SECOND_TIMER_TICKS_PER_SEC/1000000)
+
+#endif // __MICRO_SECOND_TIMER_CONFIG_H
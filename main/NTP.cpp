@@ -46,53 +46,10 @@ static const char* TAG = "NTP";
 
 //#define NTP_PACKET_DEBUG
 
-#define NTP_PORT               123
 #define PRECISION_COUNT        10000
 
-typedef struct ntp_packet
-{
-    uint8_t  flags;
-    uint8_t  stratum;
-    uint8_t  poll;
-    int8_t   precision;
-    uint32_t delay;
-    uint32_t dispersion;
-    uint8_t  ref_id[4];
-    NTPTime  ref_time;
-    NTPTime  orig_time;
-    NTPTime  recv_time;
-    NTPTime  xmit_time;
-} NTPPacket;
-
-#define LI_NONE         0
-#define LI_SIXTY_ONE    1
-#define LI_FIFTY_NINE   2
-#define LI_NOSYNC       3
-
-#define MODE_RESERVED   0
-#define MODE_ACTIVE     1
-#define MODE_PASSIVE    2
-#define MODE_CLIENT     3
-#define MODE_SERVER     4
-#define MODE_BROADCAST  5
-#define MODE_CONTROL    6
-#define MODE_PRIVATE    7
-
-#define NTP_VERSION     4
-
-#define REF_ID          "PPS "  // "GPS " when we have one!
-
-#define setLI(value)    ((value&0x03)<<6)
-#define setVERS(value)  ((value&0x07)<<3)
-#define setMODE(value)  ((value&0x07))
-
-#define getLI(value)    ((value>>6)&0x03)
-#define getVERS(value)  ((value>>3)&0x07)
-#define getMODE(value)  (value&0x07)
-
-#define SEVENTY_YEARS   2208988800L
-#define toEPOCH(t)      ((uint32_t)t-SEVENTY_YEARS)
-#define toNTP(t)        ((uint32_t)t+SEVENTY_YEARS)
+// 16.16 fixed point seconds
+#define toShort(us)     ((uint32_t)((us) * 0.000001 * 65536.0))
 
 #ifdef NTP_PACKET_DEBUG
 #include <time.h>
@@ -125,8 +82,9 @@ void dumpNTPPacket(NTPPacket* ntp)
 #endif
 
 
-NTP::NTP(PPS& pps)
-: _pps(pps)
+NTP::NTP(PPS& pps, SyncManager& syncman)
+: _pps(pps),
+  _syncman(syncman)
 {
 }
 
@@ -156,18 +114,91 @@ int8_t NTP::computePrecision()
     return (int8_t)prec;
 }
 
-#define us2s(x) (((double)x)/(double)1000000) // microseconds to seconds
-
 void NTP::getNTPTime(NTPTime* time)
 {
-    struct timeval tv;
-    _pps.getTime(&tv);
-    time->seconds = toNTP(tv.tv_sec);
-    double percent = us2s(tv.tv_usec);
-    time->fraction = (uint32_t)(percent * (double)4294967296L);
+    struct timespec ts;
+    _pps.getTime(&ts);
+    time->seconds  = toNTP(ts.tv_sec);
+    time->fraction = ns2frac(ts.tv_nsec);
 }
 
 
+/**
+ * answer a mode 6 control request in place, returns the response length or 0 to
+ * drop it.  Only a read of the system variables (association 0) is supported, all
+ * of them are returned whatever names are asked for.
+*/
+int NTP::handleControl(NTPControl* control, int len)
+{
+    if (control->op & CTL_RESPONSE)
+    {
+        return 0;
+    }
+    uint8_t  op    = getOP(control->op);
+    uint16_t assoc = ntohs(control->assoc_id);
+    ESP_LOGD(TAG, "::handleControl: op=%u assoc=%u len=%d", op, assoc, len);
+
+    control->flags    = setLI(getLI(control->flags)) | setVERS(getVERS(control->flags)) | setMODE(MODE_CONTROL);
+    control->op       = CTL_RESPONSE | op;
+    control->offset   = 0;
+    control->assoc_id = htons(assoc);
+
+    int count = 0;
+    if (op == CTL_OP_READSTAT && assoc == 0)
+    {
+        // no peer associations
+    }
+    else if (op == CTL_OP_READVAR && assoc == 0)
+    {
+        count = appendVariables(control->data, sizeof(control->data));
+    }
+    else
+    {
+        control->op    |= CTL_ERROR;
+        control->status = htons((op == CTL_OP_READVAR || op == CTL_OP_READSTAT ? CTL_ERR_BADASSOC : CTL_ERR_BADOP) << 8);
+        control->count  = 0;
+        return NTP_CONTROL_HEADER;
+    }
+
+    // system status word, leap indicator and (unspecified) clock source
+    bool synced     = _syncman.isSynchronized();
+    control->status = htons((synced ? LI_NONE : LI_NOSYNC) << 14);
+    control->count  = htons(count);
+    // the data is padded to a 32 bit boundary
+    while (count % 4 != 0)
+    {
+        control->data[count++] = 0;
+    }
+    return NTP_CONTROL_HEADER + count;
+}
+
+/**
+ * format the system variables, the sync state and the health of each GPS receiver,
+ * as name=value pairs.  Returns the length.
+*/
+int NTP::appendVariables(char* buf, int size)
+{
+    const ReceiverSelector& selector = _syncman.getReceiverSelector();
+    int len = snprintf(buf, size, "version=\"gpsntp\", stratum=%u, rootdisp=%0.3f, receivers=%u, active=%u, switches=%u",
+                       _syncman.getStratum(), _syncman.getErrorBound() / 1000.0, selector.getCount(),
+                       selector.getActive()+1, selector.getSwitches());
+    for (uint32_t i = 0; i < selector.getCount() && len < size; ++i)
+    {
+        const ReceiverSelector::Health& h = selector.getHealth(i);
+        len += snprintf(buf+len, size-len,
+                        ",\r\ngps%u_state=\"%s\", gps%u_valid=%u, gps%u_seconds=%u, gps%u_missed=%u, "
+                        "gps%u_time_outvoted=%u, gps%u_phase_outvoted=%u, gps%u_phase=%0.1f, gps%u_max_difference=%0.1f",
+                        i+1, _syncman.getReceiverValidator(i).getReason(), i+1, h.valid_seconds, i+1, h.seconds,
+                        i+1, h.pps_missing, i+1, h.time_mismatch, i+1, h.phase_outliers, i+1, h.phase,
+                        i+1, h.max_difference);
+    }
+    if (len > size)
+    {
+        len = size;
+    }
+    return len;
+}
+
 void NTP::task(void* data)
 {
     NTP* ntp = static_cast<NTP*>(data);
@@ -175,8 +206,13 @@ void NTP::task(void* data)
     int addr_family = AF_INET;
     int ip_protocol = IPPROTO_IP;
     char addr_str[128];
-    NTPPacket packet;
-    NTPTime   recv_time;
+    union
+    {
+        NTPPacket  packet;
+        NTPControl control;
+    } request;
+    NTPPacket& packet = request.packet;
+    NTPTime    recv_time;
 
     while(true)
     {
@@ -208,7 +244,7 @@ void NTP::task(void* data)
             ESP_LOGD(TAG, "Waiting for data");
             struct sockaddr_in6 source_addr; // Large enough for both IPv4 or IPv6
             socklen_t socklen = sizeof(source_addr);
-            int len = recvfrom(sock, &packet, sizeof(packet), 0, (struct sockaddr *)&source_addr, &socklen);
+            int len = recvfrom(sock, &request, sizeof(request), 0, (struct sockaddr *)&source_addr, &socklen);
             ntp->getNTPTime(&recv_time);
             ntp->_req_count++;
 
@@ -217,6 +253,16 @@ void NTP::task(void* data)
                 ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
                 break;
             }
+            if (len >= NTP_CONTROL_HEADER && getMODE(packet.flags) == MODE_CONTROL)
+            {
+                len = ntp->handleControl(&request.control, len);
+                if (len > 0 && sendto(sock, &request, len, 0, (struct sockaddr *)&source_addr, sizeof(source_addr)) < 0)
+                {
+                    ESP_LOGE(TAG, "Error occurred during sending control response: errno %d", errno);
+                    break;
+                }
+                continue;
+            }
             if (len != sizeof(packet))
             {
                 ESP_LOGE(TAG, "bad packet size: %u != %u", len, sizeof(packet));
@@ -248,13 +294,17 @@ void NTP::task(void* data)
             //
             // Build the response
             //
-            packet.flags      = setLI(LI_NONE) | setVERS(NTP_VERSION) | setMODE(MODE_SERVER);
-            packet.stratum    = 1;
+            // the stratum and root dispersion come from the sync error bound, it
+            // grows during holdover and we are unsynchronised past its limit.  The
+            // reference id and root delay follow the selected source.
+            bool synced       = ntp->_syncman.isSynchronized();
+            uint32_t ref_id   = ntp->_syncman.getRefId();
+            packet.flags      = setLI(synced ? LI_NONE : LI_NOSYNC) | setVERS(NTP_VERSION) | setMODE(MODE_SERVER);
+            packet.stratum    = ntp->_syncman.getStratum();
             packet.precision  = ntp->_precision;
-            // TODO: compute actual root delay, and root dispersion
-            packet.delay = 1;      //(uint32)(0.000001 * 65536.0);
-            packet.dispersion = 1; //(uint32_t)(_gps.getDispersion() * 65536.0); // TODO: pre-calculate this?
-            memcpy((char*)packet.ref_id, REF_ID, sizeof(packet.ref_id));
+            packet.delay      = toShort(ntp->_syncman.getRootDelay()) + 1;
+            packet.dispersion = toShort(ntp->_syncman.getErrorBound()) + 1;
+            memcpy(packet.ref_id, &ref_id, sizeof(packet.ref_id));
             packet.orig_time  = packet.xmit_time;
             packet.recv_time  = recv_time;
             ntp->getNTPTime(&(packet.ref_time));
@@ -25,17 +25,13 @@
 #ifndef _NTP_H
 #define _NTP_H
 #include "PPS.h"
-
-typedef struct ntp_time
-{
-    uint32_t seconds;
-    uint32_t fraction;
-} NTPTime;
+#include "SyncManager.h"
+#include "NTPPacket.h"
 
 class NTP
 {
 public:
-    explicit NTP(PPS& pps);
+    NTP(PPS& pps, SyncManager& syncman);
     ~NTP();
     void begin();
     uint32_t getRequests() { return _req_count; }
@@ -43,11 +39,14 @@ public:
 
 private:
     PPS&     _pps;
+    SyncManager& _syncman;
     uint32_t _req_count;
     uint32_t _rsp_count;
     uint8_t  _precision;
 
     void getNTPTime(NTPTime *time);
+    int  handleControl(NTPControl* control, int len);
+    int  appendVariables(char* buf, int size);
     int8_t computePrecision();
     void handleRequest();
     static void task(void* data);
@@ -0,0 +1,113 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _NTP_PACKET_H
+#define _NTP_PACKET_H
+#include <stdint.h>
+
+//
+// NTP wire format shared by the server and the peer client
+//
+
+typedef struct ntp_time
+{
+    uint32_t seconds;
+    uint32_t fraction;
+} NTPTime;
+
+typedef struct ntp_packet
+{
+    uint8_t  flags;
+    uint8_t  stratum;
+    uint8_t  poll;
+    int8_t   precision;
+    uint32_t delay;
+    uint32_t dispersion;
+    uint8_t  ref_id[4];
+    NTPTime  ref_time;
+    NTPTime  orig_time;
+    NTPTime  recv_time;
+    NTPTime  xmit_time;
+} NTPPacket;
+
+// mode 6 control message (RFC 1305 appendix B), the server answers a read of the
+// system variables so ntpq can query the receiver health
+#define NTP_CONTROL_HEADER  12
+#define NTP_CONTROL_DATA    468
+
+typedef struct ntp_control
+{
+    uint8_t  flags;
+    uint8_t  op;            // response, error and more bits and the opcode
+    uint16_t sequence;
+    uint16_t status;
+    uint16_t assoc_id;
+    uint16_t offset;
+    uint16_t count;
+    char     data[NTP_CONTROL_DATA];
+} NTPControl;
+
+#define NTP_PORT        123
+
+#define LI_NONE         0
+#define LI_SIXTY_ONE    1
+#define LI_FIFTY_NINE   2
+#define LI_NOSYNC       3
+
+#define MODE_RESERVED   0
+#define MODE_ACTIVE     1
+#define MODE_PASSIVE    2
+#define MODE_CLIENT     3
+#define MODE_SERVER     4
+#define MODE_BROADCAST  5
+#define MODE_CONTROL    6
+#define MODE_PRIVATE    7
+
+#define NTP_VERSION     4
+
+#define CTL_RESPONSE    0x80
+#define CTL_ERROR       0x40
+#define CTL_MORE        0x20
+#define CTL_OP_READSTAT 1
+#define CTL_OP_READVAR  2
+#define CTL_ERR_BADOP   3
+#define CTL_ERR_BADASSOC 4
+
+#define setLI(value)    ((value&0x03)<<6)
+#define setVERS(value)  ((value&0x07)<<3)
+#define setMODE(value)  ((value&0x07))
+
+#define getLI(value)    ((value>>6)&0x03)
+#define getVERS(value)  ((value>>3)&0x07)
+#define getMODE(value)  (value&0x07)
+#define getOP(value)    (value&0x1f)
+
+#define SEVENTY_YEARS   2208988800L
+#define toEPOCH(t)      ((uint32_t)t-SEVENTY_YEARS)
+#define toNTP(t)        ((uint32_t)t+SEVENTY_YEARS)
+
+#define ns2frac(x) ((uint32_t)(((uint64_t)(x) * 4611686018ULL) >> 30)) // nanoseconds to 2^-32 seconds
+
+#endif // _NTP_PACKET_H
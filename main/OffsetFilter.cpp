@@ -0,0 +1,278 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "OffsetFilter.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+// samples further than MAD_K scaled MADs from the median are rejected, 1.4826
+// scales the MAD to a standard deviation for normally distributed noise.  The
+// threshold is at least MAD_FLOOR ticks so quantised samples are not all rejected.
+#define MAD_K     3.0
+#define MAD_SCALE 1.4826
+#define MAD_FLOOR 1.0
+
+OffsetFilter::OffsetFilter(uint32_t size, Estimator estimator)
+: _size(size < MIN_SIZE ? MIN_SIZE : (size > MAX_SIZE ? MAX_SIZE : size)),
+  _estimator(estimator)
+{
+    _data    = new int32_t[_size];
+    _sorted  = new int32_t[_size];
+    _scratch = new int32_t[_size];
+    _min_q   = new uint32_t[_size];
+    _max_q   = new uint32_t[_size];
+    reset();
+}
+
+OffsetFilter::~OffsetFilter()
+{
+    delete[] _data;
+    delete[] _sorted;
+    delete[] _scratch;
+    delete[] _min_q;
+    delete[] _max_q;
+}
+
+void OffsetFilter::reset()
+{
+    _min_head = 0;
+    _min_tail = 0;
+    _max_head = 0;
+    _max_tail = 0;
+    _seq      = 0;
+    _count    = 0;
+    _sum      = 0;
+    _sum_sq   = 0;
+}
+
+/**
+ * index in _sorted of the first sample not less than value
+*/
+uint32_t OffsetFilter::lowerBound(int32_t value) const
+{
+    return std::lower_bound(_sorted, _sorted + _count, value) - _sorted;
+}
+
+void OffsetFilter::add(int32_t value)
+{
+    uint32_t slot = _seq % _size;
+
+    if (_count == _size)
+    {
+        // drop the oldest sample, it is in the slot we are about to reuse
+        int32_t  old  = _data[slot];
+        uint32_t oseq = _seq - _size;
+        _sum    -= old;
+        _sum_sq -= (int64_t)old * old;
+        if (_min_q[_min_head % _size] == oseq)
+        {
+            _min_head += 1;
+        }
+        if (_max_q[_max_head % _size] == oseq)
+        {
+            _max_head += 1;
+        }
+        uint32_t pos = lowerBound(old);
+        memmove(&_sorted[pos], &_sorted[pos+1], (_count - pos - 1) * sizeof(int32_t));
+        _count -= 1;
+    }
+
+    _data[slot] = value;
+    _sum    += value;
+    _sum_sq += (int64_t)value * value;
+
+    while (_min_tail != _min_head && _data[_min_q[(_min_tail-1) % _size] % _size] >= value)
+    {
+        _min_tail -= 1;
+    }
+    _min_q[_min_tail++ % _size] = _seq;
+
+    while (_max_tail != _max_head && _data[_max_q[(_max_tail-1) % _size] % _size] <= value)
+    {
+        _max_tail -= 1;
+    }
+    _max_q[_max_tail++ % _size] = _seq;
+
+    uint32_t pos = lowerBound(value);
+    memmove(&_sorted[pos+1], &_sorted[pos], (_count - pos) * sizeof(int32_t));
+    _sorted[pos] = value;
+
+    _count += 1;
+    _seq   += 1;
+}
+
+int32_t OffsetFilter::getLast() const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    return _data[(_seq - 1) % _size];
+}
+
+/**
+ * a sample in the window by age, 0 is the newest
+*/
+int32_t OffsetFilter::getSample(uint32_t age) const
+{
+    if (age >= _count)
+    {
+        return 0;
+    }
+    return _data[(_seq - 1 - age) % _size];
+}
+
+int32_t OffsetFilter::getMin() const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    return _data[_min_q[_min_head % _size] % _size];
+}
+
+int32_t OffsetFilter::getMax() const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    return _data[_max_q[_max_head % _size] % _size];
+}
+
+float OffsetFilter::getMean() const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    return (float)_sum / _count;
+}
+
+/**
+ * sample variance of the window in ticks^2
+*/
+float OffsetFilter::getVariance() const
+{
+    if (_count < 2)
+    {
+        return 0;
+    }
+    double mean = (double)_sum / _count;
+    double var  = ((double)_sum_sq - mean * _sum) / (_count - 1);
+    return var > 0 ? var : 0;
+}
+
+float OffsetFilter::getTrimmedMean() const
+{
+    if (_count < 3)
+    {
+        return getMean();
+    }
+    return (float)(_sum - getMin() - getMax()) / (_count - 2);
+}
+
+float OffsetFilter::getMedian() const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    uint32_t mid = _count / 2;
+    if (_count & 1)
+    {
+        return _sorted[mid];
+    }
+    return ((float)_sorted[mid-1] + (float)_sorted[mid]) / 2;
+}
+
+/**
+ * mean of the samples close to the median, popcorn spikes (single samples far from
+ * the rest) are rejected no matter how large they are.
+*/
+float OffsetFilter::getMADMean(uint32_t* rejectedp)
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    float median = getMedian();
+    for (uint32_t i = 0; i < _count; ++i)
+    {
+        _scratch[i] = (int32_t)fabs(_sorted[i] - median);
+    }
+    uint32_t mid = _count / 2;
+    std::nth_element(_scratch, _scratch + mid, _scratch + _count);
+    float limit = MAD_K * MAD_SCALE * _scratch[mid];
+    if (limit < MAD_FLOOR)
+    {
+        limit = MAD_FLOOR;
+    }
+
+    int64_t  sum = 0;
+    uint32_t n   = 0;
+    for (uint32_t i = 0; i < _count; ++i)
+    {
+        if (fabs(_sorted[i] - median) <= limit)
+        {
+            sum += _sorted[i];
+            n   += 1;
+        }
+    }
+    if (rejectedp != nullptr)
+    {
+        *rejectedp = _count - n;
+    }
+    return n > 0 ? (float)sum / n : median;
+}
+
+float OffsetFilter::getEstimate()
+{
+    switch (_estimator)
+    {
+        case MEDIAN:
+            return getMedian();
+        case MAD_MEAN:
+            return getMADMean();
+        case TRIMMED_MEAN:
+            break;
+    }
+    return getTrimmedMean();
+}
+
+const char* OffsetFilter::getEstimatorName(Estimator estimator)
+{
+    switch (estimator)
+    {
+        case TRIMMED_MEAN:
+            return "trimmed";
+        case MEDIAN:
+            return "median";
+        case MAD_MEAN:
+            return "mad";
+    }
+    return "unknown";
+}
@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _OFFSET_FILTER_H
+#define _OFFSET_FILTER_H
+
+#include <stdint.h>
+
+//
+// Sliding window of offset samples with robust estimates of the center.  Adding a
+// sample keeps a running sum and sum of squares and monotonic deques for the min
+// and max in O(1), and a sorted copy of the window (binary search and a short move)
+// for the median and MAD estimators.  Like PPSModel it has no ESP-IDF dependencies.
+//
+class OffsetFilter
+{
+public:
+    enum Estimator
+    {
+        TRIMMED_MEAN = 0,   // mean without the min and max sample
+        MEDIAN,             // median of the window
+        MAD_MEAN,           // mean of the samples within MAD_K scaled MADs of the median
+    };
+
+    static const uint32_t MIN_SIZE = 3;
+    static const uint32_t MAX_SIZE = 256;
+
+    explicit OffsetFilter(uint32_t size, Estimator estimator = TRIMMED_MEAN);
+    ~OffsetFilter();
+
+    OffsetFilter(OffsetFilter&) = delete;
+    OffsetFilter& operator=(OffsetFilter&) = delete;
+
+    void      reset();
+    void      add(int32_t value);
+    bool      isFull() const      { return _count == _size; }
+    uint32_t  getCount() const    { return _count; }
+    uint32_t  getSize() const     { return _size; }
+    Estimator getEstimator() const { return _estimator; }
+    void      setEstimator(Estimator estimator) { _estimator = estimator; }
+    int32_t   getLast() const;
+    int32_t   getSample(uint32_t age) const;
+    int32_t   getMin() const;
+    int32_t   getMax() const;
+    float     getMean() const;
+    float     getVariance() const;
+    float     getTrimmedMean() const;
+    float     getMedian() const;
+    float     getMADMean(uint32_t* rejectedp = nullptr);
+    float     getEstimate();
+
+    static const char* getEstimatorName(Estimator estimator);
+
+private:
+    uint32_t  _size;
+    Estimator _estimator;
+    int32_t*  _data;        // ring of samples indexed by sequence % _size
+    int32_t*  _sorted;      // the samples in the window, sorted
+    int32_t*  _scratch;     // deviations for the MAD
+    uint32_t* _min_q;       // sequence numbers, values increasing from head to tail
+    uint32_t* _max_q;       // sequence numbers, values decreasing from head to tail
+    uint32_t  _min_head;
+    uint32_t  _min_tail;
+    uint32_t  _max_head;
+    uint32_t  _max_tail;
+    uint32_t  _seq;         // sequence number of the next sample
+    uint32_t  _count;
+    int64_t   _sum;
+    int64_t   _sum_sq;
+
+    uint32_t lowerBound(int32_t value) const;
+};
+
+#endif // _OFFSET_FILTER_H
@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PIDControl.h"
+
+PIDControl::PIDControl(float kp, float ki, float kd)
+: _Kp(kp),
+  _Ki(ki),
+  _Kd(kd)
+{
+}
+
+void PIDControl::setGains(float kp, float ki, float kd)
+{
+    _Kp = kp;
+    _Ki = ki;
+    _Kd = kd;
+}
+
+/**
+ * one step of the loop, returns the (unrounded) output for the error (us).  limit
+ * is the most the integral may add to the output in either direction.
+*/
+float PIDControl::update(float error, float ff, float limit)
+{
+    _integral += error;
+    if ((_integral*_Ki) > limit)
+    {
+        _integral = limit/_Ki;
+    }
+    else if ((_integral*_Ki) < -limit)
+    {
+        _integral = -limit/_Ki;
+    }
+    _derivative     = error - _previous_error;
+    _previous_error = error;
+    return _Kp*error + _Ki*_integral + _Kd*_derivative + ff;
+}
+
+/**
+ * restart the loop, the learned drift in the integral is lost
+*/
+void PIDControl::reset()
+{
+    _integral       = 0;
+    _previous_error = 0;
+    _derivative     = 0;
+}
+
+/**
+ * the feed-forward moved by delta (output LSB), take it out of the integral so the
+ * output does not step.
+*/
+void PIDControl::shiftOutput(float delta)
+{
+    if (_Ki != 0)
+    {
+        _integral -= delta / _Ki;
+    }
+}
+
+/**
+ * set the integral from its share of the output (a saved state)
+*/
+void PIDControl::setIntegralOutput(float output)
+{
+    _integral = _Ki != 0 ? output / _Ki : 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PID_CONTROL_H
+#define _PID_CONTROL_H
+
+//
+// The PID law of the RTC discipline.  Once a second the error (target - filtered
+// offset, us) gives the aging value: Kp*error + Ki*integral + Kd*derivative plus the
+// feed-forward from the temperature model.  The integral is what holds the natural
+// drift of the RTC, it is limited to a share of the output and moved when the
+// feed-forward learns part of it.  Like ClockKalman it has no ESP-IDF dependencies
+// so a recorded offset log can be replayed through it on a host.
+//
+class PIDControl
+{
+public:
+    PIDControl(float kp, float ki, float kd);
+    void  setGains(float kp, float ki, float kd);
+    float update(float error, float ff, float limit);
+    void  reset();
+    void  resetIntegral()               { _integral = 0; }
+    void  clearError()                  { _previous_error = 0; }
+    void  setPreviousError(float error) { _previous_error = error; }
+    void  shiftOutput(float delta);
+    void  setIntegralOutput(float output);
+
+    float getKp() const                 { return _Kp; }
+    float getKi() const                 { return _Ki; }
+    float getKd() const                 { return _Kd; }
+    float getIntegral() const           { return _integral; }
+    float getIntegralOutput() const     { return _Ki * _integral; }
+    float getPreviousError() const      { return _previous_error; }
+    float getDerivative() const         { return _derivative; }
+
+private:
+    float _Kp;
+    float _Ki;
+    float _Kd;
+    float _integral       = 0.0;
+    float _previous_error = 0.0;
+    float _derivative     = 0.0;
+};
+
+#endif // _PID_CONTROL_H
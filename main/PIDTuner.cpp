@@ -0,0 +1,305 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PIDTuner.h"
+#include <math.h>
+
+// seconds in the BASE and STEP phases, the first SETTLE seconds of each are not
+// used for the fit so the loop delay and offset filter do not bias the slope
+#define PHASE_TIME   90
+#define PHASE_SETTLE 20
+
+// aging step in the STEP phase and the relay amplitude, in LSB
+#define STEP_SIZE    20
+#define RELAY_SIZE   10
+
+// relay hysteresis in us, keeps the offset noise from switching the relay
+#define RELAY_HYST   1.0
+
+// half cycles ignored at the start of the relay and the full cycles measured after
+#define RELAY_SKIP   2
+#define RELAY_CYCLES 4
+
+// the relay phase and the whole tuning are abandoned after these many seconds
+#define RELAY_TIMEOUT 900
+#define TUNE_TIMEOUT  1200
+
+// plausible range for the plant gain in ppm per LSB, the DS3231 is ~0.1
+#define GAIN_MIN     0.01
+#define GAIN_MAX     1.0
+
+PIDTuner::PIDTuner()
+{
+    resetFit();
+}
+
+void PIDTuner::resetFit()
+{
+    _n   = 0;
+    _st  = 0;
+    _sx  = 0;
+    _stt = 0;
+    _stx = 0;
+}
+
+void PIDTuner::addFit(float t, float x)
+{
+    _n   += 1;
+    _st  += t;
+    _sx  += x;
+    _stt += t*t;
+    _stx += t*x;
+}
+
+bool PIDTuner::getSlope(float* slopep) const
+{
+    double d = _n*_stt - _st*_st;
+    if (_n < 10 || d == 0)
+    {
+        return false;
+    }
+    *slopep = (_n*_stx - _st*_sx) / d;
+    return true;
+}
+
+void PIDTuner::start(float target, float bias, uint32_t now)
+{
+    _target   = target;
+    _base     = round(bias);
+    _output   = _base;
+    _start    = now;
+    _reason   = "";
+    _switches = 0;
+    _switch_time = 0;
+    _periods  = 0;
+    _amps     = 0;
+    _period_sum = 0;
+    _amp_sum  = 0;
+    next(BASE, now);
+}
+
+void PIDTuner::abort()
+{
+    if (isRunning())
+    {
+        fail("aborted");
+    }
+}
+
+void PIDTuner::next(State state, uint32_t now)
+{
+    _state = state;
+    _phase = now;
+    resetFit();
+}
+
+void PIDTuner::fail(const char* reason)
+{
+    _reason = reason;
+    _state  = FAILED;
+}
+
+/**
+ * feed the offset (us) for this interval, returns the aging output to apply
+*/
+float PIDTuner::update(float offset, uint32_t now)
+{
+    if (!isRunning())
+    {
+        return _output;
+    }
+    if (now - _start > TUNE_TIMEOUT)
+    {
+        fail("timeout");
+        return _output;
+    }
+
+    uint32_t t = now - _phase;
+    switch (_state)
+    {
+        case BASE:
+        case STEP:
+        {
+            if (t >= PHASE_SETTLE)
+            {
+                addFit(t, offset);
+            }
+            if (t < PHASE_TIME)
+            {
+                break;
+            }
+            float slope;
+            if (!getSlope(&slope))
+            {
+                fail("no offset samples");
+                break;
+            }
+            if (_state == BASE)
+            {
+                _slope0 = slope;
+                _step   = slope > 0 ? -STEP_SIZE : STEP_SIZE;
+                _output = _base + _step;
+                next(STEP, now);
+                break;
+            }
+            _gain = (slope - _slope0) / _step;
+            if (_gain < GAIN_MIN || _gain > GAIN_MAX)
+            {
+                fail("plant gain out of range");
+                break;
+            }
+            // the aging value that makes the offset stand still
+            _bias = _base - _slope0 / _gain;
+            if (fabs(_bias) > 127)
+            {
+                fail("bias out of range");
+                break;
+            }
+            _high   = offset < _target;
+            _output = _bias + (_high ? RELAY_SIZE : -RELAY_SIZE);
+            _peak_min = offset;
+            _peak_max = offset;
+            next(RELAY, now);
+            break;
+        }
+
+        case RELAY:
+            if (t > RELAY_TIMEOUT)
+            {
+                fail("no relay oscillation");
+                break;
+            }
+            if (relay(offset, now))
+            {
+                _state  = DONE;
+                _output = _bias;
+            }
+            break;
+
+        default:
+            break;
+    }
+    return _output;
+}
+
+/**
+ * relay step, returns true once enough cycles have been measured
+*/
+bool PIDTuner::relay(float offset, uint32_t now)
+{
+    if (offset < _peak_min)
+    {
+        _peak_min = offset;
+    }
+    if (offset > _peak_max)
+    {
+        _peak_max = offset;
+    }
+
+    // a positive output increases the offset, switch when it passes the target
+    bool high = _high;
+    if (_high && offset > _target + RELAY_HYST)
+    {
+        high = false;
+    }
+    else if (!_high && offset < _target - RELAY_HYST)
+    {
+        high = true;
+    }
+    if (high == _high)
+    {
+        return false;
+    }
+
+    _high    = high;
+    _output  = _bias + (_high ? RELAY_SIZE : -RELAY_SIZE);
+    _switches += 1;
+
+    // switching to high ends a full cycle (low peak to low peak)
+    if (_high && _switches > RELAY_SKIP)
+    {
+        if (_switch_time != 0)
+        {
+            _period_sum += now - _switch_time;
+            _periods    += 1;
+            _amp_sum    += (_peak_max - _peak_min) / 2;
+            _amps       += 1;
+        }
+        _switch_time = now;
+        _peak_min    = offset;
+        _peak_max    = offset;
+    }
+
+    if (_periods < RELAY_CYCLES)
+    {
+        return false;
+    }
+
+    _period = _period_sum / _periods;
+    float a = _amp_sum / _amps;
+    if (a <= RELAY_HYST)
+    {
+        fail("no relay amplitude");
+        return false;
+    }
+    // describing function of the relay with hysteresis h: Ku = 4d / (pi * sqrt(a^2 - h^2))
+    _ku = 4.0 * RELAY_SIZE / (M_PI * sqrt(a*a - RELAY_HYST*RELAY_HYST));
+
+    // for an integrating plant with a dead time L the offset ramps at gain*d and each
+    // half cycle is 2L plus the time to cross the 2h hysteresis band: Tu = 4L + 4h/(gain*d)
+    _delay = _period / 4 - RELAY_HYST / (_gain * RELAY_SIZE);
+    if (_delay < 0)
+    {
+        _delay = 0;
+    }
+
+    // Tyreus-Luyben PID: Kp = Ku/2.2, Ti = 2.2Tu, Td = Tu/6.3 at one second per interval
+    float ti = 2.2 * _period;
+    float td = _period / 6.3;
+    _kp = _ku / 2.2;
+    _ki = _kp / ti;
+    _kd = _kp * td;
+    return true;
+}
+
+const char* PIDTuner::getStateName(State state)
+{
+    switch (state)
+    {
+        case IDLE:
+            return "idle";
+        case BASE:
+            return "base";
+        case STEP:
+            return "step";
+        case RELAY:
+            return "relay";
+        case DONE:
+            return "done";
+        case FAILED:
+            return "failed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PID_TUNER_H
+#define _PID_TUNER_H
+
+#include <stdint.h>
+
+//
+// Automatic tuning of the RTC discipline PID.  The tuner takes over the aging
+// output and runs three bounded phases:
+//
+//   BASE  - hold the current bias and measure the RTC frequency (slope of the offset)
+//   STEP  - step the aging value (against the drift so the offset stays in range)
+//           and measure the new frequency, this gives the plant gain (ppm per LSB)
+//           and the bias that zeroes the frequency
+//   RELAY - relay feedback around the target (Astrom-Hagglund), the oscillation
+//           period and amplitude give the ultimate gain and the loop delay
+//
+// The bias is the aging value that held frequency at the temperature during the
+// tuning, it is only the feed-forward until the temperature model has learned.
+//
+// The gains are then derived with the Tyreus-Luyben rules, which are less aggressive
+// than Ziegler-Nichols and suit the slow, noisy RTC loop.  It is called once per
+// PID interval and has no ESP-IDF dependencies.
+//
+class PIDTuner
+{
+public:
+    enum State
+    {
+        IDLE = 0,
+        BASE,
+        STEP,
+        RELAY,
+        DONE,
+        FAILED,
+    };
+
+    PIDTuner();
+    void  start(float target, float bias, uint32_t now);
+    void  abort();
+    float update(float offset, uint32_t now);
+    bool  isRunning() const { return _state == BASE || _state == STEP || _state == RELAY; }
+    State getState() const  { return _state; }
+    const char* getReason() const { return _reason; } // why the tuning failed
+    uint32_t getElapsed(uint32_t now) const { return isRunning() ? now - _start : 0; }
+
+    float getGain() const   { return _gain; }   // ppm (us/s) per aging LSB
+    float getBias() const   { return _bias; }
+    float getPeriod() const { return _period; } // relay oscillation period, seconds
+    float getDelay() const  { return _delay; }  // loop delay, seconds
+    float getKu() const     { return _ku; }
+    float getKp() const     { return _kp; }
+    float getKi() const     { return _ki; }
+    float getKd() const     { return _kd; }
+
+    static const char* getStateName(State state);
+
+private:
+    State    _state   = IDLE;
+    const char* _reason = "";
+    float    _target  = 0;
+    uint32_t _start   = 0;  // start of the tuning
+    uint32_t _phase   = 0;  // start of the current phase
+
+    // linear fit of the offset over the current phase
+    double   _n, _st, _sx, _stt, _stx;
+
+    float    _slope0  = 0;
+    float    _step    = 0;
+    float    _base    = 0;
+    float    _output  = 0;
+    bool     _high    = false;
+    uint32_t _switches = 0;
+    uint32_t _switch_time = 0;
+    float    _period_sum = 0;
+    uint32_t _periods = 0;
+    float    _peak_min = 0;
+    float    _peak_max = 0;
+    float    _amp_sum = 0;
+    uint32_t _amps    = 0;
+
+    float    _gain    = 0;
+    float    _bias    = 0;
+    float    _period  = 0;
+    float    _delay   = 0;
+    float    _ku      = 0;
+    float    _kp      = 0;
+    float    _ki      = 0;
+    float    _kd      = 0;
+
+    void  resetFit();
+    void  addFit(float t, float x);
+    bool  getSlope(float* slopep) const;
+    void  next(State state, uint32_t now);
+    void  fail(const char* reason);
+    bool  relay(float offset, uint32_t now);
+};
+
+#endif // _PID_TUNER_H
@@ -26,12 +26,22 @@
 //#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
 #include "esp_log.h"
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
 #include <sys/time.h>
 #include "soc/soc.h"
 #include "driver/timer.h"
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_MCPWM) || defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+#include "PPSCapture.h"
+#endif
 
 static const char* TAG = "PPS";
 
+// intervals further than this from nominal (200ppm) are not used for the frequency estimate
+#define FREQ_MAX_ERROR (MicroSecondTimer::TICKS_PER_SEC/5000)
+// weight of a new interval in the frequency estimate
+#define FREQ_ALPHA     (1.0/16.0)
+
 PPS::PPS(MicroSecondTimer& timer, pps_data_t* data, PPS* ref)
 : _timer(timer),
   _data(data),
@@ -43,34 +53,137 @@ PPS::PPS(MicroSecondTimer& timer, pps_data_t* data, PPS* ref)
     {
         data->pps_ref = ref->_data;
     }
+#if defined(CONFIG_GPSNTP_PPS_PROFILE)
+    resetProfile();
+    data->pps_profile = &_profile;
+#endif
 }
 
-bool PPS::begin(gpio_num_t pps_pin, bool expect_negedge)
+bool PPS::begin(gpio_num_t pps_pin, bool expect_negedge, bool both_edges)
 {
     _pin = pps_pin;
-    _data->pps_pin = pps_pin;
+    _data->pps_pin          = pps_pin;
+    _data->pps_assert_level = expect_negedge ? 0 : 1;
+    _data->pps_both         = both_edges;
 
     if (_pin != GPIO_NUM_NC)
     {
         ESP_LOGI(TAG, "::begin configuring PPS pin %d", _pin);
         gpio_set_direction(_pin, GPIO_MODE_INPUT);
 
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_MCPWM)
+        ESP_LOGI(TAG, "::begin setup MCPWM capture");
+        return PPSCapture::getCapture().add(_timer, _data, _pin, expect_negedge, both_edges);
+#else
         ESP_LOGI(TAG, "::begin setup ppsISR for highint5");
         ESP_INTR_DISABLE(31);
         intr_matrix_set(1, ETS_GPIO_INTR_SOURCE, 31);
         ESP_INTR_ENABLE(31);
-        gpio_set_intr_type(_pin, expect_negedge ? GPIO_INTR_NEGEDGE : GPIO_INTR_POSEDGE);
+        if (both_edges)
+        {
+            ESP_LOGI(TAG, "::begin capturing assert and clear edges");
+            gpio_set_intr_type(_pin, GPIO_INTR_ANYEDGE);
+        }
+        else
+        {
+            gpio_set_intr_type(_pin, expect_negedge ? GPIO_INTR_NEGEDGE : GPIO_INTR_POSEDGE);
+        }
         gpio_intr_enable(_pin);
+#endif
     }
 
     return true;
 }
 
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+/**
+ * capture a pin the ISR already captures with the MCPWM capture as well, the edges
+ * are not put in the edge ring so the sync task does not see them twice.
+*/
+bool PPS::beginBench(gpio_num_t pps_pin, bool expect_negedge)
+{
+    _pin = pps_pin;
+    _data->pps_pin          = pps_pin;
+    _data->pps_assert_level = expect_negedge ? 0 : 1;
+    ESP_LOGI(TAG, "::beginBench setup MCPWM capture of pin %d", _pin);
+    return PPSCapture::getCapture().add(_timer, _data, _pin, expect_negedge, false, false);
+}
+#endif
+
 int PPS::getLevel()
 {
     return gpio_get_level(_pin);
 }
 
+/**
+ * get the pin this PPS is watching
+*/
+gpio_num_t PPS::getPin()
+{
+    return _pin;
+}
+
+/**
+ * get the current seconds and the timer ticks since the start of that second.
+*/
+uint32_t PPS::getElapsed(time_t* sec)
+{
+    uint32_t gen;
+    uint32_t elapsed;
+    // the ISR makes the generation odd while it updates and bumps it again when done,
+    // if it is odd or changed while we were reading then an edge came in and we go again.
+    do
+    {
+        gen     = _data->pps_gen;
+        *sec    = _data->pps_time;
+        elapsed = _timer.getValue() - _data->pps_last;
+    } while ((gen & 1) || gen != _data->pps_gen);
+    return elapsed;
+}
+
+/**
+ * scale elapsed ticks to nanoseconds using the measured oscillator frequency.  The
+ * reference PPS (GPS) is the better measure of a true second so it is used when it
+ * has an estimate.
+*/
+uint32_t PPS::getNanos(uint32_t elapsed)
+{
+    uint64_t nanos_per_tick;
+    if (_ref != nullptr && _ref->_freq_valid)
+    {
+        nanos_per_tick = _ref->getNanosPerTick();
+    }
+    else
+    {
+        nanos_per_tick = getNanosPerTick();
+    }
+
+    // 32x64 multiply in two halves so a late PPS (many seconds elapsed) can not overflow
+    uint64_t nanos = (uint64_t)elapsed * (uint32_t)(nanos_per_tick >> 32)
+                   + (((uint64_t)elapsed * (uint32_t)nanos_per_tick) >> 32);
+    // timer could be slightly off, insure we never return a full second (or more)!
+    if (nanos > 999999999)
+    {
+        nanos = 999999999;
+    }
+    return nanos;
+}
+
+/**
+ * read the 32.32 nanoseconds per tick, it is 64 bits so retry if it changed under us
+*/
+uint64_t PPS::getNanosPerTick()
+{
+    uint32_t gen;
+    uint64_t nanos_per_tick;
+    do
+    {
+        gen            = _freq_gen;
+        nanos_per_tick = _nanos_per_tick;
+    } while ((gen & 1) || gen != _freq_gen);
+    return nanos_per_tick;
+}
+
 /**
  * get current time & microseconds.
 */
@@ -78,23 +191,63 @@ time_t PPS::getTime(struct timeval* tv)
 {
     if (tv == nullptr)
     {
-        return _data->pps_time;
+        return getSeconds();
+    }
+
+    time_t sec;
+    uint32_t elapsed = getElapsed(&sec);
+    tv->tv_sec  = sec;
+    tv->tv_usec = getNanos(elapsed) / 1000;
+    return tv->tv_sec;
+}
+
+/**
+ * get current time & nanoseconds, this carries the full timer resolution.
+*/
+time_t PPS::getTime(struct timespec* ts)
+{
+    if (ts == nullptr)
+    {
+        return getSeconds();
     }
 
-    // edge case!  both seconds and _last_timer only change once a second, however,
-    // it changes via an interrupt so we make sure we have good values by making sure
-    // it is the same on second look
+    time_t sec;
+    uint32_t elapsed = getElapsed(&sec);
+    ts->tv_sec  = sec;
+    ts->tv_nsec = getNanos(elapsed);
+    return ts->tv_sec;
+}
+
+/**
+ * get the current second without the sub second part
+*/
+time_t PPS::getSeconds()
+{
+    return _data->pps_time;
+}
+
+/**
+ * get a coherent copy of the PPS data without blocking or disabling interrupts
+*/
+void PPS::snapshot(pps_snapshot_t* snap)
+{
+    uint32_t gen;
     do
     {
-        tv->tv_sec  = _data->pps_time;
-        tv->tv_usec = _timer.getValue() - _data->pps_last;
-        // timer could be slightly off, insure microseconds is not returned as (or more) than a full second!
-        if (tv->tv_usec > 999999)
-        {
-            tv->tv_usec = 999999;
-        }
-    } while (tv->tv_sec != _data->pps_time); // insure we stay on the same seconds (to go with the microseconds)
-    return tv->tv_sec;
+        gen               = _data->pps_gen;
+        snap->time        = _data->pps_time;
+        snap->last        = _data->pps_last;
+        snap->interval    = _data->pps_interval;
+        snap->offset      = _data->pps_offset;
+        snap->min         = _data->pps_min;
+        snap->max         = _data->pps_max;
+        snap->short_count = _data->pps_short;
+        snap->long_count  = _data->pps_long;
+        snap->clear_last  = _data->pps_clear_last;
+        snap->width       = _data->pps_width;
+        snap->phase_sum   = ((uint64_t)_data->pps_avg_hi << 32) | _data->pps_avg_lo;
+        snap->phase_count = _data->pps_avg_count;
+    } while ((gen & 1) || gen != _data->pps_gen);
 }
 
 /**
@@ -106,7 +259,7 @@ void PPS::setTime(time_t time)
 }
 
 /**
- * get the minimum time in microseconds between PPS pulses
+ * get the minimum time in timer ticks between PPS pulses
 */
 uint32_t PPS::getTimerMin()
 {
@@ -122,7 +275,7 @@ uint32_t PPS::getTimerLast()
 }
 
 /**
- * get the maximum time in microseconds between PPS pulses
+ * get the maximum time in timer ticks between PPS pulses
 */
 uint32_t PPS::getTimerMax()
 {
@@ -130,7 +283,7 @@ uint32_t PPS::getTimerMax()
 }
 
 /**
- * get the interval in microseconds between PPS pulses
+ * get the interval in timer ticks between PPS pulses
 */
 uint32_t PPS::getTimerInterval()
 {
@@ -154,7 +307,15 @@ uint32_t PPS::getTimerLong()
 }
 
 /**
- * get the offset from ref
+ * get the pulse width in timer ticks, only measured in dual edge mode
+*/
+uint32_t PPS::getTimerWidth()
+{
+    return _data->pps_width;
+}
+
+/**
+ * get the offset from ref in timer ticks
 */
 int32_t PPS::getOffset()
 {
@@ -176,3 +337,191 @@ void PPS::setDisable(bool disable)
 {
     _data->pps_disabled = disable;
 }
+
+/**
+ * fold the latest interval into the oscillator frequency estimate, call
+ * this at least once a second from a single task.
+*/
+void PPS::updateFrequency()
+{
+    pps_snapshot_t snap;
+    snapshot(&snap);
+    if (snap.time == _freq_time)
+    {
+        return;
+    }
+    _freq_time = snap.time;
+
+    int32_t error = snap.interval - MicroSecondTimer::TICKS_PER_SEC;
+    if (abs(error) > FREQ_MAX_ERROR)
+    {
+        return;
+    }
+
+    if (_ticks_per_sec == 0.0)
+    {
+        _ticks_per_sec = snap.interval;
+    }
+    else
+    {
+        _jitter        += (fabs((double)snap.interval - _ticks_per_sec) - _jitter) * FREQ_ALPHA;
+        _ticks_per_sec += ((double)snap.interval - _ticks_per_sec) * FREQ_ALPHA;
+    }
+
+    uint64_t nanos_per_tick = (uint64_t)(4294967296.0 * 1000000000.0 / _ticks_per_sec + 0.5);
+    _freq_gen       += 1;
+    _nanos_per_tick  = nanos_per_tick;
+    _freq_gen       += 1;
+    _freq_valid      = true;
+    ESP_LOGV(TAG, "::updateFrequency pin %d interval=%u ticks/sec=%0.3f ns/tick=%0.9f",
+                  _pin, snap.interval, _ticks_per_sec, nanos_per_tick/4294967296.0);
+}
+
+/**
+ * get the smoothed number of timer ticks in one second of this PPS, 0 if unknown
+*/
+double PPS::getTicksPerSecond()
+{
+    return _ticks_per_sec;
+}
+
+/**
+ * get the best estimate of the timer ticks in a true second on this PPS timebase,
+ * the same scale getTime() uses.
+*/
+double PPS::getSecondTicks()
+{
+    if (_ref != nullptr && _ref->_freq_valid)
+    {
+        return _ref->_ticks_per_sec;
+    }
+    if (_freq_valid)
+    {
+        return _ticks_per_sec;
+    }
+    return MicroSecondTimer::TICKS_PER_SEC;
+}
+
+/**
+ * get the smoothed deviation in timer ticks of each interval from the
+ * measured second, this is the capture jitter of this PPS
+*/
+double PPS::getJitter()
+{
+    return _jitter;
+}
+
+/**
+ * copy the ISR profile, returns false if profiling is not enabled
+*/
+bool PPS::getProfile(pps_profile_t* profile)
+{
+#if defined(CONFIG_GPSNTP_PPS_PROFILE)
+    memcpy(profile, &_profile, sizeof(pps_profile_t));
+    return true;
+#else
+    memset(profile, 0, sizeof(pps_profile_t));
+    return false;
+#endif
+}
+
+/**
+ * clear the ISR profile
+*/
+void PPS::resetProfile()
+{
+#if defined(CONFIG_GPSNTP_PPS_PROFILE)
+    memset(&_profile, 0, sizeof(pps_profile_t));
+    _profile.capture_min = UINT32_MAX;
+    _profile.total_min   = UINT32_MAX;
+#endif
+}
+
+/**
+ * set the number of pulses per second, the receiver must be set to the same
+ * rate with its pulses aligned to the top of second.
+*/
+void PPS::setRate(uint32_t rate)
+{
+    _data->pps_rate = rate;
+}
+
+/**
+ * set the CPU interrupt mask raised by the ISR after each edge it pushes to the
+ * edge ring, 0 for none.  It must be a software interrupt on the PPS interrupt's core.
+*/
+void PPS::setNotify(uint32_t mask)
+{
+    _data->pps_notify = mask;
+}
+
+/**
+ * change the reference PPS, the ISR measures the offset from it from the next
+ * edge and its frequency is used for interpolation.
+*/
+void PPS::setRef(PPS* ref)
+{
+    _ref           = ref;
+    _data->pps_ref = ref != nullptr ? ref->_data : nullptr;
+}
+
+/**
+ * get the number of pulses per second
+*/
+uint32_t PPS::getRate()
+{
+    return _data->pps_rate > 1 ? _data->pps_rate : 1;
+}
+
+/**
+ * work out the pulses to move the ISR's top of second by (see shiftTop) given the
+ * timer value of the real top of second to within half a pulse, it may be a few
+ * seconds either side of the last top of second.
+*/
+uint32_t PPS::getTopShift(uint32_t timer)
+{
+    uint32_t rate = getRate();
+    if (rate < 2)
+    {
+        return 0;
+    }
+    pps_snapshot_t snap;
+    snapshot(&snap);
+    double  period = getSecondTicks() / rate;
+    int32_t pulses = (int32_t)lround((int32_t)(timer - snap.last) / period) % (int32_t)rate;
+    if (pulses < 0)
+    {
+        pulses += rate;
+    }
+    return (rate - pulses) % rate;
+}
+
+/**
+ * move the top of second by pulses, takes effect at the next top of second
+*/
+void PPS::shiftTop(uint32_t pulses)
+{
+    _data->pps_sub_adjust = pulses % getRate();
+}
+
+/**
+ * with a timepulse faster than 1Hz get the correction in ticks to the top of second
+ * edge before snap.last from averaging it with all the sub second pulses that followed.
+ * Returns false if the pulses for that second are not all there.
+*/
+bool PPS::getPhaseCorrection(const pps_snapshot_t* snap, int32_t* correction)
+{
+    uint32_t rate = getRate();
+    if (rate < 2 || snap->phase_count != rate - 1)
+    {
+        return false;
+    }
+
+    // each sub pulse k is k periods after the top of second plus its own noise,
+    // the mean of those differences (0 for the top itself) is the correction.
+    double period = (double)snap->interval / rate;
+    double n      = snap->phase_count;
+    double sum    = (double)snap->phase_sum - period * n * (n + 1) / 2.0;
+    *correction   = (int32_t)round(sum / rate);
+    return true;
+}
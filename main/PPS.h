@@ -31,29 +31,22 @@
 #include "driver/gpio.h"
 #include "driver/timer.h"
 #include "MicroSecondTimer.h"
-
-typedef struct pps_data
-{
-    volatile uint32_t pps_pin;
-    volatile uint32_t pps_last;
-    volatile uint32_t pps_time;
-    volatile uint32_t pps_min;
-    volatile uint32_t pps_max;
-    volatile uint32_t pps_interval;
-    volatile int32_t  pps_offset;
-    volatile struct pps_data* pps_ref;
-    volatile uint32_t pps_short;
-    volatile uint32_t pps_long;
-    volatile uint32_t pps_disabled;
-} pps_data_t;
+#include "PPSData.h"
 
 class PPS
 {
 public:
     PPS(MicroSecondTimer& timer, pps_data_t *data, PPS* ref = nullptr);
-    bool     begin(gpio_num_t pps_pin = GPIO_NUM_NC, bool expect_negedge = false);
+    bool     begin(gpio_num_t pps_pin = GPIO_NUM_NC, bool expect_negedge = false, bool both_edges = false);
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+    bool     beginBench(gpio_num_t pps_pin, bool expect_negedge = false);
+#endif
     int      getLevel();
+    gpio_num_t getPin();
     time_t   getTime(struct timeval* tv);
+    time_t   getTime(struct timespec* ts);
+    time_t   getSeconds();
+    void     snapshot(pps_snapshot_t* snap);
     void     setTime(time_t time);
     uint32_t getTimerLast();
     uint32_t getTimerMin();
@@ -61,9 +54,23 @@ public:
     uint32_t getTimerInterval();
     uint32_t getTimerShort();
     uint32_t getTimerLong();
+    uint32_t getTimerWidth();
     int32_t  getOffset();
     void     resetOffset();
     void     setDisable(bool disable);
+    void     updateFrequency();
+    double   getTicksPerSecond();
+    double   getSecondTicks();
+    double   getJitter();
+    void     setRate(uint32_t rate);
+    uint32_t getRate();
+    void     setNotify(uint32_t mask);
+    void     setRef(PPS* ref);
+    uint32_t getTopShift(uint32_t timer);
+    void     shiftTop(uint32_t pulses);
+    bool     getPhaseCorrection(const pps_snapshot_t* snap, int32_t* correction);
+    bool     getProfile(pps_profile_t* profile);
+    void     resetProfile();
 
 protected:
     MicroSecondTimer& _timer;
@@ -71,6 +78,22 @@ protected:
     PPS*              _ref;
     gpio_num_t         _pin = GPIO_NUM_NC;
 private:
+    // smoothed ticks per second of the local oscillator measured against this PPS
+    double            _ticks_per_sec    = 0.0;
+    time_t            _freq_time        = 0;
+    // smoothed absolute deviation of the interval from _ticks_per_sec
+    double            _jitter           = 0.0;
+    // nanoseconds per tick (32.32 fixed point) derived from _ticks_per_sec, 16.16
+    // would be 0.6ppm per LSB at 40MHz.  Odd _freq_gen while it is being written.
+    volatile uint64_t _nanos_per_tick   = (uint64_t)MicroSecondTimer::NANOS_PER_TICK_Q16 << 16;
+    volatile uint32_t _freq_gen         = 0;
+    volatile bool     _freq_valid       = false;
+#if defined(CONFIG_GPSNTP_PPS_PROFILE)
+    pps_profile_t     _profile;
+#endif
+    uint32_t getElapsed(time_t* sec);
+    uint32_t getNanos(uint32_t elapsed);
+    uint64_t getNanosPerTick();
     static void pps(void* data);
 
 };
@@ -0,0 +1,185 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PPSCapture.h"
+#include "PPSEdgeReader.h"
+//#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#include "esp_log.h"
+#include "soc/mcpwm_struct.h"
+#include "freertos/xtensa_api.h"
+
+static const char* TAG = "PPSCapture";
+
+#define CAPTURE_UNIT        MCPWM_UNIT_0
+#define CAPTURE_SW_CHANNEL  2
+#define CAPTURE_INT_BIT(n)  (1 << (27 + (n))) // CAP0_INT is bit 27 in MCPWM_INT_ST
+
+static const mcpwm_io_signals_t     capture_io[PPSCapture::MAX_CHANNELS]     = {MCPWM_CAP_0, MCPWM_CAP_1};
+static const mcpwm_capture_signal_t capture_signal[PPSCapture::MAX_CHANNELS] = {MCPWM_SELECT_CAP0, MCPWM_SELECT_CAP1};
+
+PPSCapture& PPSCapture::getCapture()
+{
+    static PPSCapture* capture;
+    if (capture == nullptr)
+    {
+        capture = new PPSCapture();
+    }
+
+    return *capture;
+}
+
+PPSCapture::PPSCapture()
+: _model(MicroSecondTimer::TICKS_PER_SEC)
+{
+}
+
+/**
+ * start capturing edges on pin into data, without ring the edges are only kept in
+ * data (the capture bench watches a pin the ISR also captures).
+*/
+bool PPSCapture::add(MicroSecondTimer& timer, pps_data_t* data, gpio_num_t pin, bool expect_negedge, bool both_edges, bool ring)
+{
+    if (_channels >= MAX_CHANNELS)
+    {
+        ESP_LOGE(TAG, "::add no capture channel left for pin %d", pin);
+        return false;
+    }
+
+    uint32_t channel = _channels;
+    ESP_LOGI(TAG, "::add capture channel %u for pin %d", channel, pin);
+
+    esp_err_t err = mcpwm_gpio_init(CAPTURE_UNIT, capture_io[channel], pin);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::add mcpwm_gpio_init failed: %d (%s)", err, esp_err_to_name(err));
+        return false;
+    }
+
+    err = mcpwm_capture_enable(CAPTURE_UNIT, capture_signal[channel], expect_negedge ? MCPWM_NEG_EDGE : MCPWM_POS_EDGE, 0);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::add mcpwm_capture_enable failed: %d (%s)", err, esp_err_to_name(err));
+        return false;
+    }
+
+    if (both_edges)
+    {
+        // the driver only does one edge, mode bit 0 is negedge and bit 1 is posedge
+        MCPWM0.cap_cfg_ch[channel].mode = 3;
+    }
+
+    if (_channels == 0)
+    {
+        _timer = &timer;
+
+        // the software capture channel is only used to read the capture timer
+        err = mcpwm_capture_enable(CAPTURE_UNIT, MCPWM_SELECT_CAP2, MCPWM_POS_EDGE, 0);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "::add mcpwm_capture_enable (sw) failed: %d (%s)", err, esp_err_to_name(err));
+            return false;
+        }
+
+        err = mcpwm_isr_register(CAPTURE_UNIT, isr, this, ESP_INTR_FLAG_IRAM, nullptr);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "::add mcpwm_isr_register failed: %d (%s)", err, esp_err_to_name(err));
+            return false;
+        }
+    }
+
+    _data[channel] = data;
+    _ring[channel] = ring;
+    _channels     += 1;
+    MCPWM0.int_ena.val |= CAPTURE_INT_BIT(channel);
+    return true;
+}
+
+/**
+ * push an edge into the edge ring the same way highint5 does
+*/
+void IRAM_ATTR PPSCapture::pushEdge(pps_data_t* data, uint32_t timer, uint32_t flags)
+{
+    uint32_t    seq  = pps_edge_ring.head;
+    pps_edge_t* edge = &pps_edge_ring.edges[seq & (PPS_EDGE_RING_SIZE-1)];
+    edge->seq   = seq;
+    edge->timer = timer;
+    edge->pin   = data->pps_pin | flags;
+    edge->time  = data->pps_time;
+    pps_edge_ring.head = seq + 1;
+    if (data->pps_notify != 0)
+    {
+        xt_set_intset(data->pps_notify);
+    }
+}
+
+void IRAM_ATTR PPSCapture::isr(void* arg)
+{
+    PPSCapture* capture = static_cast<PPSCapture*>(arg);
+    uint32_t status = MCPWM0.int_st.val;
+
+    // latch the capture timer and read our timer as close together as we can, the
+    // fixed delay between them is the same for every edge so it cancels out.
+    MCPWM0.cap_cfg_ch[CAPTURE_SW_CHANNEL].sw = 1;
+    uint32_t timer   = capture->_timer->getValue();
+    uint32_t cap_now = MCPWM0.cap_val_ch[CAPTURE_SW_CHANNEL];
+
+    MCPWM0.int_clr.val = status;
+
+    for (uint32_t channel = 0; channel < capture->_channels; ++channel)
+    {
+        if (!(status & CAPTURE_INT_BIT(channel)))
+        {
+            continue;
+        }
+
+        pps_data_t* data = capture->_data[channel];
+        if (data->pps_disabled)
+        {
+            continue;
+        }
+
+        // capture timer runs at the APB clock, scale the age of the edge to our timer
+        uint32_t age = (cap_now - MCPWM0.cap_val_ch[channel]) / MICRO_SECOND_TIMER_DIVIDER;
+        uint32_t edge_timer = timer - age;
+
+        // in dual edge mode the level after the captured edge tells assert from clear
+        uint32_t level = (MCPWM0.cap_status.val & (1 << channel)) ? 0 : 1;
+        if (data->pps_both && level != data->pps_assert_level)
+        {
+            capture->_model.clear(data, edge_timer);
+            if (capture->_ring[channel])
+            {
+                pushEdge(data, edge_timer, PPS_EDGE_CLEAR);
+            }
+            continue;
+        }
+
+        if (capture->_model.edge(data, edge_timer) && capture->_ring[channel])
+        {
+            pushEdge(data, edge_timer, 0);
+        }
+    }
+}
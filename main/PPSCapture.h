@@ -0,0 +1,61 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PPS_CAPTURE_H
+#define _PPS_CAPTURE_H
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "driver/mcpwm.h"
+#include "MicroSecondTimer.h"
+#include "PPSData.h"
+#include "PPSModel.h"
+
+//
+// Hardware capture of PPS edges using the MCPWM capture unit.  The edge time
+// is latched by the capture timer (APB clock) so ISR entry latency does not
+// matter, the ISR converts it to our timer and applies the same logic as
+// highint5 via PPSModel.
+//
+class PPSCapture
+{
+public:
+    static PPSCapture& getCapture();
+    bool add(MicroSecondTimer& timer, pps_data_t* data, gpio_num_t pin, bool expect_negedge, bool both_edges = false, bool ring = true);
+
+    static const uint32_t MAX_CHANNELS = 2; // capture 2 is used to latch "now"
+
+private:
+    PPSCapture();
+    MicroSecondTimer* _timer    = nullptr;
+    PPSModel          _model;
+    uint32_t          _channels = 0;
+    pps_data_t*       _data[MAX_CHANNELS] = {nullptr};
+    bool              _ring[MAX_CHANNELS] = {false}; // push the edges to the edge ring
+
+    static void pushEdge(pps_data_t* data, uint32_t timer, uint32_t flags);
+    static void isr(void* arg);
+};
+
+#endif // _PPS_CAPTURE_H
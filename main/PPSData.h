@@ -0,0 +1,102 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PPS_DATA_H
+#define _PPS_DATA_H
+
+//
+// Plain data shared with highint5.S, no ESP-IDF includes so it can be built on a host.
+//
+#include <stdint.h>
+#include <time.h>
+
+#define PPS_PROFILE_BUCKETS 16
+
+//
+// ISR cycle counts, filled by highint5 when CONFIG_GPSNTP_PPS_PROFILE is set.
+// Histogram bucket n counts values that have n significant bits.
+//
+typedef struct pps_profile
+{
+    volatile uint32_t count;
+    volatile uint32_t capture_min;  // cycles from ISR entry to reading the timer
+    volatile uint32_t capture_max;
+    volatile uint32_t total_min;    // cycles from ISR entry to the end of the update
+    volatile uint32_t total_max;
+    volatile uint32_t capture_hist[PPS_PROFILE_BUCKETS];
+    volatile uint32_t total_hist[PPS_PROFILE_BUCKETS];
+} pps_profile_t;
+
+typedef struct pps_data
+{
+    volatile uint32_t pps_pin;
+    volatile uint32_t pps_last;
+    volatile uint32_t pps_time;
+    volatile uint32_t pps_min;
+    volatile uint32_t pps_max;
+    volatile uint32_t pps_interval;
+    volatile int32_t  pps_offset;
+    volatile struct pps_data* pps_ref;
+    volatile uint32_t pps_short;
+    volatile uint32_t pps_long;
+    volatile uint32_t pps_disabled;
+    volatile uint32_t pps_gen;      // incremented by the ISR before and after an update
+    pps_profile_t*    pps_profile;  // ISR profile or nullptr
+    volatile uint32_t pps_both;     // non zero to capture both assert and clear edges
+    volatile uint32_t pps_assert_level; // pin level after the assert edge
+    volatile uint32_t pps_clear_last;   // timer value of the last clear edge
+    volatile uint32_t pps_width;    // ticks from assert to clear
+    volatile uint32_t pps_rate;     // pulses per second, 0 or 1 for a 1Hz pulse
+    volatile uint32_t pps_sub;      // pulses since the top of second pulse
+    volatile uint32_t pps_sub_adjust;   // pps_sub after the next top of second, moves the top of second
+    volatile uint32_t pps_phase_lo; // sum of ticks from the top of second to each sub second pulse
+    volatile uint32_t pps_phase_hi;
+    volatile uint32_t pps_phase_count;
+    volatile uint32_t pps_avg_lo;   // pps_phase & pps_phase_count of the last full second
+    volatile uint32_t pps_avg_hi;
+    volatile uint32_t pps_avg_count;
+    volatile uint32_t pps_notify;   // CPU interrupt mask raised after each edge pushed to the ring
+} pps_data_t;
+
+//
+// A coherent copy of the PPS data, all from the same edge.
+//
+typedef struct pps_snapshot
+{
+    time_t   time;
+    uint32_t last;
+    uint32_t interval;
+    int32_t  offset;
+    uint32_t min;
+    uint32_t max;
+    uint32_t short_count;
+    uint32_t long_count;
+    uint32_t clear_last;
+    uint32_t width;
+    uint64_t phase_sum;     // sub second pulse phase of the second before last
+    uint32_t phase_count;
+} pps_snapshot_t;
+
+#endif // _PPS_DATA_H
@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PPSEdgeReader.h"
+//#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#include "esp_log.h"
+
+static const char* TAG = "PPSEdgeReader";
+
+PPSEdgeReader::PPSEdgeReader(pps_edge_ring_t* ring)
+: _ring(ring),
+  _tail(ring->head)
+{
+}
+
+/**
+ * read the next edge, returns false if there are no new edges.
+*/
+bool PPSEdgeReader::read(pps_edge_t* edge)
+{
+    while (true)
+    {
+        uint32_t head = _ring->head;
+        if (head == _tail)
+        {
+            return false;
+        }
+
+        // we fell too far behind, skip to the oldest edge still in the ring
+        if (head - _tail > PPS_EDGE_RING_SIZE)
+        {
+            uint32_t lost = head - _tail - PPS_EDGE_RING_SIZE;
+            _dropped += lost;
+            _tail    += lost;
+            ESP_LOGW(TAG, "::read dropped %u edges", lost);
+        }
+
+        pps_edge_t* slot = &_ring->edges[_tail & (PPS_EDGE_RING_SIZE-1)];
+        edge->seq   = slot->seq;
+        edge->timer = slot->timer;
+        edge->pin   = slot->pin;
+        edge->time  = slot->time;
+
+        // if the sequence changed while we were copying then the ISR has
+        // lapped us and overwritten this slot, go around and resync.
+        if (edge->seq == _tail && slot->seq == _tail)
+        {
+            _tail += 1;
+            return true;
+        }
+        ESP_LOGD(TAG, "::read slot %u overwritten while reading", _tail);
+    }
+}
+
+/**
+ * number of edges waiting to be read (may be more than the ring holds)
+*/
+uint32_t PPSEdgeReader::available()
+{
+    return _ring->head - _tail;
+}
+
+/**
+ * get the number of edges that were overwritten before they could be read
+*/
+uint32_t PPSEdgeReader::getDropped()
+{
+    return _dropped;
+}
+
+/**
+ * discard any edges not yet read
+*/
+void PPSEdgeReader::skip()
+{
+    _tail = _ring->head;
+}
@@ -0,0 +1,77 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PPS_EDGE_READER_H
+#define _PPS_EDGE_READER_H
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+//
+// Must be a power of 2 and match PPS_RING_SIZE in highint5.S
+//
+#define PPS_EDGE_RING_SIZE 64
+
+// or'ed into the pin of clear (trailing) edges in dual edge mode
+#define PPS_EDGE_CLEAR     0x100
+
+typedef struct pps_edge
+{
+    volatile uint32_t seq;   // sequence number, written first so a reader can detect an overwrite
+    volatile uint32_t timer; // timer value captured for this edge
+    volatile uint32_t pin;   // pin of the channel that saw the edge, PPS_EDGE_CLEAR for clear edges
+    volatile uint32_t time;  // seconds counter of the channel after this edge
+} pps_edge_t;
+
+typedef struct pps_edge_ring
+{
+    volatile uint32_t head;  // sequence number of the next edge to be written
+    uint32_t          reserved[3];
+    pps_edge_t        edges[PPS_EDGE_RING_SIZE];
+} pps_edge_ring_t;
+
+extern pps_edge_ring_t pps_edge_ring; // in highint5.S
+
+//
+// Each reader has its own position in the ring so every consumer sees every
+// edge exactly once.  The ISR is the only writer and never waits for readers,
+// if a reader falls more than PPS_EDGE_RING_SIZE edges behind the oldest
+// edges are lost and counted as dropped.
+//
+class PPSEdgeReader
+{
+public:
+    explicit PPSEdgeReader(pps_edge_ring_t* ring = &pps_edge_ring);
+    bool     read(pps_edge_t* edge);
+    uint32_t available();
+    uint32_t getDropped();
+    void     skip();
+
+private:
+    pps_edge_ring_t* _ring;
+    uint32_t         _tail;
+    uint32_t         _dropped = 0;
+};
+
+#endif // _PPS_EDGE_READER_H
@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PPSModel.h"
+#if __has_include("esp_attr.h")
+#include "esp_attr.h"   // PPSCapture calls edge() from an IRAM ISR
+#else
+#define IRAM_ATTR
+#endif
+
+// the ISR does not compute stats until the seconds counter has been set
+#define PPS_FIRST_STATS_TIME 12
+
+PPSModel::PPSModel(uint32_t ticks_per_sec)
+: _ticks_per_sec(ticks_per_sec),
+  _short_value(ticks_per_sec - ticks_per_sec/2000), // 500us
+  _long_value(ticks_per_sec + ticks_per_sec/2000)
+{
+}
+
+/**
+ * apply one edge to the channel data, mirroring highint5.S step for step.
+ * All comparisons are signed just like the blt/blti in the ISR.  Returns
+ * true if the edge was a top of second edge (the ISR puts those in the ring).
+*/
+bool IRAM_ATTR PPSModel::edge(pps_data_t* data, uint32_t timer) const
+{
+    if (data->pps_disabled)
+    {
+        return false;
+    }
+
+    int32_t rate = data->pps_rate;
+    if (rate >= 2)
+    {
+        int32_t sub = data->pps_sub + 1;
+        if (sub < rate)
+        {
+            data->pps_gen   = data->pps_gen + 1;
+            data->pps_sub   = sub;
+            uint32_t phase  = timer - data->pps_last;
+            uint32_t lo     = data->pps_phase_lo;
+            data->pps_phase_lo = lo + phase;
+            if (lo + phase < lo)
+            {
+                data->pps_phase_hi = data->pps_phase_hi + 1;
+            }
+            data->pps_phase_count = data->pps_phase_count + 1;
+            data->pps_gen   = data->pps_gen + 1;
+            return false;
+        }
+    }
+
+    data->pps_gen = data->pps_gen + 1;
+
+    data->pps_sub         = data->pps_sub_adjust;
+    data->pps_sub_adjust  = 0;
+    data->pps_avg_lo      = data->pps_phase_lo;
+    data->pps_avg_hi      = data->pps_phase_hi;
+    data->pps_avg_count   = data->pps_phase_count;
+    data->pps_phase_lo    = 0;
+    data->pps_phase_hi    = 0;
+    data->pps_phase_count = 0;
+
+    int32_t interval = timer - data->pps_last;
+    data->pps_last   = timer;
+
+    int32_t time     = data->pps_time;
+    data->pps_time   = time + 1;
+
+    if (time >= PPS_FIRST_STATS_TIME)
+    {
+        data->pps_interval = interval;
+
+        bool skip_short = false;
+        if (interval >= _long_value)
+        {
+            data->pps_long = data->pps_long + 1;
+            data->pps_max  = 0;
+            skip_short     = true;
+        }
+        else if (interval >= (int32_t)data->pps_max)
+        {
+            data->pps_max = interval;
+        }
+
+        bool skip_min = false;
+        if (!skip_short && interval <= _short_value)
+        {
+            data->pps_short = data->pps_short + 1;
+            data->pps_min   = 0;
+            skip_min        = true;
+        }
+
+        if (!skip_min && (data->pps_min == 0 || interval <= (int32_t)data->pps_min))
+        {
+            data->pps_min = interval;
+        }
+
+        volatile pps_data_t* ref = data->pps_ref;
+        if (ref != nullptr)
+        {
+            int32_t offset = data->pps_last - ref->pps_last;
+            if (offset >= _ticks_per_sec/2)
+            {
+                offset -= _ticks_per_sec;
+            }
+            else if (offset <= -_ticks_per_sec/2)
+            {
+                offset += _ticks_per_sec;
+            }
+            data->pps_offset = offset;
+        }
+    }
+
+    data->pps_gen = data->pps_gen + 1;
+    return true;
+}
+
+/**
+ * apply a clear (trailing) edge in dual edge mode, only the edge time
+ * and the pulse width change.
+*/
+void IRAM_ATTR PPSModel::clear(pps_data_t* data, uint32_t timer) const
+{
+    if (data->pps_disabled)
+    {
+        return;
+    }
+
+    data->pps_gen        = data->pps_gen + 1;
+    data->pps_clear_last = timer;
+    data->pps_width      = timer - data->pps_last;
+    data->pps_gen        = data->pps_gen + 1;
+}
@@ -0,0 +1,53 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PPS_MODEL_H
+#define _PPS_MODEL_H
+
+#include "PPSData.h"
+
+//
+// C++ reference for the capture and statistics logic in highint5.S.  Given the
+// data for a channel and the timer value of an edge it makes exactly the same
+// changes to pps_data_t as the ISR does.  It has no ESP-IDF dependencies so it
+// can also be built and driven on a host.
+//
+class PPSModel
+{
+public:
+    explicit PPSModel(uint32_t ticks_per_sec);
+    bool edge(pps_data_t* data, uint32_t timer) const;
+    void clear(pps_data_t* data, uint32_t timer) const;
+
+    uint32_t getShortValue() const { return _short_value; }
+    uint32_t getLongValue() const { return _long_value; }
+
+private:
+    int32_t _ticks_per_sec;
+    int32_t _short_value;
+    int32_t _long_value;
+};
+
+#endif // _PPS_MODEL_H
@@ -0,0 +1,130 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PPSModelCheck.h"
+//#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#include "esp_log.h"
+#include <string.h>
+
+static const char* TAG = "PPSModelCheck";
+
+PPSModelCheck::PPSModelCheck(PPS& gpspps, PPS& rtcpps)
+: _model(MicroSecondTimer::TICKS_PER_SEC),
+  _gpspps(gpspps),
+  _rtcpps(rtcpps)
+{
+    memset(&_gps_data, 0, sizeof(_gps_data));
+    memset(&_rtc_data, 0, sizeof(_rtc_data));
+    _rtc_data.pps_ref = &_gps_data;
+}
+
+/**
+ * run any new edges through the model and compare, call this often enough
+ * that the ISR data has not moved on to the next edge.
+*/
+void PPSModelCheck::process()
+{
+    pps_edge_t edge;
+    while (_edges.read(&edge))
+    {
+        if (edge.pin == (uint32_t)_gpspps.getPin())
+        {
+            check("GPS", _gpspps, &_gps_data, &_gps_synced, edge);
+        }
+        else if (edge.pin == (uint32_t)_rtcpps.getPin())
+        {
+            check("RTC", _rtcpps, &_rtc_data, &_rtc_synced, edge);
+        }
+    }
+}
+
+void PPSModelCheck::check(const char* name, PPS& pps, pps_data_t* data, bool* synced, const pps_edge_t& edge)
+{
+    pps_snapshot_t snap;
+    pps.snapshot(&snap);
+
+    // the seconds are set from outside the ISR so take them from the edge
+    data->pps_time = edge.time - 1;
+    _model.edge(data, edge.timer);
+
+    // the ISR has already moved on to another edge, nothing to compare against
+    if (snap.last != edge.timer)
+    {
+        ESP_LOGD(TAG, "::check %s edge %u is stale", name, edge.seq);
+        return;
+    }
+
+    if (*synced)
+    {
+        _checked += 1;
+        if (snap.interval    != data->pps_interval
+         || snap.min         != data->pps_min
+         || snap.max         != data->pps_max
+         || snap.short_count != data->pps_short
+         || snap.long_count  != data->pps_long
+         || snap.offset      != data->pps_offset)
+        {
+            _mismatches += 1;
+            ESP_LOGE(TAG, "::check %s edge %u mismatch (isr/model): interval=%u/%u min=%u/%u max=%u/%u short=%u/%u long=%u/%u offset=%d/%d",
+                          name, edge.seq,
+                          snap.interval, data->pps_interval,
+                          snap.min, data->pps_min,
+                          snap.max, data->pps_max,
+                          snap.short_count, data->pps_short,
+                          snap.long_count, data->pps_long,
+                          snap.offset, data->pps_offset);
+            *synced = false;
+        }
+    }
+
+    // (re)start the model from the ISR state
+    if (!*synced)
+    {
+        data->pps_interval = snap.interval;
+        data->pps_min      = snap.min;
+        data->pps_max      = snap.max;
+        data->pps_short    = snap.short_count;
+        data->pps_long     = snap.long_count;
+        data->pps_offset   = snap.offset;
+        *synced            = true;
+        ESP_LOGI(TAG, "::check %s model synced at edge %u", name, edge.seq);
+    }
+}
+
+/**
+ * get the number of edges compared
+*/
+uint32_t PPSModelCheck::getChecked()
+{
+    return _checked;
+}
+
+/**
+ * get the number of edges where the ISR and model disagreed
+*/
+uint32_t PPSModelCheck::getMismatches()
+{
+    return _mismatches;
+}
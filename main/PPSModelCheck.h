@@ -0,0 +1,60 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PPS_MODEL_CHECK_H
+#define _PPS_MODEL_CHECK_H
+
+#include "PPS.h"
+#include "PPSModel.h"
+#include "PPSEdgeReader.h"
+
+//
+// Differential test on target: replays every edge from the edge ring through
+// PPSModel and compares the result with what highint5 produced.
+//
+class PPSModelCheck
+{
+public:
+    PPSModelCheck(PPS& gpspps, PPS& rtcpps);
+    void     process();
+    uint32_t getChecked();
+    uint32_t getMismatches();
+
+private:
+    PPSModel      _model;
+    PPS&          _gpspps;
+    PPS&          _rtcpps;
+    PPSEdgeReader _edges;
+    pps_data_t    _gps_data;
+    pps_data_t    _rtc_data;
+    bool          _gps_synced = false;
+    bool          _rtc_synced = false;
+    uint32_t      _checked    = 0;
+    uint32_t      _mismatches = 0;
+
+    void check(const char* name, PPS& pps, pps_data_t* data, bool* synced, const pps_edge_t& edge);
+};
+
+#endif // _PPS_MODEL_CHECK_H
@@ -0,0 +1,341 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PPSOutput.h"
+//#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#include "esp_log.h"
+#include "soc/gpio_struct.h"
+#include <stdlib.h>
+
+static const char* TAG = "PPSOutput";
+
+#ifndef PPS_OUTPUT_TASK_PRI
+#define PPS_OUTPUT_TASK_PRI 10
+#endif
+
+#ifndef PPS_OUTPUT_TASK_CORE
+#define PPS_OUTPUT_TASK_CORE 1
+#endif
+
+#if defined(CONFIG_GPSNTP_PPS_OUT_LATENCY)
+#define PPS_OUTPUT_LATENCY CONFIG_GPSNTP_PPS_OUT_LATENCY
+#else
+#define PPS_OUTPUT_LATENCY 2000
+#endif
+
+// an alarm has to be at least this far in the future to be sure it fires
+#define MIN_LEAD          (10*MicroSecondTimer::TICKS_PER_USEC)
+// give up and restart from the task after this many missed edges in a row
+#define MAX_MISSED        4
+// pulses are 100ms wide or half the period if that is shorter
+#define MAX_WIDTH_US      100000
+// loopback errors bigger than this are not latency (missed or extra edges)
+#define LOOPBACK_MAX      (1000*MicroSecondTimer::TICKS_PER_USEC)
+// fraction of the loopback error applied to the latency each second
+#define LATENCY_GAIN      (1.0/8.0)
+
+PPSOutput::PPSOutput(MicroSecondTimer& timer, PPS& pps, PPS* loopback)
+: _timer(timer),
+  _pps(pps),
+  _loopback(loopback)
+{
+}
+
+bool PPSOutput::begin(gpio_num_t pin, uint32_t period_ms)
+{
+    _pin     = pin;
+    _latency = (int32_t)(PPS_OUTPUT_LATENCY * MicroSecondTimer::TICKS_PER_USEC / 1000);
+    _latency_adjust = _latency;
+    setPeriod(period_ms);
+
+    ESP_LOGI(TAG, "::begin output on pin %d period %ums latency %d ticks", _pin, _period_ms, _latency);
+    gpio_set_direction(_pin, GPIO_MODE_OUTPUT);
+    gpio_set_level(_pin, 0);
+
+    esp_err_t err = timer_isr_register(MICRO_SECOND_TIMER_GROUP_NUM, MICRO_SECOND_TIMER_NUM, isr, this,
+                                       ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3, nullptr);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::begin timer_isr_register failed: %d (%s)", err, esp_err_to_name(err));
+        return false;
+    }
+    timer_enable_intr(MICRO_SECOND_TIMER_GROUP_NUM, MICRO_SECOND_TIMER_NUM);
+
+    ESP_LOGI(TAG, "::begin create PPSOut task at priority %d core %d", PPS_OUTPUT_TASK_PRI, PPS_OUTPUT_TASK_CORE);
+    xTaskCreatePinnedToCore(task, "PPSOut", 3*1024, this, PPS_OUTPUT_TASK_PRI, &_task, PPS_OUTPUT_TASK_CORE);
+    return true;
+}
+
+/**
+ * set the pulse period in milliseconds, it should divide a second or be a
+ * whole number of seconds for the pulses to line up with the second.
+*/
+void PPSOutput::setPeriod(uint32_t period_ms)
+{
+    if (period_ms == 0)
+    {
+        period_ms = PERIOD_PPS;
+    }
+    uint32_t width_us = period_ms * 500;
+    if (width_us > MAX_WIDTH_US)
+    {
+        width_us = MAX_WIDTH_US;
+    }
+
+    portENTER_CRITICAL(&_mux);
+    _period_ms = period_ms;
+    _width     = width_us * MicroSecondTimer::TICKS_PER_USEC;
+    _running   = false; // the task restarts on the new period
+    portEXIT_CRITICAL(&_mux);
+}
+
+uint32_t PPSOutput::getPeriod()
+{
+    return _period_ms;
+}
+
+/**
+ * get the output latency in nanoseconds that edges are scheduled early by
+*/
+int32_t PPSOutput::getLatency()
+{
+    return MicroSecondTimer::ticksToNanos(_latency);
+}
+
+/**
+ * get the last phase error measured on the loopback in nanoseconds
+*/
+int32_t PPSOutput::getPhaseError()
+{
+    return MicroSecondTimer::ticksToNanos(_phase_error);
+}
+
+/**
+ * get the number of pulses generated
+*/
+uint32_t PPSOutput::getPulses()
+{
+    return _pulses;
+}
+
+/**
+ * get the number of pulses skipped because they could not be scheduled in time
+*/
+uint32_t PPSOutput::getMissed()
+{
+    return _missed;
+}
+
+void IRAM_ATTR PPSOutput::setLevel(bool high)
+{
+    uint32_t pin = _pin;
+    if (pin < 32)
+    {
+        if (high)
+        {
+            GPIO.out_w1ts = 1 << pin;
+        }
+        else
+        {
+            GPIO.out_w1tc = 1 << pin;
+        }
+    }
+    else
+    {
+        if (high)
+        {
+            GPIO.out1_w1ts.data = 1 << (pin - 32);
+        }
+        else
+        {
+            GPIO.out1_w1tc.data = 1 << (pin - 32);
+        }
+    }
+}
+
+void IRAM_ATTR PPSOutput::setAlarm(uint64_t alarm)
+{
+    timer_group_set_alarm_value_in_isr(MICRO_SECOND_TIMER_GROUP_NUM, MICRO_SECOND_TIMER_NUM, alarm);
+    timer_group_enable_alarm_in_isr(MICRO_SECOND_TIMER_GROUP_NUM, MICRO_SECOND_TIMER_NUM);
+}
+
+/**
+ * advance to the next edge and set the alarm for it, call with _mux held.
+*/
+void IRAM_ATTR PPSOutput::scheduleNext()
+{
+    uint64_t now    = _timer.getValue64();
+    // the anchor is less than a timer wrap (32 bits) old so this gives its 64 bit value
+    uint64_t anchor = now - (uint32_t)((uint32_t)now - _anchor_last);
+    int64_t  max_lead = (int64_t)(_period_ms + 2000) * (_ticks_per_ms_q16 >> 16);
+
+    for (int missed = 0; missed < MAX_MISSED; ++missed)
+    {
+        _next_ms += _period_ms;
+        int64_t delta_ms = _next_ms - (uint64_t)_anchor_time * 1000;
+        int64_t edge     = anchor + ((delta_ms * _ticks_per_ms_q16) >> 16);
+        int64_t lead     = edge - _latency - (int64_t)now;
+        if (lead > max_lead)
+        {
+            // the second moved backwards, let the task start over
+            break;
+        }
+        if (lead >= (int64_t)MIN_LEAD)
+        {
+            _alarm = now + lead;
+            setAlarm(_alarm);
+            return;
+        }
+        _missed += 1;
+    }
+    _running = false;
+}
+
+void IRAM_ATTR PPSOutput::isr(void* data)
+{
+    PPSOutput* out = static_cast<PPSOutput*>(data);
+    timer_group_clr_intr_status_in_isr(MICRO_SECOND_TIMER_GROUP_NUM, MICRO_SECOND_TIMER_NUM);
+
+    portENTER_CRITICAL_ISR(&out->_mux);
+    if (!out->_high)
+    {
+        out->setLevel(true);
+        out->_high    = true;
+        out->_pulses += 1;
+        out->setAlarm(out->_alarm + out->_width);
+    }
+    else
+    {
+        out->setLevel(false);
+        out->_high = false;
+        if (out->_running)
+        {
+            out->scheduleNext();
+        }
+    }
+    portEXIT_CRITICAL_ISR(&out->_mux);
+}
+
+void PPSOutput::task(void* data)
+{
+    PPSOutput* out = static_cast<PPSOutput*>(data);
+    ESP_LOGI(TAG, "::task - starting!");
+    while (true)
+    {
+        out->process();
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+/**
+ * move the anchor to the latest second of the PPS, (re)start the output if it is
+ * stopped and correct the latency from the loopback.
+*/
+void PPSOutput::process()
+{
+    pps_snapshot_t snap;
+    _pps.snapshot(&snap);
+    if (snap.time == 0 || (uint32_t)snap.time == _anchor_time)
+    {
+        return;
+    }
+
+    int64_t ticks_per_ms_q16 = (int64_t)(_pps.getSecondTicks() * 65536.0 / 1000.0 + 0.5);
+
+    portENTER_CRITICAL(&_mux);
+    _anchor_time      = snap.time;
+    _anchor_last      = snap.last;
+    _ticks_per_ms_q16 = ticks_per_ms_q16;
+    bool running      = _running;
+    portEXIT_CRITICAL(&_mux);
+
+    if (!running)
+    {
+        start();
+    }
+
+    measureLatency();
+}
+
+/**
+ * find the first edge at least one period out and start the output
+*/
+void PPSOutput::start()
+{
+    portENTER_CRITICAL(&_mux);
+    uint32_t elapsed = _timer.getValue() - _anchor_last;
+    uint64_t now_ms  = (uint64_t)_anchor_time * 1000 + (((int64_t)elapsed << 16) / _ticks_per_ms_q16);
+    // scheduleNext() advances by one period to the first edge after now
+    _next_ms = (now_ms / _period_ms) * _period_ms;
+    _running = true;
+    if (_high)
+    {
+        // the falling edge alarm is pending and will schedule from there
+        portEXIT_CRITICAL(&_mux);
+        return;
+    }
+    scheduleNext();
+    bool running = _running;
+    portEXIT_CRITICAL(&_mux);
+
+    ESP_LOGI(TAG, "::start period %ums next edge at %llums %s", _period_ms, _next_ms, running ? "scheduled" : "missed");
+}
+
+/**
+ * the loopback offset from the source PPS is how late our edges are, fold
+ * part of it into the latency each second.
+*/
+void PPSOutput::measureLatency()
+{
+    if (_loopback == nullptr || _period_ms != PERIOD_PPS)
+    {
+        return;
+    }
+
+    pps_snapshot_t snap;
+    _loopback->snapshot(&snap);
+    // the ISR does not compute the offset for the first few seconds
+    if (snap.time == _loopback_time || snap.offset == 0)
+    {
+        return;
+    }
+    _loopback_time = snap.time;
+    _phase_error   = snap.offset;
+
+    if (abs(snap.offset) > (int32_t)LOOPBACK_MAX)
+    {
+        ESP_LOGW(TAG, "::measureLatency ignoring loopback offset %d ticks", snap.offset);
+        return;
+    }
+
+    _latency_adjust += snap.offset * LATENCY_GAIN;
+    int32_t latency = (int32_t)(_latency_adjust + (_latency_adjust < 0 ? -0.5 : 0.5));
+
+    portENTER_CRITICAL(&_mux);
+    _latency = latency;
+    portEXIT_CRITICAL(&_mux);
+
+    ESP_LOGD(TAG, "::measureLatency offset=%d latency=%d ticks", snap.offset, latency);
+}
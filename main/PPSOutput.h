@@ -0,0 +1,97 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PPS_OUTPUT_H
+#define _PPS_OUTPUT_H
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/timer.h"
+#include "MicroSecondTimer.h"
+#include "PPS.h"
+
+//
+// Generate timing pulses on a GPIO phase aligned to the second of a PPS.  Edges
+// are scheduled with the alarm of the PPS timebase timer (TIMG0 T0) and moved
+// earlier by the output latency.  If a loopback PPS is given (the output wired
+// back to a capture pin, referenced to the source PPS) the latency is measured
+// and corrected continuously, only possible at 1 pulse per second.
+//
+class PPSOutput
+{
+public:
+    static const uint32_t PERIOD_PPS  = 1000;   // periods in milliseconds
+    static const uint32_t PERIOD_10HZ = 100;
+    static const uint32_t PERIOD_1KHZ = 1;
+    static const uint32_t PERIOD_PP2S = 2000;
+    static const uint32_t PERIOD_PPM  = 60000;
+
+    PPSOutput(MicroSecondTimer& timer, PPS& pps, PPS* loopback = nullptr);
+    bool     begin(gpio_num_t pin, uint32_t period_ms = PERIOD_PPS);
+    void     setPeriod(uint32_t period_ms);
+    uint32_t getPeriod();
+    int32_t  getLatency();
+    int32_t  getPhaseError();
+    uint32_t getPulses();
+    uint32_t getMissed();
+
+private:
+    MicroSecondTimer& _timer;
+    PPS&              _pps;
+    PPS*              _loopback;
+    gpio_num_t        _pin              = GPIO_NUM_NC;
+    TaskHandle_t      _task             = nullptr;
+    portMUX_TYPE      _mux              = portMUX_INITIALIZER_UNLOCKED;
+
+    // shared with the ISR, protected by _mux
+    uint32_t          _period_ms        = PERIOD_PPS;
+    uint32_t          _anchor_last      = 0;    // timer value at the start of _anchor_time
+    uint32_t          _anchor_time      = 0;
+    int64_t           _ticks_per_ms_q16 = 0;    // 48.16 fixed point
+    int32_t           _latency          = 0;    // ticks
+    uint32_t          _width            = 0;    // ticks
+    uint64_t          _next_ms          = 0;    // time of the next edge in ms since the epoch
+    uint64_t          _alarm            = 0;    // alarm value of the next rising edge
+    bool              _running          = false;
+    bool              _high             = false;
+    volatile uint32_t _pulses           = 0;
+    volatile uint32_t _missed           = 0;
+
+    // only used by the task
+    float             _latency_adjust   = 0.0;
+    uint32_t          _loopback_time    = 0;
+    volatile int32_t  _phase_error      = 0;    // ticks
+
+    void process();
+    void start();
+    void measureLatency();
+    void scheduleNext();
+    void setAlarm(uint64_t alarm);
+    void setLevel(bool high);
+    static void isr(void* data);
+    static void task(void* data);
+};
+
+#endif // _PPS_OUTPUT_H
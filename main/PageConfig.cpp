@@ -23,6 +23,7 @@
 */
 
 #include "PageConfig.h"
+#include "SyncManager.h"
 #include "Display.h"
 #include "WithDisplayLock.h"
 #include "LVContainer.h"
@@ -115,6 +116,24 @@ PageConfig::PageConfig(Config& config, const ApplyCB& apply_cb)
     _target->setText(buf);
     _target->setKeyboardMode(LV_KEYBOARD_MODE_NUM);
 
+    _engine = new FieldText(fcont, "Engine:", 32,
+            [this](){
+                SyncManager::Engine engine;
+                if (SyncManager::parseEngine(_engine->getText(), &engine))
+                {
+                    _config.setEngine(engine);
+                }
+                else
+                {
+                    ESP_LOGE(TAG, "_engine CB: unknown engine '%s' (pid or kalman)", _engine->getText());
+                }
+                _engine->setText(SyncManager::getEngineName((SyncManager::Engine)_config.getEngine()));
+            },
+            [this](){
+                _engine->setText(SyncManager::getEngineName((SyncManager::Engine)_config.getEngine()));
+            });
+    _engine->setText(SyncManager::getEngineName((SyncManager::Engine)_config.getEngine()));
+
     LVContainer* ctrls = new LVContainer(cont);
     ctrls->setFit(LV_FIT_TIGHT);
     ctrls->setLayout(LV_LAYOUT_ROW_MID);
@@ -138,6 +157,7 @@ PageConfig::PageConfig(Config& config, const ApplyCB& apply_cb)
             _bias->setText(buf);
             snprintf(buf, sizeof(buf)-1, "%0f", _config.getTarget());
             _target->setText(buf);
+            _engine->setText(SyncManager::getEngineName((SyncManager::Engine)_config.getEngine()));
         }
     });
 
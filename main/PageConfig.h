@@ -57,6 +57,7 @@ private:
     FieldText*      _password;
     FieldText*      _bias;
     FieldText*      _target;
+    FieldText*      _engine;
     LVButton*       _apply;
     LVButton*       _save;
     LVButton*       _load;
@@ -0,0 +1,184 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PageISR.h"
+#include "Display.h"
+#include "WithDisplayLock.h"
+#include "LVContainer.h"
+#include "LVLabel.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char* TAG = "PageISR";
+
+#define CPU_MHZ CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+
+enum Row
+{
+    GPS_COUNT = 0,
+    GPS_CAPTURE,
+    GPS_TOTAL,
+    GPS_CAPTURE_HIST,
+    GPS_TOTAL_HIST,
+    RTC_COUNT,
+    RTC_CAPTURE,
+    RTC_TOTAL,
+    RTC_CAPTURE_HIST,
+    RTC_TOTAL_HIST,
+    _NUM_ROWS
+};
+
+// offsets from the channels COUNT row
+#define ROW_COUNT        0
+#define ROW_CAPTURE      1
+#define ROW_TOTAL        2
+#define ROW_CAPTURE_HIST 3
+#define ROW_TOTAL_HIST   4
+
+static const char* labels[_NUM_ROWS] = {
+    "GPS:", "Capture:", "Total:", "Cap Hist:", "Tot Hist:",
+    "RTC:", "Capture:", "Total:", "Cap Hist:", "Tot Hist:"
+};
+
+PageISR::PageISR(PPS& gps_pps, PPS& rtc_pps)
+: _gps_pps(gps_pps),
+  _rtc_pps(rtc_pps)
+{
+    WithDisplayLock([this](){
+        _container_style.setPadInner(LV_STATE_DEFAULT, LV_DPX(2));
+        _container_style.setPad(LV_STATE_DEFAULT, LV_DPX(1), LV_DPX(1), LV_DPX(1), LV_DPX(1));
+        _container_style.setMargin(LV_STATE_DEFAULT, 0, 0, 0, 0);
+        _container_style.setBorderWidth(LV_STATE_DEFAULT, 0);
+        _container_style.setShadowWidth(LV_STATE_DEFAULT, 0);
+
+        _page = Display::getDisplay().newPage("ISR");
+        _page->addStyle(LV_PAGE_PART_SCROLLABLE, &_container_style);
+
+        LVContainer* cont = new LVContainer(_page);
+        cont->setFit(LV_FIT_PARENT/*, LV_FIT_TIGHT*/);
+        cont->addStyle(LV_CONT_PART_MAIN, &_container_style);
+        cont->setLayout(LV_LAYOUT_COLUMN_LEFT);
+        cont->align(nullptr, LV_ALIGN_CENTER, 0, 0);
+        cont->setDragParent(true);
+
+        _table = new LVTable(cont);
+        _table->addStyle(LV_TABLE_PART_BG, &_container_style);
+        _table->addStyle(LV_TABLE_PART_CELL1, &_container_style);
+        _table->setColumnCount(2);
+        _table->setColumnWidth(0, 80);
+        _table->setColumnWidth(1, 160);
+        _table->setRowCount(Row::_NUM_ROWS);
+
+        for (int row = 0; row < Row::_NUM_ROWS; ++row)
+        {
+            _table->setCellAlign(row, 0, LV_LABEL_ALIGN_RIGHT);
+            _table->setCellValue(row, 0, labels[row]);
+            _table->setCellAlign(row, 1, LV_LABEL_ALIGN_LEFT);
+        }
+
+        _reset = new LVButton(cont);
+        _reset->setFit(LV_FIT_TIGHT, LV_FIT_TIGHT);
+        _reset->setEventCB([this](lv_event_t event){
+            if(event == LV_EVENT_CLICKED) {
+                ESP_LOGI(TAG, "_reset CB: resetting profiles");
+                _gps_pps.resetProfile();
+                _rtc_pps.resetProfile();
+            }
+        });
+        LVLabel* lbl = new LVLabel(_reset);
+        lbl->setText("RESET");
+
+        ESP_LOGI(TAG, "creating task");
+        lv_task_create(task, 1000, LV_TASK_PRIO_LOW, this);
+    });
+}
+
+PageISR::~PageISR()
+{
+}
+
+void PageISR::task(lv_task_t *task)
+{
+    PageISR* p = static_cast<PageISR*>(task->user_data);
+    p->update();
+}
+
+// format the non empty buckets as "bits:count ..."
+static void fmtHist(char* result, const size_t size, const volatile uint32_t* hist)
+{
+    size_t len = 0;
+    result[0] = '\0';
+    for (int bucket = 0; bucket < PPS_PROFILE_BUCKETS && len < size; ++bucket)
+    {
+        if (hist[bucket] != 0)
+        {
+            len += snprintf(result+len, size-len, "%d:%u ", bucket, hist[bucket]);
+        }
+    }
+}
+
+static void fmtMinMax(char* result, const size_t size, uint32_t min, uint32_t max)
+{
+    snprintf(result, size, "%u/%u (%u/%uns)", min, max, min*1000/CPU_MHZ, max*1000/CPU_MHZ);
+}
+
+void PageISR::updateChannel(int row, PPS& pps)
+{
+    static char buf[128];
+    pps_profile_t profile;
+    if (!pps.getProfile(&profile))
+    {
+        _table->setCellValue(row+ROW_COUNT, 1, "not enabled");
+        return;
+    }
+
+    snprintf(buf, sizeof(buf)-1, "%u edges", profile.count);
+    _table->setCellValue(row+ROW_COUNT, 1, buf);
+
+    if (profile.count == 0)
+    {
+        return;
+    }
+
+    fmtMinMax(buf, sizeof(buf)-1, profile.capture_min, profile.capture_max);
+    _table->setCellValue(row+ROW_CAPTURE, 1, buf);
+
+    fmtMinMax(buf, sizeof(buf)-1, profile.total_min, profile.total_max);
+    _table->setCellValue(row+ROW_TOTAL, 1, buf);
+
+    fmtHist(buf, sizeof(buf)-1, profile.capture_hist);
+    _table->setCellValue(row+ROW_CAPTURE_HIST, 1, buf);
+
+    fmtHist(buf, sizeof(buf)-1, profile.total_hist);
+    _table->setCellValue(row+ROW_TOTAL_HIST, 1, buf);
+}
+
+void PageISR::update()
+{
+    updateChannel(Row::GPS_COUNT, _gps_pps);
+    updateChannel(Row::RTC_COUNT, _rtc_pps);
+}
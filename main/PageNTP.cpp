@@ -40,10 +40,12 @@ enum Row
     UPTIME,
     VALIDTIME,
     VALIDCOUNT,
+    STRATUM,
+    SOURCE,
     _NUM_ROWS
 };
 
-static const char* labels[_NUM_ROWS] = {"Req:", "Resp:", "Uptime:", "Valid:", "ValidCount:"};
+static const char* labels[_NUM_ROWS] = {"Req:", "Resp:", "Uptime:", "Valid:", "ValidCount:", "Stratum:", "Source:"};
 
 PageNTP::PageNTP(NTP& ntp, SyncManager& syncman)
 : _ntp(ntp),
@@ -150,4 +152,11 @@ void PageNTP::update()
 
     snprintf(buf, sizeof(buf)-1, "%u", _syncman.getValidCount());
     _table->setCellValue(Row::VALIDCOUNT, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%u bound %0.1fus", _syncman.getStratum(), _syncman.getErrorBound());
+    _table->setCellValue(Row::STRATUM, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%s %u/%u false", SourceSelector::getTypeName(_syncman.getReference()),
+             _syncman.getFalsetickers(), _syncman.getSourceCount());
+    _table->setCellValue(Row::SOURCE, 1, buf);
 }
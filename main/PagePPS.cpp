@@ -59,9 +59,12 @@ PagePPS::PagePPS(PPS& gps_pps, PPS& rtc_pps)
         _gps_interval  = new LVLabel(cont);
         _gps_minmax    = new LVLabel(cont);
         _gps_shortlong = new LVLabel(cont);
+        _gps_jitter    = new LVLabel(cont);
         _rtc_interval  = new LVLabel(cont);
         _rtc_minmax    = new LVLabel(cont);
         _rtc_shortlong = new LVLabel(cont);
+        _rtc_jitter    = new LVLabel(cont);
+        _rtc_width     = new LVLabel(cont);
         _rtc_offset    = new LVLabel(cont);
 
         ESP_LOGI(TAG, "creating task");
@@ -88,6 +91,12 @@ static void fmtTime(const char* label, char* result, const size_t size, const ti
     snprintf(result, size, "%s%s.%02u", label, buf, microseconds/10000);
 }
 
+// timer ticks to microseconds
+static double toMicros(int64_t ticks)
+{
+    return MicroSecondTimer::ticksToNanos(ticks) / 1000.0;
+}
+
 void PagePPS::update()
 {
     static char buf[128];
@@ -100,29 +109,39 @@ void PagePPS::update()
     fmtTime("RTC PPS: ", buf, sizeof(buf)-1, tv.tv_sec, tv.tv_usec);
     _rtc_time->setText(buf);
 
-    snprintf(buf, sizeof(buf)-1, "GPS Interval: %07u", _gps_pps.getTimerInterval());
+    pps_snapshot_t gps;
+    pps_snapshot_t rtc;
+    _gps_pps.snapshot(&gps);
+    _rtc_pps.snapshot(&rtc);
+
+    snprintf(buf, sizeof(buf)-1, "GPS Interval: %0.3f", toMicros(gps.interval));
     _gps_interval->setText(buf);
 
-    snprintf(buf, sizeof(buf)-1, "GPS Min/Max: %06u / %07u",
-            _gps_pps.getTimerMin(),_gps_pps.getTimerMax());
+    snprintf(buf, sizeof(buf)-1, "GPS Min/Max: %0.3f / %0.3f", toMicros(gps.min), toMicros(gps.max));
     _gps_minmax->setText(buf);
 
-    snprintf(buf, sizeof(buf)-1, "Short/Long: %u / %u",
-            _gps_pps.getTimerShort(), _gps_pps.getTimerLong());
+    snprintf(buf, sizeof(buf)-1, "Short/Long: %u / %u", gps.short_count, gps.long_count);
     _gps_shortlong->setText(buf);
 
-    snprintf(buf, sizeof(buf)-1, "RTC Interval: %07u", _rtc_pps.getTimerInterval());
+    snprintf(buf, sizeof(buf)-1, "GPS Jitter: %0.3f", _gps_pps.getJitter() / MicroSecondTimer::TICKS_PER_USEC);
+    _gps_jitter->setText(buf);
+
+    snprintf(buf, sizeof(buf)-1, "RTC Interval: %0.3f", toMicros(rtc.interval));
     _rtc_interval->setText(buf);
 
-    snprintf(buf, sizeof(buf)-1, "RTC Min/Max: %06u / %07u",
-            _rtc_pps.getTimerMin(),_rtc_pps.getTimerMax());
+    snprintf(buf, sizeof(buf)-1, "RTC Min/Max: %0.3f / %0.3f", toMicros(rtc.min), toMicros(rtc.max));
     _rtc_minmax->setText(buf);
 
-    snprintf(buf, sizeof(buf)-1, "Short/Long: %u / %u",
-            _rtc_pps.getTimerShort(), _rtc_pps.getTimerLong());
+    snprintf(buf, sizeof(buf)-1, "Short/Long: %u / %u", rtc.short_count, rtc.long_count);
     _rtc_shortlong->setText(buf);
 
-    snprintf(buf, sizeof(buf)-1, "RTC Offset: %d", _rtc_pps.getOffset());
+    snprintf(buf, sizeof(buf)-1, "RTC Jitter: %0.3f", _rtc_pps.getJitter() / MicroSecondTimer::TICKS_PER_USEC);
+    _rtc_jitter->setText(buf);
+
+    snprintf(buf, sizeof(buf)-1, "RTC Width: %0.3f", toMicros(rtc.width));
+    _rtc_width->setText(buf);
+
+    snprintf(buf, sizeof(buf)-1, "RTC Offset: %0.3f", toMicros(rtc.offset));
     _rtc_offset->setText(buf);
 
 }
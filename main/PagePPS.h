@@ -51,8 +51,11 @@ private:
     LVLabel* _rtc_interval;
     LVLabel* _gps_minmax;
     LVLabel* _gps_shortlong;
+    LVLabel* _gps_jitter;
     LVLabel* _rtc_minmax;
     LVLabel* _rtc_shortlong;
+    LVLabel* _rtc_jitter;
+    LVLabel* _rtc_width;
     LVLabel* _rtc_offset;
     LVStyle  _container_style;
 };
@@ -0,0 +1,158 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PageReceivers.h"
+#include "Display.h"
+#include "WithDisplayLock.h"
+#include "LVContainer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char* TAG = "PageReceivers";
+
+enum Row
+{
+    ACTIVE = 0,
+    DIFFERENCE,
+    GPS1_STATE,
+    GPS1_VALID,
+    GPS1_MISSED,
+    GPS1_OUTVOTED,
+    GPS1_PHASE,
+    GPS2_STATE,
+    GPS2_VALID,
+    GPS2_MISSED,
+    GPS2_OUTVOTED,
+    GPS2_PHASE,
+    _NUM_ROWS
+};
+
+// offsets from the receivers STATE row
+#define ROW_STATE    0
+#define ROW_VALID    1
+#define ROW_MISSED   2
+#define ROW_OUTVOTED 3
+#define ROW_PHASE    4
+
+static const char* labels[_NUM_ROWS] = {
+    "Active:", "Diff:",
+    "GPS 1:", "Valid:", "Missed:", "Outvoted:", "Phase:",
+    "GPS 2:", "Valid:", "Missed:", "Outvoted:", "Phase:"
+};
+
+PageReceivers::PageReceivers(SyncManager& syncman)
+: _syncman(syncman)
+{
+    WithDisplayLock([this](){
+        _container_style.setPadInner(LV_STATE_DEFAULT, LV_DPX(2));
+        _container_style.setPad(LV_STATE_DEFAULT, LV_DPX(1), LV_DPX(1), LV_DPX(1), LV_DPX(1));
+        _container_style.setMargin(LV_STATE_DEFAULT, 0, 0, 0, 0);
+        _container_style.setBorderWidth(LV_STATE_DEFAULT, 0);
+        _container_style.setShadowWidth(LV_STATE_DEFAULT, 0);
+
+        _page = Display::getDisplay().newPage("GNSS");
+        _page->addStyle(LV_PAGE_PART_SCROLLABLE, &_container_style);
+
+        LVContainer* cont = new LVContainer(_page);
+        cont->setFit(LV_FIT_PARENT/*, LV_FIT_TIGHT*/);
+        cont->addStyle(LV_CONT_PART_MAIN, &_container_style);
+        cont->setLayout(LV_LAYOUT_COLUMN_LEFT);
+        cont->align(nullptr, LV_ALIGN_CENTER, 0, 0);
+        cont->setDragParent(true);
+
+        _table = new LVTable(cont);
+        _table->addStyle(LV_TABLE_PART_BG, &_container_style);
+        _table->addStyle(LV_TABLE_PART_CELL1, &_container_style);
+        _table->setColumnCount(2);
+        _table->setColumnWidth(0, 85);
+        _table->setColumnWidth(1, 160);
+        _table->setRowCount(Row::_NUM_ROWS);
+
+        for (int row = 0; row < Row::_NUM_ROWS; ++row)
+        {
+            _table->setCellAlign(row, 0, LV_LABEL_ALIGN_RIGHT);
+            _table->setCellValue(row, 0, labels[row]);
+            _table->setCellAlign(row, 1, LV_LABEL_ALIGN_LEFT);
+        }
+
+        ESP_LOGI(TAG, "creating task");
+        lv_task_create(task, 1000, LV_TASK_PRIO_LOW, this);
+    });
+}
+
+PageReceivers::~PageReceivers()
+{
+}
+
+void PageReceivers::task(lv_task_t *task)
+{
+    PageReceivers* p = static_cast<PageReceivers*>(task->user_data);
+    p->update();
+}
+
+void PageReceivers::updateReceiver(int row, uint32_t index)
+{
+    static char buf[128];
+    const ReceiverSelector& selector = _syncman.getReceiverSelector();
+    if (index >= selector.getCount())
+    {
+        _table->setCellValue(row+ROW_STATE, 1, "not present");
+        return;
+    }
+    const ReceiverSelector::Health& health = selector.getHealth(index);
+
+    snprintf(buf, sizeof(buf)-1, "%s %s", index == selector.getActive() ? "active" : "standby",
+             _syncman.getReceiverValidator(index).getReason());
+    _table->setCellValue(row+ROW_STATE, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%u/%us", health.valid_seconds, health.seconds);
+    _table->setCellValue(row+ROW_VALID, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%u pps", health.pps_missing);
+    _table->setCellValue(row+ROW_MISSED, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%u time %u phase", health.time_mismatch, health.phase_outliers);
+    _table->setCellValue(row+ROW_OUTVOTED, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%+0.1fus max diff %0.1fus", health.phase, health.max_difference);
+    _table->setCellValue(row+ROW_PHASE, 1, buf);
+}
+
+void PageReceivers::update()
+{
+    static char buf[128];
+    const ReceiverSelector& selector = _syncman.getReceiverSelector();
+
+    snprintf(buf, sizeof(buf)-1, "GPS %u %s (%u switches)", selector.getActive()+1, selector.getReason(), selector.getSwitches());
+    _table->setCellValue(Row::ACTIVE, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%+0.1fus %s", selector.getDifference(), selector.isConsistent() ? "agree" : "disagree");
+    _table->setCellValue(Row::DIFFERENCE, 1, buf);
+
+    updateReceiver(Row::GPS1_STATE, 0);
+    updateReceiver(Row::GPS2_STATE, 1);
+}
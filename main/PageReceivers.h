@@ -0,0 +1,52 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PAGE_RECEIVERS_H_
+#define _PAGE_RECEIVERS_H_
+
+#include "SyncManager.h"
+#include "LVPage.h"
+#include "LVTable.h"
+#include "LVStyle.h"
+
+class PageReceivers {
+public:
+    PageReceivers(SyncManager& syncman);
+    ~PageReceivers();
+
+    PageReceivers(PageReceivers&) = delete;
+    PageReceivers& operator=(PageReceivers&) = delete;
+
+private:
+    void update();
+    void updateReceiver(int row, uint32_t index);
+    static void task(lv_task_t* task);
+    SyncManager& _syncman;
+    LVPage*      _page;
+    LVTable*     _table;
+    LVStyle      _container_style;
+};
+
+#endif // _PAGE_RECEIVERS_H_
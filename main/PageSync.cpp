@@ -43,10 +43,17 @@ enum Row
     ERROR,
     INTEGRAL,
     OUTPUT,
+    ENGINE,
+    TEMP,
+    RTC_MISMATCH,
+    TUNE,
+    AGING,
+    HOLDOVER,
+    VALID,
     _NUM_ROWS
 };
 
-static const char* labels[_NUM_ROWS] = {"RTC:", "GPS:", "RTC PPS:", "GPS PPS:", "Offset:", "Error:", "Integral:", "Output:"};
+static const char* labels[_NUM_ROWS] = {"RTC:", "GPS:", "RTC PPS:", "GPS PPS:", "Offset:", "Error:", "Integral:", "Output:", "Engine:", "Temp:", "RTC Err:", "Tune:", "Aging:", "Holdover:", "Valid:"};
 
 PageSync::PageSync(SyncManager& syncman)
 : _syncman(syncman)
@@ -83,6 +90,28 @@ PageSync::PageSync(SyncManager& syncman)
             _table->setCellAlign(row, 1, LV_LABEL_ALIGN_LEFT);
         }
 
+        _tune = new LVButton(cont);
+        _tune->setFit(LV_FIT_TIGHT, LV_FIT_TIGHT);
+        _tune->setEventCB([this](lv_event_t event){
+            if(event == LV_EVENT_CLICKED) {
+                ESP_LOGI(TAG, "_tune CB: starting PID tuning");
+                _syncman.startTune();
+            }
+        });
+        LVLabel* lbl = new LVLabel(_tune);
+        lbl->setText("TUNE");
+
+        _sweep = new LVButton(cont);
+        _sweep->setFit(LV_FIT_TIGHT, LV_FIT_TIGHT);
+        _sweep->setEventCB([this](lv_event_t event){
+            if(event == LV_EVENT_CLICKED) {
+                ESP_LOGI(TAG, "_sweep CB: starting aging characterisation");
+                _syncman.startSweep();
+            }
+        });
+        lbl = new LVLabel(_sweep);
+        lbl->setText("SWEEP");
+
         ESP_LOGI(TAG, "creating task");
         lv_task_create(task, 100, LV_TASK_PRIO_LOW, this);
     });
@@ -145,4 +174,68 @@ void PageSync::update()
 
     snprintf(buf, sizeof(buf)-1, "%d", _syncman.getOutput());
     _table->setCellValue(Row::OUTPUT, 1, buf);
+
+    if (_syncman.getEngine() == SyncManager::ENGINE_KALMAN)
+    {
+        const ClockKalman& kalman = _syncman.getKalman();
+        snprintf(buf, sizeof(buf)-1, "%s %+0.3fppm", SyncManager::getEngineName(_syncman.getEngine()), kalman.getFrequency());
+    }
+    else
+    {
+        snprintf(buf, sizeof(buf)-1, "%s", SyncManager::getEngineName(_syncman.getEngine()));
+    }
+    _table->setCellValue(Row::ENGINE, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%0.2fC ff=%0.1f bins=%u", _syncman.getTemperature(),
+             _syncman.getFeedForward(), _syncman.getTempModel().getBins());
+    _table->setCellValue(Row::TEMP, 1, buf);
+
+    snprintf(buf, sizeof(buf)-1, "%u", _syncman.getRTCMismatchCount());
+    _table->setCellValue(Row::RTC_MISMATCH, 1, buf);
+
+    const PIDTuner& tuner = _syncman.getTuner();
+    if (tuner.isRunning())
+    {
+        snprintf(buf, sizeof(buf)-1, "%s %us", PIDTuner::getStateName(tuner.getState()), tuner.getElapsed(_syncman.getUptime()));
+    }
+    else
+    {
+        snprintf(buf, sizeof(buf)-1, "%s kp=%0.2f ki=%0.3f kd=%0.2f", PIDTuner::getStateName(tuner.getState()),
+                 _syncman.getKp(), _syncman.getKi(), _syncman.getKd());
+    }
+    _table->setCellValue(Row::TUNE, 1, buf);
+
+    const AgingSweep& sweep = _syncman.getSweep();
+    if (sweep.isRunning())
+    {
+        snprintf(buf, sizeof(buf)-1, "%s point %u", AgingSweep::getStateName(sweep.getState()), sweep.getPoint()+1);
+    }
+    else
+    {
+        snprintf(buf, sizeof(buf)-1, "%s %0.1fppb/LSB", AgingSweep::getStateName(sweep.getState()),
+                 _syncman.getPlantGain()*1000);
+    }
+    _table->setCellValue(Row::AGING, 1, buf);
+
+    const Holdover& holdover = _syncman.getHoldover();
+    if (holdover.isHolding())
+    {
+        snprintf(buf, sizeof(buf)-1, "%s %us %0.1fus", Holdover::getStateName(holdover.getState()),
+                 holdover.getElapsed(_syncman.getUptime()), holdover.getErrorBound());
+    }
+    else if (holdover.getCount() > 0)
+    {
+        snprintf(buf, sizeof(buf)-1, "%s last %us %0.1f/%0.1fus", Holdover::getStateName(holdover.getState()),
+                 holdover.getLastDuration(), holdover.getLastError(), holdover.getLastBound());
+    }
+    else
+    {
+        snprintf(buf, sizeof(buf)-1, "%s", Holdover::getStateName(holdover.getState()));
+    }
+    _table->setCellValue(Row::HOLDOVER, 1, buf);
+
+    const GPSValidator& validator = _syncman.getValidator();
+    snprintf(buf, sizeof(buf)-1, "%s %s (%u/%u)", validator.isValid() ? "yes" : "no", validator.getReason(),
+             validator.getConsistent(), validator.getRequired());
+    _table->setCellValue(Row::VALID, 1, buf);
 }
@@ -29,6 +29,7 @@
 #include "LVPage.h"
 #include "LVTable.h"
 #include "LVLabel.h"
+#include "LVButton.h"
 #include "LVStyle.h"
 
 class PageSync {
@@ -45,6 +46,8 @@ private:
     SyncManager& _syncman;
     LVPage*  _page;
     LVTable* _table;
+    LVButton* _tune;
+    LVButton* _sweep;
     LVStyle  _container_style;
 };
 
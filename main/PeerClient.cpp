@@ -0,0 +1,304 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "PeerClient.h"
+#include "Network.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include <lwip/netdb.h>
+
+static const char* TAG = "PeerClient";
+
+#ifndef PEER_TASK_PRI
+#define PEER_TASK_PRI 2
+#endif
+
+#ifndef PEER_TASK_CORE
+#define PEER_TASK_CORE 0
+#endif
+
+// ms to wait for a response
+#define PEER_TIMEOUT 2000
+
+// seconds between retries of a peer that does not resolve
+#define PEER_RESOLVE_RETRY 60
+
+// a sample with a round trip over this is not used, us
+#define PEER_MAX_DELAY 500000
+
+// difference of two NTP timestamps in us
+static double ntpDiff(const NTPTime& a, const NTPTime& b)
+{
+    return (int32_t)(a.seconds - b.seconds) * 1000000.0
+           + ((double)a.fraction - (double)b.fraction) * (1000000.0 / 4294967296.0);
+}
+
+// NTP short format (16.16 seconds) to us
+static float shortToUs(uint32_t value)
+{
+    return value * (1000000.0 / 65536.0);
+}
+
+PeerClient::PeerClient(PPS& pps)
+: _pps(pps),
+  _lock(xSemaphoreCreateMutex())
+{
+}
+
+/**
+ * start polling the comma separated list of hosts every poll seconds, returns
+ * false if there are none.
+*/
+bool PeerClient::begin(const char* hosts, uint32_t poll)
+{
+    _poll  = poll;
+    _count = 0;
+    const char* p = hosts;
+    while (p != nullptr && *p != '\0' && _count < MAX_PEERS)
+    {
+        while (*p == ' ' || *p == ',')
+        {
+            ++p;
+        }
+        size_t len = strcspn(p, ", ");
+        if (len == 0)
+        {
+            break;
+        }
+        if (len >= sizeof(_peers[0].host))
+        {
+            ESP_LOGE(TAG, "::begin: host name too long, ignoring: '%.*s'", len, p);
+        }
+        else
+        {
+            Peer& peer = _peers[_count++];
+            memset(&peer, 0, sizeof(peer));
+            memcpy(peer.host, p, len);
+            ESP_LOGI(TAG, "::begin: peer %u '%s'", _count-1, peer.host);
+        }
+        p += len;
+    }
+
+    if (_count == 0)
+    {
+        return false;
+    }
+    xTaskCreatePinnedToCore(&PeerClient::task, "PeerClient", 4096, this, PEER_TASK_PRI, nullptr, PEER_TASK_CORE);
+    return true;
+}
+
+uint32_t PeerClient::getCount()
+{
+    return _count;
+}
+
+/**
+ * copy of a peer, false if the index is out of range or the peer is busy
+*/
+bool PeerClient::getPeer(uint32_t index, Peer* peerp)
+{
+    if (index >= _count || xSemaphoreTake(_lock, pdMS_TO_TICKS(10)) != pdTRUE)
+    {
+        return false;
+    }
+    *peerp = _peers[index];
+    xSemaphoreGive(_lock);
+    return true;
+}
+
+void PeerClient::getNTPTime(NTPTime* time)
+{
+    struct timespec ts;
+    _pps.getTime(&ts);
+    time->seconds  = toNTP(ts.tv_sec);
+    time->fraction = ns2frac(ts.tv_nsec);
+}
+
+bool PeerClient::resolve(Peer& peer)
+{
+    struct addrinfo hints;
+    struct addrinfo* res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    int err = getaddrinfo(peer.host, nullptr, &hints, &res);
+    if (err != 0 || res == nullptr)
+    {
+        ESP_LOGW(TAG, "::resolve: '%s' failed: %d", peer.host, err);
+        return false;
+    }
+    uint32_t addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(res);
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    peer.addr = addr;
+    xSemaphoreGive(_lock);
+    return true;
+}
+
+/**
+ * one client exchange with the peer, samplep gets the stratum and the offset,
+ * delay and root distance values.
+*/
+bool PeerClient::query(Peer& peer, Peer* samplep)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0)
+    {
+        ESP_LOGE(TAG, "::query: unable to create socket: errno %d", errno);
+        return false;
+    }
+    struct timeval timeout;
+    timeout.tv_sec  = PEER_TIMEOUT / 1000;
+    timeout.tv_usec = (PEER_TIMEOUT % 1000) * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in dest_addr;
+    memset(&dest_addr, 0, sizeof(dest_addr));
+    dest_addr.sin_family      = AF_INET;
+    dest_addr.sin_port        = htons(NTP_PORT);
+    dest_addr.sin_addr.s_addr = peer.addr;
+
+    NTPPacket packet;
+    NTPTime   t1;
+    NTPTime   t4;
+    memset(&packet, 0, sizeof(packet));
+    packet.flags = setLI(LI_NOSYNC) | setVERS(NTP_VERSION) | setMODE(MODE_CLIENT);
+    getNTPTime(&t1);
+    packet.xmit_time.seconds  = htonl(t1.seconds);
+    packet.xmit_time.fraction = htonl(t1.fraction);
+
+    bool ok = false;
+    if (sendto(sock, &packet, sizeof(packet), 0, (struct sockaddr*)&dest_addr, sizeof(dest_addr)) < 0)
+    {
+        ESP_LOGW(TAG, "::query: '%s' send failed: errno %d", peer.host, errno);
+    }
+    else
+    {
+        int len = recvfrom(sock, &packet, sizeof(packet), 0, nullptr, nullptr);
+        getNTPTime(&t4);
+        if (len < 0)
+        {
+            ESP_LOGW(TAG, "::query: '%s' no response: errno %d", peer.host, errno);
+        }
+        else if (len < (int)sizeof(packet))
+        {
+            ESP_LOGW(TAG, "::query: '%s' short packet: %d", peer.host, len);
+        }
+        else
+        {
+            NTPTime orig = {ntohl(packet.orig_time.seconds), ntohl(packet.orig_time.fraction)};
+            NTPTime t2   = {ntohl(packet.recv_time.seconds), ntohl(packet.recv_time.fraction)};
+            NTPTime t3   = {ntohl(packet.xmit_time.seconds), ntohl(packet.xmit_time.fraction)};
+            double  delay = ntpDiff(t4, t1) - ntpDiff(t3, t2);
+            if (getMODE(packet.flags) != MODE_SERVER || getLI(packet.flags) == LI_NOSYNC
+                || packet.stratum == 0 || packet.stratum > 15
+                || orig.seconds != t1.seconds || orig.fraction != t1.fraction)
+            {
+                ESP_LOGW(TAG, "::query: '%s' bad response: mode=%u li=%u stratum=%u",
+                              peer.host, getMODE(packet.flags), getLI(packet.flags), packet.stratum);
+            }
+            else if (delay < 0 || delay > PEER_MAX_DELAY)
+            {
+                ESP_LOGW(TAG, "::query: '%s' delay out of range: %0.0fus", peer.host, delay);
+            }
+            else
+            {
+                samplep->stratum         = packet.stratum;
+                samplep->offset          = (ntpDiff(t2, t1) + ntpDiff(t3, t4)) / 2.0;
+                samplep->delay           = delay;
+                samplep->root_delay      = shortToUs(ntohl(packet.delay));
+                samplep->root_dispersion = shortToUs(ntohl(packet.dispersion));
+                ok = true;
+            }
+        }
+    }
+    shutdown(sock, 0);
+    close(sock);
+    return ok;
+}
+
+void PeerClient::poll(Peer& peer)
+{
+    if (peer.addr == 0 && !resolve(peer))
+    {
+        return;
+    }
+
+    Peer sample;
+    bool ok = query(peer, &sample);
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    peer.reach = (peer.reach << 1) | (ok ? 1 : 0);
+    if (ok)
+    {
+        peer.valid           = true;
+        peer.stratum         = sample.stratum;
+        peer.offset          = sample.offset;
+        peer.delay           = sample.delay;
+        peer.root_delay      = sample.root_delay;
+        peer.root_dispersion = sample.root_dispersion;
+        peer.time            = esp_timer_get_time() / 1000000;
+    }
+    else if (peer.reach == 0)
+    {
+        // nothing for 8 polls, resolve again
+        peer.valid = false;
+        peer.addr  = 0;
+    }
+    xSemaphoreGive(_lock);
+
+    if (ok)
+    {
+        ESP_LOGI(TAG, "::poll: '%s' stratum=%u offset=%0.1fus delay=%0.1fus root delay=%0.1fus dispersion=%0.1fus",
+                      peer.host, peer.stratum, peer.offset, peer.delay, peer.root_delay, peer.root_dispersion);
+    }
+}
+
+void PeerClient::task(void* data)
+{
+    PeerClient* client = static_cast<PeerClient*>(data);
+    ESP_LOGI(TAG, "::task started with priority %d core %d", uxTaskPriorityGet(nullptr), xPortGetCoreID());
+
+    while (true)
+    {
+        Network::getNetwork().waitFor(Network::HAS_IP);
+        uint32_t delay = client->_poll;
+        for (uint32_t i = 0; i < client->_count; ++i)
+        {
+            client->poll(client->_peers[i]);
+            if (client->_peers[i].addr == 0 && delay > PEER_RESOLVE_RETRY)
+            {
+                delay = PEER_RESOLVE_RETRY;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(delay * 1000));
+    }
+}
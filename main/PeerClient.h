@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _PEER_CLIENT_H
+#define _PEER_CLIENT_H
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "PPS.h"
+#include "NTPPacket.h"
+
+//
+// Polls optional upstream NTP servers as extra candidates for the source selection.
+// The local timestamps are taken from the RTC PPS, the clock we serve, so a peer
+// offset is the peer time minus ours.
+//
+class PeerClient
+{
+public:
+    struct Peer
+    {
+        char     host[64];
+        uint32_t addr;            // IPv4 address, network order, 0 until resolved
+        bool     valid;           // has a usable sample
+        uint8_t  stratum;
+        uint8_t  reach;           // shift register of the last 8 polls
+        float    offset;          // peer - local, us
+        float    delay;           // round trip, us
+        float    root_delay;      // us
+        float    root_dispersion; // us
+        uint32_t time;            // uptime of the sample
+    };
+
+    static const uint32_t MAX_PEERS = 4;
+
+    PeerClient(PPS& pps);
+    bool     begin(const char* hosts, uint32_t poll);
+    uint32_t getCount();
+    bool     getPeer(uint32_t index, Peer* peerp);
+
+private:
+    PPS&              _pps;
+    SemaphoreHandle_t _lock;
+    Peer              _peers[MAX_PEERS];
+    uint32_t          _count = 0;
+    uint32_t          _poll  = 64; // seconds between polls
+
+    void getNTPTime(NTPTime* time);
+    bool resolve(Peer& peer);
+    bool query(Peer& peer, Peer* samplep);
+    void poll(Peer& peer);
+    static void task(void* data);
+};
+
+#endif // _PEER_CLIENT_H
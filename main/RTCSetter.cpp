@@ -0,0 +1,255 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "RTCSetter.h"
+#include "esp_log.h"
+
+static const char* TAG = "RTCSetter";
+
+#ifndef RTC_SETTER_TASK_PRI
+#define RTC_SETTER_TASK_PRI configMAX_PRIORITIES
+#endif
+
+#ifndef RTC_SETTER_TASK_CORE
+#define RTC_SETTER_TASK_CORE 1
+#endif
+
+#define LATENCY_PIN 2
+
+// initial lead and the limits for the calibrated lead in us
+#define LEAD_INITIAL 200
+#define LEAD_MIN     0
+#define LEAD_MAX     1000
+
+// weight of the measured error when calibrating the lead
+#define LEAD_GAIN    0.5
+
+// the alarm is set this many us before the write has to start to cover the esp_timer
+// dispatch latency, the task waits out the rest
+#define ALARM_MARGIN 1000
+
+// a write that would start more than this many us late is abandoned
+#define LATE_MAX     50
+
+// weight of a new sample in the average write time
+#define WRITE_TIME_ALPHA (1.0/8.0)
+
+RTCSetter::RTCSetter(DS3231& rtc, PPS& gpspps, PPS& rtcpps)
+: _rtc(rtc),
+  _gpspps(&gpspps),
+  _rtcpps(rtcpps),
+  _lead(LEAD_INITIAL)
+{
+}
+
+bool RTCSetter::begin()
+{
+    esp_timer_create_args_t args = {
+        .callback        = alarm,
+        .arg             = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name            = "RTCSet",
+    };
+    esp_err_t err = esp_timer_create(&args, &_alarm);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::begin failed to create alarm: %d (%s)", err, esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "::begin create RTCSet task at priority %d core %d", RTC_SETTER_TASK_PRI, RTC_SETTER_TASK_CORE);
+    xTaskCreatePinnedToCore(task, "RTCSet", 3*1024, this, RTC_SETTER_TASK_PRI, &_task, RTC_SETTER_TASK_CORE);
+    return true;
+}
+
+/**
+ * schedule setting the RTC to the next GPS second, returns false if a set is
+ * already in progress or the alarm could not be armed.
+*/
+bool RTCSetter::schedule()
+{
+    if (_state == PENDING)
+    {
+        return false;
+    }
+
+    struct timeval tv;
+    _gpspps->getTime(&tv);
+    _target = tv.tv_sec + 1;
+
+    struct tm tm;
+    gmtime_r(&_target, &tm);
+    if (!_rtc.prepareTime(&tm))
+    {
+        return false;
+    }
+
+    int32_t delay = 1000000 - tv.tv_usec - (int32_t)_lead - ALARM_MARGIN;
+    if (delay < 0)
+    {
+        ESP_LOGW(TAG, "::schedule too close to the end of the second (%ldus)", tv.tv_usec);
+        return false;
+    }
+
+    _state = PENDING;
+    esp_err_t err = esp_timer_start_once(_alarm, delay);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::schedule failed to start alarm: %d (%s)", err, esp_err_to_name(err));
+        _state = IDLE;
+        return false;
+    }
+    ESP_LOGI(TAG, "::schedule set RTC to %ld in %dus lead %0.1fus", _target, delay, _lead);
+    return true;
+}
+
+RTCSetter::State RTCSetter::getState()
+{
+    return _state;
+}
+
+/**
+ * return the state and go back to idle if the set has finished
+*/
+RTCSetter::State RTCSetter::finish()
+{
+    State state = _state;
+    if (state == DONE || state == FAILED)
+    {
+        _state = IDLE;
+    }
+    return state;
+}
+
+/**
+ * set the GPS PPS the writes are timed from, not while a set is pending
+*/
+void RTCSetter::setReference(PPS& gpspps)
+{
+    _gpspps = &gpspps;
+}
+
+/**
+ * adjust the lead by the offset error (us, RTC edge late is positive) measured after a set
+*/
+void RTCSetter::calibrate(float error)
+{
+    float lead = _lead + error * LEAD_GAIN;
+    if (lead < LEAD_MIN)
+    {
+        lead = LEAD_MIN;
+    }
+    else if (lead > LEAD_MAX)
+    {
+        lead = LEAD_MAX;
+    }
+    ESP_LOGI(TAG, "::calibrate error %0.1fus lead %0.1fus -> %0.1fus (write %0.1fus)", error, _lead, lead, _write_time);
+    _lead = lead;
+}
+
+float RTCSetter::getLead()
+{
+    return _lead;
+}
+
+float RTCSetter::getWriteTime()
+{
+    return _write_time;
+}
+
+int32_t RTCSetter::getLate()
+{
+    return _late;
+}
+
+void RTCSetter::alarm(void* data)
+{
+    RTCSetter* setter = static_cast<RTCSetter*>(data);
+    xTaskNotifyGive(setter->_task);
+}
+
+/**
+ * wait for the start time and write the prepared time.  The wait is at most
+ * ALARM_MARGIN so lower priority tasks on this core (NTP) are only held off briefly.
+*/
+void RTCSetter::write()
+{
+    int32_t start = 1000000 - (int32_t)_lead;
+    struct timeval tv;
+    do {
+        _gpspps->getTime(&tv);
+    } while (tv.tv_sec < _target && tv.tv_usec < start);
+
+    _late = tv.tv_sec < _target ? tv.tv_usec - start : 1000000 - start + tv.tv_usec;
+    if (_late > LATE_MAX)
+    {
+        ESP_LOGW(TAG, "::write alarm too late by %dus, abandoned", _late);
+        _state = FAILED;
+        return;
+    }
+
+#ifdef SYNC_LATENCY_OUTPUT
+    gpio_set_level((gpio_num_t)LATENCY_PIN, 1);
+#endif
+
+    // disable time incrementing in the RTC PPS so we dont accidentally increment
+    // then set the RTC PPS counter time. It wil be re-enabled after the RTC has been set
+    _rtcpps.setDisable(true);
+    _rtcpps.setTime(_target);
+
+    int64_t begin = esp_timer_get_time();
+    bool    ok    = _rtc.commitTime();
+    int64_t end   = esp_timer_get_time();
+    _rtcpps.setDisable(false);
+
+#ifdef SYNC_LATENCY_OUTPUT
+    gpio_set_level((gpio_num_t)LATENCY_PIN, 0);
+#endif
+
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "::write failed to set time for DS3231");
+        _state = FAILED;
+        return;
+    }
+
+    float write_time = end - begin;
+    _write_time = _write_time == 0 ? write_time : _write_time + (write_time - _write_time) * WRITE_TIME_ALPHA;
+    ESP_LOGI(TAG, "::write set RTC to %ld late=%dus write=%0.0fus", _target, _late, write_time);
+    _state = DONE;
+}
+
+void RTCSetter::task(void* data)
+{
+    RTCSetter* setter = static_cast<RTCSetter*>(data);
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (setter->_state == PENDING)
+        {
+            setter->write();
+        }
+    }
+}
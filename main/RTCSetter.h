@@ -0,0 +1,80 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _RTC_SETTER_H
+#define _RTC_SETTER_H
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "DS3231.h"
+#include "PPS.h"
+
+//
+// Sets the DS3231 time at the start of a GPS second without busy waiting for it.
+// schedule() prepares the I2C transaction and arms an esp_timer alarm shortly
+// before the write has to start, the alarm wakes a dedicated task that waits out
+// the last fraction of a millisecond and runs the write.  The lead (how early the
+// write starts) is self-calibrated from the RTC offset measured after each set.
+//
+class RTCSetter
+{
+public:
+    enum State
+    {
+        IDLE = 0,
+        PENDING,   // alarm armed, the RTC must not be used until the set is finished
+        DONE,      // the RTC has been set
+        FAILED,    // the write failed or the alarm was too late, nothing was changed
+    };
+
+    RTCSetter(DS3231& rtc, PPS& gpspps, PPS& rtcpps);
+    bool     begin();
+    bool     schedule();
+    State    getState();
+    State    finish();
+    void     calibrate(float error);
+    void     setReference(PPS& gpspps);
+    float    getLead();
+    float    getWriteTime();
+    int32_t  getLate();
+
+private:
+    DS3231&            _rtc;
+    PPS*               _gpspps;
+    PPS&               _rtcpps;
+    TaskHandle_t       _task        = nullptr;
+    esp_timer_handle_t _alarm       = nullptr;
+    volatile State     _state       = IDLE;
+    time_t             _target      = 0;    // GPS second the write is for
+    float              _lead        = 0;    // us before the second the write starts
+    float              _write_time  = 0;    // average us the write takes
+    int32_t            _late        = 0;    // us the last write started after its target
+
+    void write();
+    static void alarm(void* data);
+    static void task(void* data);
+};
+
+#endif // _RTC_SETTER_H
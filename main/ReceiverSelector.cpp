@@ -0,0 +1,177 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "ReceiverSelector.h"
+#include <math.h>
+#include <string.h>
+
+ReceiverSelector::ReceiverSelector(const Thresholds& thresholds)
+: _thresholds(thresholds)
+{
+    begin(1);
+}
+
+void ReceiverSelector::begin(uint32_t count)
+{
+    _count      = count < MAX_RECEIVERS ? count : MAX_RECEIVERS;
+    _active     = 0;
+    _switches   = 0;
+    _outvoted   = 0;
+    _consistent = false;
+    _difference = 0;
+    _ref_valid  = false;
+    _reason     = "primary";
+    memset(_health, 0, sizeof(_health));
+    memset(_usable, 0, sizeof(_usable));
+    _health[0].activations = 1;
+}
+
+/**
+ * the receiver the RTC outvotes when the two disagree, -1 if they agree or
+ * there is no majority.  Records the verdict in the health statistics.
+*/
+int ReceiverSelector::vote(const Observation* observations, bool rtc_valid, int32_t rtc_second, float rtc_bound)
+{
+    const Observation& a = observations[0];
+    const Observation& b = observations[1];
+    _difference = b.phase - a.phase;
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        if (fabs(_difference) > _health[i].max_difference)
+        {
+            _health[i].max_difference = fabs(_difference);
+        }
+    }
+
+    if (a.second == b.second && fabs(_difference) <= _thresholds.max_phase)
+    {
+        _consistent = true;
+        _ref_phase  = (a.phase + b.phase) / 2.0;
+        _ref_valid  = true;
+        return -1;
+    }
+    if (!rtc_valid)
+    {
+        return -1;
+    }
+
+    if (a.second != b.second)
+    {
+        bool ok_a = a.second == rtc_second;
+        bool ok_b = b.second == rtc_second;
+        if (ok_a == ok_b)
+        {
+            return -1;
+        }
+        int outlier = ok_a ? 1 : 0;
+        _health[outlier].time_mismatch += 1;
+        return outlier;
+    }
+
+    if (!_ref_valid)
+    {
+        return -1;
+    }
+    float limit = rtc_bound + _thresholds.max_phase;
+    bool  ok_a  = fabs(a.phase - _ref_phase) <= limit;
+    bool  ok_b  = fabs(b.phase - _ref_phase) <= limit;
+    if (ok_a == ok_b)
+    {
+        return -1;
+    }
+    int outlier = ok_a ? 1 : 0;
+    _health[outlier].phase_outliers += 1;
+    return outlier;
+}
+
+/**
+ * update with one observation per receiver, rtc_second and rtc_bound are the RTC
+ * PPS second and its error bound (us), only used when rtc_valid.  Returns the
+ * active receiver.
+*/
+uint32_t ReceiverSelector::update(const Observation* observations, bool rtc_valid, int32_t rtc_second, float rtc_bound)
+{
+    for (uint32_t i = 0; i < _count; ++i)
+    {
+        const Observation& o = observations[i];
+        Health& h  = _health[i];
+        _usable[i] = o.valid && o.pps_fresh;
+        h.seconds += 1;
+        h.phase    = o.phase;
+        if (o.valid)
+        {
+            h.valid_seconds += 1;
+        }
+        if (!o.pps_fresh)
+        {
+            h.pps_missing += 1;
+        }
+        if (i == _active)
+        {
+            h.active_seconds += 1;
+        }
+    }
+
+    _consistent = false;
+    int outlier = -1;
+    if (_count == 2 && _usable[0] && _usable[1])
+    {
+        outlier = vote(observations, rtc_valid, rtc_second, rtc_bound);
+    }
+    else if (_usable[_active])
+    {
+        _ref_phase = observations[_active].phase;
+        _ref_valid = true;
+    }
+    _outvoted = outlier == (int)_active ? _outvoted + 1 : 0;
+
+    int next = -1;
+    if (!_usable[_active])
+    {
+        for (uint32_t i = 0; i < _count; ++i)
+        {
+            if (i != _active && _usable[i])
+            {
+                next    = i;
+                _reason = observations[_active].valid ? "no pps" : "not valid";
+                break;
+            }
+        }
+    }
+    else if (_outvoted >= _thresholds.reject_seconds)
+    {
+        next    = outlier == 0 ? 1 : 0;
+        _reason = "outvoted";
+    }
+
+    if (next >= 0)
+    {
+        _active    = next;
+        _outvoted  = 0;
+        _switches += 1;
+        _health[_active].activations += 1;
+    }
+    return _active;
+}
@@ -0,0 +1,103 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _RECEIVER_SELECTOR_H
+#define _RECEIVER_SELECTOR_H
+
+#include <stdint.h>
+
+//
+// Chooses the active GPS receiver when there is more than one.  Once a GPS second
+// each receiver's validity, PPS second and PPS phase against the RTC PPS are
+// compared.  Receivers agree when they have the same second and their phases are
+// within max_phase.  When two disagree the disciplined RTC is the third vote: the
+// receiver whose second matches the RTC, or whose phase is within the RTC bound of
+// the phase the receivers last agreed on, wins.  The active receiver is left when
+// it is unusable and another is not, or when it has been outvoted reject_seconds in
+// a row.  Switching is not revertive.  No ESP-IDF dependencies.
+//
+class ReceiverSelector
+{
+public:
+    static const uint32_t MAX_RECEIVERS = 2;
+
+    struct Thresholds
+    {
+        float    max_phase;      // us two receivers may differ by and agree
+        uint32_t reject_seconds; // seconds the active receiver must be outvoted to leave it
+    };
+
+    struct Observation
+    {
+        bool    valid;     // time validated (see GPSValidator)
+        bool    pps_fresh; // a new PPS edge since the last observation
+        int32_t second;    // PPS second
+        float   phase;     // PPS edge - RTC PPS edge, us
+    };
+
+    struct Health
+    {
+        uint32_t seconds;        // observations
+        uint32_t valid_seconds;
+        uint32_t pps_missing;
+        uint32_t time_mismatch;  // outvoted on the second
+        uint32_t phase_outliers; // outvoted on the PPS phase
+        uint32_t activations;    // times it became the active receiver
+        uint32_t active_seconds;
+        float    phase;          // last PPS phase against the RTC, us
+        float    max_difference; // largest phase difference to the other receiver, us
+    };
+
+    explicit ReceiverSelector(const Thresholds& thresholds);
+    void     begin(uint32_t count);
+    uint32_t update(const Observation* observations, bool rtc_valid, int32_t rtc_second, float rtc_bound);
+
+    uint32_t getCount() const       { return _count; }
+    uint32_t getActive() const      { return _active; }
+    uint32_t getSwitches() const    { return _switches; }
+    bool     isUsable(uint32_t index) const { return _usable[index]; }
+    bool     isConsistent() const   { return _consistent; }
+    float    getDifference() const  { return _difference; }
+    const char* getReason() const   { return _reason; }
+    const Health& getHealth(uint32_t index) const { return _health[index]; }
+
+private:
+    Thresholds  _thresholds;
+    Health      _health[MAX_RECEIVERS];
+    bool        _usable[MAX_RECEIVERS];
+    uint32_t    _count      = 1;
+    uint32_t    _active     = 0;
+    uint32_t    _switches   = 0;
+    uint32_t    _outvoted   = 0;     // seconds in a row the active receiver was outvoted
+    bool        _consistent = false;
+    float       _difference = 0;     // receiver 1 - receiver 0, us
+    float       _ref_phase  = 0;     // phase the receivers last agreed on, us
+    bool        _ref_valid  = false;
+    const char* _reason     = "primary";
+
+    int  vote(const Observation* observations, bool rtc_valid, int32_t rtc_second, float rtc_bound);
+};
+
+#endif // _RECEIVER_SELECTOR_H
@@ -0,0 +1,191 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "ResumeState.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include <stddef.h>
+#include <string.h>
+
+static const char* TAG = "ResumeState";
+
+#define RESUME_MAGIC 0x52534d31 // "RSM1"
+
+// consecutive resumes allowed before a cold start
+#define RESUME_MAX_RESETS 3
+
+typedef struct resume_block
+{
+    uint32_t   magic;
+    uint32_t   size;
+    uint32_t   sequence;
+    uint32_t   resets;
+    ResumeData data;
+    uint32_t   checksum;
+} resume_block_t;
+
+static RTC_NOINIT_ATTR resume_block_t resume_blocks[2];
+
+// FNV-1a over the block up to the checksum
+static uint32_t checksum(const resume_block_t* block)
+{
+    const uint8_t* p = (const uint8_t*)block;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(resume_block_t, checksum); ++i)
+    {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool isValidBlock(const resume_block_t* block)
+{
+    return block->magic == RESUME_MAGIC
+        && block->size == sizeof(resume_block_t)
+        && block->checksum == checksum(block);
+}
+
+ResumeState::ResumeState()
+{
+    memset(&_data, 0, sizeof(_data));
+}
+
+/**
+ * check for saved state, only a soft reset keeps the RTC slow memory.  Returns
+ * true if there is state to resume from.
+*/
+bool ResumeState::begin()
+{
+    _reason = esp_reset_reason();
+    switch (_reason)
+    {
+        case ESP_RST_SW:
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+        case ESP_RST_DEEPSLEEP:
+            break;
+
+        default:
+            ESP_LOGI(TAG, "::begin %s reset, cold start", getResetReasonName(_reason));
+            invalidate();
+            return false;
+    }
+
+    const resume_block_t* block = nullptr;
+    for (const resume_block_t& b : resume_blocks)
+    {
+        if (isValidBlock(&b) && (block == nullptr || (int32_t)(b.sequence - block->sequence) > 0))
+        {
+            block = &b;
+        }
+    }
+    if (block == nullptr)
+    {
+        ESP_LOGW(TAG, "::begin %s reset, no valid state", getResetReasonName(_reason));
+        return false;
+    }
+
+    if (block->resets >= RESUME_MAX_RESETS)
+    {
+        ESP_LOGW(TAG, "::begin %s reset, %u resumes without running stable, cold start",
+                      getResetReasonName(_reason), block->resets);
+        invalidate();
+        return false;
+    }
+
+    _data     = block->data;
+    _sequence = block->sequence;
+    _resets   = block->resets + 1;
+    _valid    = true;
+    // count this resume in RTC memory now, a crash before the first save must count too
+    save(_data);
+    ESP_LOGI(TAG, "::begin %s reset, resuming (sequence %u resets %u)", getResetReasonName(_reason), _sequence, _resets);
+    return true;
+}
+
+/**
+ * write the state to the older copy
+*/
+void ResumeState::save(const ResumeData& data)
+{
+    _sequence += 1;
+    resume_block_t* block = &resume_blocks[_sequence & 1];
+    block->magic    = RESUME_MAGIC;
+    block->size     = sizeof(resume_block_t);
+    block->sequence = _sequence;
+    block->resets   = _resets;
+    block->data     = data;
+    block->checksum = checksum(block);
+}
+
+void ResumeState::invalidate()
+{
+    for (resume_block_t& block : resume_blocks)
+    {
+        block.magic = 0;
+    }
+    _valid  = false;
+    _resets = 0;
+}
+
+/**
+ * running long enough that the resume did not cause a crash
+*/
+void ResumeState::markStable()
+{
+    _resets = 0;
+}
+
+const char* ResumeState::getResetReasonName(int reason)
+{
+    switch (reason)
+    {
+        case ESP_RST_POWERON:
+            return "power on";
+        case ESP_RST_EXT:
+            return "external";
+        case ESP_RST_SW:
+            return "software";
+        case ESP_RST_PANIC:
+            return "panic";
+        case ESP_RST_INT_WDT:
+            return "interrupt watchdog";
+        case ESP_RST_TASK_WDT:
+            return "task watchdog";
+        case ESP_RST_WDT:
+            return "watchdog";
+        case ESP_RST_DEEPSLEEP:
+            return "deep sleep";
+        case ESP_RST_BROWNOUT:
+            return "brownout";
+        case ESP_RST_SDIO:
+            return "sdio";
+    }
+    return "unknown";
+}
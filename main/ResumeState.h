@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _RESUME_STATE_H
+#define _RESUME_STATE_H
+
+#include <stdint.h>
+
+//
+// sync state saved every second for a fast resume after a soft reset
+//
+struct ResumeData
+{
+    static const uint32_t MAX_OFFSETS = 32;
+
+    int32_t  rtc_seconds;          // RTC PPS second when saved
+    uint8_t  engine;
+    uint8_t  holdover_state;
+    bool     gps_validated;        // the GPS had passed its validity wait
+    int8_t   output;
+    float    integral;             // PID integral term (Ki * integral)
+    float    frequency;            // kalman frequency, ppm
+    float    bound;                // error bound, us
+    float    holdover_output;      // held aging value when saved
+    float    holdover_drift;
+    float    holdover_freq_error;
+    float    holdover_temp;
+    float    clear_bias;           // ticks the RTC clear edge is late
+    uint32_t offset_count;
+    int32_t  offsets[MAX_OFFSETS]; // newest offset samples, oldest first
+};
+
+//
+// ResumeData kept in RTC slow memory so it survives panics, watchdog and software
+// resets.  The memory is not initialised at power on, so two copies are written
+// alternately each with a sequence number and checksum, a reset in the middle of
+// a write leaves the other copy intact and garbage never passes the checksum.
+// Resuming again and again without running for RESUME_STABLE seconds in between
+// falls back to a cold start in case the saved state is what crashes us.
+//
+class ResumeState
+{
+public:
+    ResumeState();
+    bool begin();
+    void save(const ResumeData& data);
+    void invalidate();
+    void markStable();
+
+    bool        isValid() const      { return _valid; }
+    const ResumeData& getData() const { return _data; }
+    uint32_t    getResets() const    { return _resets; }
+    int         getResetReason() const { return _reason; }
+    static const char* getResetReasonName(int reason);
+
+private:
+    bool       _valid  = false;
+    ResumeData _data;
+    uint32_t   _resets = 0;       // consecutive resumes
+    uint32_t   _sequence = 0;
+    int        _reason = 0;
+};
+
+#endif // _RESUME_STATE_H
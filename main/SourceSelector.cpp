@@ -0,0 +1,207 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "SourceSelector.h"
+#include <math.h>
+#include <stdlib.h>
+
+// an endpoint of a correctness interval for the intersection sweep
+struct Endpoint
+{
+    float value;
+    int   type; // -1 lower, +1 upper
+};
+
+static int compareEndpoints(const void* a, const void* b)
+{
+    const Endpoint* ea = static_cast<const Endpoint*>(a);
+    const Endpoint* eb = static_cast<const Endpoint*>(b);
+    if (ea->value != eb->value)
+    {
+        return ea->value < eb->value ? -1 : 1;
+    }
+    // lower endpoints first so touching intervals intersect
+    return ea->type - eb->type;
+}
+
+void SourceSelector::clear()
+{
+    _count        = 0;
+    _falsetickers = 0;
+    _selected     = -1;
+    _offset       = 0;
+    _bound        = 0;
+}
+
+bool SourceSelector::add(const Candidate& candidate)
+{
+    if (_count >= MAX_CANDIDATES || !isfinite(candidate.offset) || !isfinite(candidate.bound))
+    {
+        return false;
+    }
+    _candidates[_count] = candidate;
+    _truechimer[_count] = false;
+    _count += 1;
+    return true;
+}
+
+/**
+ * Marzullo's algorithm as used by NTP: allowing f falsetickers starting with none,
+ * find the lowest point at least count-f intervals contain and the highest, while
+ * f stays a minority.  Returns false if there is no majority.
+*/
+bool SourceSelector::intersect(float* lowp, float* highp) const
+{
+    Endpoint endpoints[MAX_CANDIDATES*2];
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < _count; ++i)
+    {
+        endpoints[n++] = {_candidates[i].offset - _candidates[i].bound, -1};
+        endpoints[n++] = {_candidates[i].offset + _candidates[i].bound, +1};
+    }
+    qsort(endpoints, n, sizeof(Endpoint), compareEndpoints);
+
+    for (uint32_t f = 0; f * 2 < _count; ++f)
+    {
+        uint32_t need  = _count - f;
+        uint32_t depth = 0;
+        float    low   = 0;
+        bool     found = false;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            depth -= endpoints[i].type;
+            if (depth >= need)
+            {
+                low   = endpoints[i].value;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            continue;
+        }
+
+        depth = 0;
+        float high = 0;
+        for (int i = n-1; i >= 0; --i)
+        {
+            depth += endpoints[i].type;
+            if (depth >= need)
+            {
+                high = endpoints[i].value;
+                break;
+            }
+        }
+        if (low <= high)
+        {
+            *lowp  = low;
+            *highp = high;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * run the selection, returns false if there are no candidates
+*/
+bool SourceSelector::select()
+{
+    _falsetickers = 0;
+    _selected     = -1;
+    if (_count == 0)
+    {
+        return false;
+    }
+
+    float low;
+    float high;
+    bool  majority = intersect(&low, &high);
+    for (uint32_t i = 0; i < _count; ++i)
+    {
+        const Candidate& c = _candidates[i];
+        _truechimer[i] = !majority || (c.offset + c.bound >= low && c.offset - c.bound <= high);
+        if (!_truechimer[i])
+        {
+            _falsetickers += 1;
+        }
+    }
+
+    // combine the truechimers weighted by 1/bound^2, the GPS is the system source
+    // whenever it is a truechimer, otherwise the best bound
+    double sum    = 0;
+    double weight = 0;
+    for (uint32_t i = 0; i < _count; ++i)
+    {
+        if (!_truechimer[i])
+        {
+            continue;
+        }
+        const Candidate& c = _candidates[i];
+        double b = c.bound > 0.001 ? c.bound : 0.001;
+        double w = 1.0 / (b * b);
+        sum    += c.offset * w;
+        weight += w;
+        if (_selected < 0
+            || (c.type == GPS && _candidates[_selected].type != GPS)
+            || (_candidates[_selected].type != GPS && c.bound < _candidates[_selected].bound))
+        {
+            _selected = i;
+        }
+    }
+    _offset = sum / weight;
+    _bound  = _candidates[_selected].bound;
+    return true;
+}
+
+/**
+ * index of the first candidate of a type, -1 if there is none
+*/
+int SourceSelector::find(Type type) const
+{
+    for (uint32_t i = 0; i < _count; ++i)
+    {
+        if (_candidates[i].type == type)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* SourceSelector::getTypeName(Type type)
+{
+    switch (type)
+    {
+        case GPS:
+            return "gps";
+        case RTC:
+            return "rtc";
+        case PEER:
+            return "peer";
+    }
+    return "unknown";
+}
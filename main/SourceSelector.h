@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _SOURCE_SELECTOR_H
+#define _SOURCE_SELECTOR_H
+
+#include <stdint.h>
+
+//
+// Selection of the time reference from the candidate sources in the spirit of the
+// NTP selection and clustering algorithms.  Each candidate is an offset from the
+// local clock (the RTC PPS we serve) with an error bound, the intersection step
+// finds the smallest interval that the correctness intervals of a majority of the
+// candidates share.  Candidates whose interval misses it are falsetickers, the
+// rest are truechimers and are combined weighted by their bounds.  The system
+// source is the truechimer with the best bound, the GPS PPS if it is one of them.
+// With only two candidates that disagree there is no majority and nothing is
+// rejected.  No ESP-IDF dependencies.
+//
+class SourceSelector
+{
+public:
+    enum Type : uint8_t
+    {
+        GPS = 0,
+        RTC,
+        PEER,
+    };
+
+    struct Candidate
+    {
+        Type     type;
+        uint32_t id;      // peer address, 0 for the GPS and RTC
+        uint8_t  stratum; // of the source itself, 0 for the GPS and RTC
+        float    offset;  // source - local, us
+        float    bound;   // us
+    };
+
+    static const uint32_t MAX_CANDIDATES = 8;
+
+    void  clear();
+    bool  add(const Candidate& candidate);
+    bool  select();
+
+    uint32_t getCount() const        { return _count; }
+    const Candidate& getCandidate(uint32_t index) const { return _candidates[index]; }
+    bool  isTruechimer(uint32_t index) const { return _truechimer[index]; }
+    uint32_t getFalsetickers() const { return _falsetickers; }
+    int   getSelected() const        { return _selected; }
+    int   find(Type type) const;
+    float getOffset() const          { return _offset; }
+    float getBound() const           { return _bound; }
+
+    static const char* getTypeName(Type type);
+
+private:
+    Candidate _candidates[MAX_CANDIDATES];
+    bool      _truechimer[MAX_CANDIDATES];
+    uint32_t  _count        = 0;
+    uint32_t  _falsetickers = 0;
+    int       _selected     = -1;
+    float     _offset       = 0;
+    float     _bound        = 0;
+
+    bool intersect(float* lowp, float* highp) const;
+};
+
+#endif // _SOURCE_SELECTOR_H
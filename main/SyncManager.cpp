@@ -25,6 +25,10 @@
 #include "SyncManager.h"
 //#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
 #include "esp_log.h"
+#include "freertos/xtensa_api.h"
+#include <math.h>
+#include <strings.h>
+#include <string.h>
 
 #if defined(CONFIG_GPSNTP_RTC_DRIFT_MAX)
 #define RTC_DRIFT_MAX CONFIG_GPSNTP_RTC_DRIFT_MAX
@@ -40,28 +44,343 @@
 #define SYNC_TASK_CORE 1
 #endif
 
-#define LATENCY_PIN 2
+#if defined(CONFIG_GPSNTP_SYNC_EDGE_WAKE)
+#define SYNC_EDGE_WAKE
+#endif
+
+// CPU interrupt 7 is the level 1 software interrupt ETS_INTERNAL_SW0_INTR_SOURCE
+#define SYNC_SW_INTR_MASK (1 << 7)
+
+// with edge wake the task also wakes at least every SYNC_WAIT_MAX ms and close
+// to SYNC_WINDOW us into the GPS second for the end of second checks
+#define SYNC_WAIT_MAX 250
+#define SYNC_WINDOW   850000
+
+// seconds between checks of the RTC calendar against the RTC PPS seconds, the check
+// is only done between RTC_CHECK_MIN and RTC_CHECK_MAX us into the RTC second so the
+// I2C read can not straddle the RTC second changing
+#define RTC_CHECK_INTERVAL 60
+#define RTC_CHECK_MIN      200000
+#define RTC_CHECK_MAX      800000
+
+// seconds between SYNC_OFFSET_STATS reports of the sync task load
+#define LOAD_STATS_INTERVAL 60
+
+// PPS intervals outside of +/- 50us are logged
+#define INTERVAL_MIN (MicroSecondTimer::TICKS_PER_SEC - 50*MicroSecondTimer::TICKS_PER_USEC)
+#define INTERVAL_MAX (MicroSecondTimer::TICKS_PER_SEC + 50*MicroSecondTimer::TICKS_PER_USEC)
+
+// weight of a new sample in the RTC clear edge bias
+#define CLEAR_BIAS_ALPHA (1.0/32.0)
+
+// seconds the GPS top of second must be consistently off before it is moved, and
+// consistently right before the offsets against it are used again
+#define TOP_SHIFT_COUNT 3
+
+// the receivers output starts up to ~200ms after the top of second so it only
+// finds the top of second up to this rate, faster rates need the disciplined RTC
+#define TOP_BURST_RATE_MAX 4
+
+// the timepulse rate is raised this early in a second so the receiver has changed
+// over, or nearly so, by the next top of second
+#define TOP_RAISE_WINDOW 100000
+
+// number of offset samples per SYNC_OFFSET_STATS report
+#define OFFSET_STATS_COUNT 600
+
+// GPS PPS edges per capture bench report, edges the ISR and MCPWM times of are
+// further apart than CAPTURE_BENCH_MAX are not the same edge
+#define CAPTURE_BENCH_COUNT 300
+#define CAPTURE_BENCH_MAX   (1000*MicroSecondTimer::TICKS_PER_USEC)
+
+// frequency change of the DS3231 per aging LSB in ppm (us/s) until it is characterised
+#define NOMINAL_GAIN 0.1
+
+// the integral is limited to what moves the RTC frequency this many ppm
+#define INTEGRAL_LIMIT_PPM 6.4
+
+// seconds over which the kalman engine removes a phase error
+#define KALMAN_TAU 30.0
+
+#if defined(CONFIG_GPSNTP_KALMAN_AGING)
+#define KALMAN_AGING true
+#else
+#define KALMAN_AGING false
+#endif
+
+// lower limit of the measurement variance (us^2) given to the kalman filter
+#define KALMAN_VARIANCE_MIN 0.01
+
+#if defined(CONFIG_GPSNTP_OFFSET_MEDIAN)
+#define OFFSET_ESTIMATOR OffsetFilter::MEDIAN
+#elif defined(CONFIG_GPSNTP_OFFSET_MAD)
+#define OFFSET_ESTIMATOR OffsetFilter::MAD_MEAN
+#else
+#define OFFSET_ESTIMATOR OffsetFilter::TRIMMED_MEAN
+#endif
+
+#if defined(CONFIG_GPSNTP_HOLDOVER_FREQ_ERROR)
+#define HOLDOVER_FREQ_ERROR (CONFIG_GPSNTP_HOLDOVER_FREQ_ERROR/1000.0)
+#else
+#define HOLDOVER_FREQ_ERROR 0.02
+#endif
+
+#if defined(CONFIG_GPSNTP_HOLDOVER_STRATUM_BOUND)
+#define HOLDOVER_STRATUM_BOUND CONFIG_GPSNTP_HOLDOVER_STRATUM_BOUND
+#else
+#define HOLDOVER_STRATUM_BOUND 100
+#endif
+
+#if defined(CONFIG_GPSNTP_HOLDOVER_MAX_BOUND)
+#define HOLDOVER_MAX_BOUND CONFIG_GPSNTP_HOLDOVER_MAX_BOUND
+#else
+#define HOLDOVER_MAX_BOUND 10000
+#endif
+
+// worst case DS3231 aging of 1ppm per year in ppm/s, grows the holdover bound
+#define HOLDOVER_AGING_RATE (1.0/(365.0*86400.0))
+
+// holdover frequency uncertainty in ppm per degree C the temperature has moved
+// since holdover started, without and with the temperature model covering it
+#define HOLDOVER_TEMP_COEFF       0.1
+#define HOLDOVER_TEMP_MODEL_COEFF 0.01
+
+// the kalman frequency uncertainty is taken at this many standard deviations
+#define HOLDOVER_SIGMA 3.0
+
+// the first lock needs the error within this many us
+#define HOLDOVER_LOCK_ERROR 10.0
+
+// While locked and settled the discipline state is checked every CHECKPOINT_INTERVAL
+// seconds (the first after CHECKPOINT_FIRST seconds locked) and only written to NVS
+// if the aging value moved CHECKPOINT_OUTPUT LSB, the temperature CHECKPOINT_TEMP C or
+// the saved one is CHECKPOINT_REFRESH seconds old.  The temperature model is saved
+// with it.  A checkpoint older than CHECKPOINT_MAX_AGE seconds is not restored.
+#define CHECKPOINT_FIRST    600
+#define CHECKPOINT_INTERVAL 3600
+#define CHECKPOINT_REFRESH  86400
+#define CHECKPOINT_OUTPUT   0.5
+#define CHECKPOINT_TEMP     1.0
+#define CHECKPOINT_MAX_AGE  (30*86400)
+
+// a resume block is used if saved within RESUME_MAX_AGE seconds of the RTC time,
+// a resume counts as good after RESUME_STABLE seconds of uptime.  After a resume
+// the sync task starts after RESUME_DELAY ms instead of 5 seconds.
+#define RESUME_MAX_AGE 60
+#define RESUME_STABLE  60
+#define RESUME_DELAY   1000
+
+// The GPS is rejected by the source selection after SOURCE_REJECT falseticker
+// verdicts in a row and accepted again after SOURCE_ACCEPT truechimer ones.  Its
+// bound is half the offset spread plus SOURCE_GPS_BOUND us.
+#define SOURCE_REJECT    3
+#define SOURCE_ACCEPT    10
+#define SOURCE_GPS_BOUND 1.0
+
+// With a second GPS receiver the two agree when their PPS edges are within
+// RECEIVER_MAX_PHASE us, the active one is left after RECEIVER_REJECT seconds
+// outvoted.  Their health is logged every RECEIVER_STATS_INTERVAL seconds.
+#if defined(CONFIG_GPSNTP_GPS2_MAX_PHASE)
+#define RECEIVER_MAX_PHASE CONFIG_GPSNTP_GPS2_MAX_PHASE
+#else
+#define RECEIVER_MAX_PHASE 5
+#endif
+#define RECEIVER_REJECT         3
+#define RECEIVER_STATS_INTERVAL 300
+
+// the NTP reference id while GPS disciplined or holding over from it
+#define GPS_REF_ID "GPS "
+
+// Peer samples older than PEER_MAX_AGE seconds are not used, their bound grows by
+// PEER_DRIFT us per second of age.  With a peer as the reference in holdover the
+// output is steered to remove the peer offset with a PEER_TAU second time constant,
+// by at most PEER_STEER_MAX LSB.
+#define PEER_MAX_AGE    1024
+#define PEER_DRIFT      15.0
+#define PEER_TAU        1024.0
+#define PEER_STEER_MAX  10.0
+
+#if defined(CONFIG_GPSNTP_GPS_VALID_SECONDS)
+#define GPS_VALID_SECONDS CONFIG_GPSNTP_GPS_VALID_SECONDS
+#else
+#define GPS_VALID_SECONDS 10
+#endif
+
+#if defined(CONFIG_GPSNTP_GPS_MIN_SATS)
+#define GPS_MIN_SATS CONFIG_GPSNTP_GPS_MIN_SATS
+#else
+#define GPS_MIN_SATS 4
+#endif
+
+#if defined(CONFIG_GPSNTP_GPS_MAX_POSITION_ERROR)
+#define GPS_MAX_POSITION_ERROR CONFIG_GPSNTP_GPS_MAX_POSITION_ERROR
+#else
+#define GPS_MAX_POSITION_ERROR 50
+#endif
+
+#if defined(CONFIG_GPSNTP_GPS_MAX_PPS_JITTER)
+#define GPS_MAX_PPS_JITTER CONFIG_GPSNTP_GPS_MAX_PPS_JITTER
+#else
+#define GPS_MAX_PPS_JITTER 10
+#endif
+
+// GPS validity is checked once per GPS second between GPS_CHECK_MIN and GPS_CHECK_MAX
+// us into it when the RMC has arrived, or after GPS_CHECK_TIMEOUT us without PPS.  The
+// PPS second is set from the RMC in the same window, at 9600 baud the burst can take
+// most of 700ms so it does not start before 800ms.
+#define GPS_CHECK_MIN     800000
+#define GPS_CHECK_MAX     900000
+#define GPS_CHECK_TIMEOUT 1500000
+
+// seconds between temperature reads, the DS3231 converts every 64 seconds
+#define TEMP_INTERVAL 16
+
+// the temperature model only learns while the error is within this many us
+#define TEMP_LEARN_ERROR 2.0
+
+// the controller is settled once the error has been within SETTLE_ERROR us for
+// SETTLE_COUNT intervals, the RMS error is reported every CONTROL_STATS_COUNT after that
+#define SETTLE_ERROR        1.0
+#define SETTLE_COUNT        60
+#define CONTROL_STATS_COUNT 600
 
 static const char* TAG = "SyncManager";
+static const char* TEMP_MODEL_KEY = "temp_model";
+static const char* AGING_CAL_KEY  = "aging_cal";
+static const char* CHECKPOINT_KEY = "clock_state";
+
+static const GPSValidator::Thresholds validator_thresholds =
+{
+    .seconds            = GPS_VALID_SECONDS,
+    .revalidate_seconds = 3,    // a receiver that was valid before
+    .revalidate_window  = 1800, // and lost it for at most 30 minutes
+    .min_fix_type       = 3,
+    .min_sats           = GPS_MIN_SATS,
+    .max_position_error = GPS_MAX_POSITION_ERROR,
+    .max_jitter         = GPS_MAX_PPS_JITTER,
+    .max_interval_error = 100,  // the timer crystal can be 50ppm off
+    .utc_wait_seconds   = 1200, // 20 minutes to be sure of the leap seconds
+};
+
+static const ReceiverSelector::Thresholds receiver_thresholds =
+{
+    .max_phase      = RECEIVER_MAX_PHASE,
+    .reject_seconds = RECEIVER_REJECT,
+};
 
-SyncManager::SyncManager(GPS& gps, DS3231& rtc, PPS& gpspps, PPS& rtcpps)
-: _gps(gps),
+SyncManager::SyncManager(Config& config, GPS& gps, DS3231& rtc, PPS& gpspps, PPS& rtcpps)
+: _config(config),
+  _gps(&gps),
   _rtc(rtc),
-  _gpspps(gpspps),
-  _rtcpps(rtcpps)
+  _gpspps(&gpspps),
+  _rtcpps(rtcpps),
+  _rtc_setter(rtc, gpspps, rtcpps),
+  _offsets(OFFSET_DATA_SIZE, OFFSET_ESTIMATOR),
+  _kalman(NOMINAL_GAIN, KALMAN_AGING),
+  _holdover(HOLDOVER_AGING_RATE),
+  _validators{GPSValidator(validator_thresholds), GPSValidator(validator_thresholds)},
+  _receiver_selector(receiver_thresholds)
+#ifdef PPS_MODEL_CHECK
+  , _model_check(gpspps, rtcpps)
+#endif
 {
+    uint32_t ref_id;
+    memcpy(&ref_id, GPS_REF_ID, sizeof(ref_id));
+    _ref_id = ref_id;
+    _receivers[0]    = &gps;
+    _receiver_pps[0] = &gpspps;
 }
 
 bool SyncManager::begin()
 {
+    ESP_LOGI(TAG, "::begin offset window %u samples %s estimator", _offsets.getSize(),
+                  OffsetFilter::getEstimatorName(_offsets.getEstimator()));
+    TempModel::Data data;
+    if (_config.getBlob(TEMP_MODEL_KEY, &data, sizeof(data)) && _temp_model.setData(data))
+    {
+        ESP_LOGI(TAG, "::begin loaded temperature model with %u bins", _temp_model.getBins());
+    }
+    memset(&_aging_cal, 0, sizeof(_aging_cal));
+    if (_config.getBlob(AGING_CAL_KEY, &_aging_cal, sizeof(_aging_cal)) && AgingSweep::isValid(_aging_cal))
+    {
+        ESP_LOGI(TAG, "::begin loaded aging characterisation gain=%0.1fppb/LSB curve=%0.3fppb/LSB^2",
+                      _aging_cal.gain*1000, _aging_cal.curve*1000);
+    }
+    if (!resume())
+    {
+        restoreCheckpoint();
+    }
+    _rtc_setter.begin();
+    _receiver_selector.begin(_receiver_count);
+
     ESP_LOGI(TAG, "::begin create Sync task at priority %d core %d", SYNC_TASK_PRI, SYNC_TASK_CORE);
     xTaskCreatePinnedToCore(task, "Sync", 4096, this, SYNC_TASK_PRI, &_task, SYNC_TASK_CORE);
+
+#ifdef SYNC_EDGE_WAKE
+    // the software interrupt is raised by the PPS ISR so it must be allocated on the same
+    // core, begin() is called from the init task on the core that set up the PPS interrupts
+    esp_err_t err = esp_intr_alloc(ETS_INTERNAL_SW0_INTR_SOURCE, ESP_INTR_FLAG_IRAM, edge, this, &_intr);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "::begin failed to allocate software interrupt, polling: %d (%s)", err, esp_err_to_name(err));
+        _intr = nullptr;
+        return true;
+    }
+    _gpspps->setNotify(SYNC_SW_INTR_MASK);
+    _rtcpps.setNotify(SYNC_SW_INTR_MASK);
+#endif
     return true;
 }
 
+/**
+ * software interrupt raised after each GPS or RTC edge, wakes the sync task
+*/
+void IRAM_ATTR SyncManager::edge(void* data)
+{
+    SyncManager* syncman = static_cast<SyncManager*>(data);
+    xt_set_intclear(SYNC_SW_INTR_MASK);
+    if (syncman->_task == nullptr)
+    {
+        return;
+    }
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(syncman->_task, &woken);
+    if (woken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * wait for the next edge, or for the end of second window or SYNC_WAIT_MAX if that
+ * comes first.  Without edge wake this is the original 10ms poll.
+*/
+void SyncManager::wait()
+{
+    if (_intr == nullptr)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        return;
+    }
+
+    struct timeval tv;
+    _gpspps->getTime(&tv);
+    int32_t ms = ((int32_t)SYNC_WINDOW - (int32_t)tv.tv_usec) / 1000;
+    if (ms <= 0)
+    {
+        ms += 1000;
+    }
+    if (ms > SYNC_WAIT_MAX)
+    {
+        ms = SYNC_WAIT_MAX;
+    }
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+}
+
 time_t SyncManager::getGPSTime()
 {
-    return _gps.getRMCTime();
+    return _gps->getRMCTime();
 }
 
 time_t SyncManager::getRTCTime()
@@ -69,302 +388,2124 @@ time_t SyncManager::getRTCTime()
     return _rtc_time;
 }
 
+/**
+ * number of times the RTC calendar did not match the RTC PPS second counter
+*/
+uint32_t SyncManager::getRTCMismatchCount()
+{
+    return _rtc_mismatch;
+}
+
+/**
+ * The RTC time is kept from the RTC PPS second counter, the calendar is only read
+ * over I2C at startup, after a correction and every RTC_CHECK_INTERVAL seconds to
+ * check it still agrees.
+*/
+void SyncManager::updateRTCTime()
+{
+    struct timeval tv;
+    _rtcpps.getTime(&tv);
+
+    uint32_t uptime = getUptime();
+    if ((_rtc_check || uptime - _rtc_check_time >= RTC_CHECK_INTERVAL)
+        && tv.tv_usec > RTC_CHECK_MIN
+        && tv.tv_usec < RTC_CHECK_MAX)
+    {
+        struct tm tm;
+        if (_rtc.getTime(&tm))
+        {
+            int32_t delta = mktime(&tm) - tv.tv_sec;
+            if (delta != 0)
+            {
+                _rtc_mismatch += 1;
+                ESP_LOGW(TAG, "::updateRTCTime: RTC calendar %+d seconds from RTC PPS (%u mismatches)", delta, _rtc_mismatch);
+            }
+            _rtc_delta      = delta;
+            _rtc_check      = false;
+            _rtc_check_time = uptime;
+        }
+    }
+
+    _rtc_time = tv.tv_sec + _rtc_delta;
+}
+
 void SyncManager::getRTCPPSTime(struct timeval* tv)
 {
     _rtcpps.getTime(tv);
 }
 
-void SyncManager::getGPSPPSTime(struct timeval* tv)
-{
-    _gpspps.getTime(tv);
+void SyncManager::getGPSPPSTime(struct timeval* tv)
+{
+    _gpspps->getTime(tv);
+}
+
+float SyncManager::getError()
+{
+    return _target - (float)getOffset();
+}
+
+float SyncManager::getPreviousError()
+{
+    return _pid.getPreviousError();
+}
+
+float SyncManager::getIntegral()
+{
+    return _pid.getIntegral();
+}
+
+uint32_t SyncManager::getUptime()
+{
+    return (esp_timer_get_time() / 1000000);
+}
+
+void SyncManager::recordOffset()
+{
+    // every RTC PPS edge that follows a GPS PPS edge gives us one offset sample, in dual
+    // edge mode the RTC clear edge half a second later gives another.  With a GPS
+    // timepulse faster than 1Hz the sample is taken at the next GPS edge when the
+    // averaged phase of the previous top of second is known.
+    bool averaged = _gpspps->getRate() > 1;
+    pps_edge_t edge;
+    while (_edges.read(&edge))
+    {
+        if (edge.pin == (uint32_t)_gpspps->getPin())
+        {
+            _gps_edge       = edge.timer;
+            _gps_edge_valid = true;
+            if (averaged)
+            {
+                recordAveragedOffset(edge);
+            }
+            continue;
+        }
+
+        if ((edge.pin & ~PPS_EDGE_CLEAR) != (uint32_t)_rtcpps.getPin() || !_gps_edge_valid)
+        {
+            continue;
+        }
+
+        // same as the ISR, the offset is the distance to the closest GPS PPS edge
+        int32_t offset;
+        if (edge.pin & PPS_EDGE_CLEAR)
+        {
+            if (!_assert_offset_valid)
+            {
+                continue;
+            }
+            // the clear edge is half a (measured) second after the assert edge
+            int32_t half = (int32_t)(_gpspps->getSecondTicks() / 2.0 + 0.5);
+            offset = wrapOffset(edge.timer - _gps_edge - half);
+            // the SQW output is open drain so the rising (clear) edge is slower, learn the
+            // difference from the assert edge just before it and take it out.  The first
+            // difference seeds it so a biased clear offset never reaches the window.
+            float bias = (float)(offset - _assert_offset);
+            if (_clear_bias_valid)
+            {
+                _clear_bias += (bias - _clear_bias) * CLEAR_BIAS_ALPHA;
+            }
+            else
+            {
+                _clear_bias       = bias;
+                _clear_bias_valid = true;
+            }
+            offset -= (int32_t)roundf(_clear_bias);
+        }
+        else if (averaged)
+        {
+            _rtc_edge       = edge.timer;
+            _rtc_edge_valid = true;
+            continue;
+        }
+        else
+        {
+            offset = wrapOffset(edge.timer - _gps_edge);
+            _assert_offset       = offset;
+            _assert_offset_valid = true;
+        }
+
+        addOffset(offset);
+    }
+}
+
+/**
+ * with a fast GPS timepulse take the offset of the last RTC edge from the previous
+ * GPS top of second averaged over all of its sub second pulses.
+*/
+void SyncManager::recordAveragedOffset(const pps_edge_t& edge)
+{
+    pps_snapshot_t gps;
+    _gpspps->snapshot(&gps);
+    int32_t correction;
+    if (!_rtc_edge_valid || gps.last != edge.timer || !_gpspps->getPhaseCorrection(&gps, &correction))
+    {
+        return;
+    }
+
+    // wrap on the measured second as the RTC edge may be close to either GPS edge
+    int32_t offset = _rtc_edge - (gps.last - gps.interval) - correction;
+    if (offset >= (int32_t)gps.interval/2)
+    {
+        offset -= gps.interval;
+    }
+    else if (offset <= -(int32_t)gps.interval/2)
+    {
+        offset += gps.interval;
+    }
+    _assert_offset       = offset;
+    _assert_offset_valid = true;
+    _rtc_edge_valid      = false;
+    addOffset(offset);
+}
+
+/**
+ * set the GPS timepulse rate, the receivers run at 1Hz until the RTC is disciplined
+ * and then its PPS edge tells which pulse is the top of second.
+*/
+void SyncManager::setTimepulseRate(uint32_t rate)
+{
+    _pps_rate = rate > 1 ? rate : 1;
+}
+
+/**
+ * keep the GPS top of second of each receiver on the real top of second, the standby
+ * is kept aligned too so a switchover lands on the right second.  Once the RTC error
+ * bound is within a quarter pulse its PPS edge is the top of second, the receivers are
+ * raised to the configured rate then.  Without that slow rates fall back to the start
+ * of the receivers output, faster ones keep counting pulses.  Returns true while the
+ * offsets against the active receivers top of second can not be used.
+*/
+bool SyncManager::alignTimepulse()
+{
+    bool trusted = _holdover.getState() != Holdover::UNLOCKED
+                && _holdover.getErrorBound() < 250000.0 / _pps_rate;
+
+    for (uint32_t i = 0; i < _receiver_count; ++i)
+    {
+        PPS* pps = _receiver_pps[i];
+        pps_snapshot_t snap;
+        pps->snapshot(&snap);
+        if (snap.last == _align_last[i])
+        {
+            continue;
+        }
+        _align_last[i] = snap.last;
+
+        uint32_t rate = pps->getRate();
+        if (rate < _pps_rate)
+        {
+            struct timeval tv;
+            pps->getTime(&tv);
+            if (!trusted || !_validators[i].isValid() || tv.tv_usec > TOP_RAISE_WINDOW)
+            {
+                continue;
+            }
+            if (!_receivers[i]->setTimepulseRate(_pps_rate))
+            {
+                ESP_LOGE(TAG, "::alignTimepulse GPS %u can not do %uHz, staying at 1Hz", i+1, _pps_rate);
+                _pps_rate = 1;
+                continue;
+            }
+            // the receiver changes over some time in this second, the top of second
+            // is checked against the RTC until it is right
+            ESP_LOGI(TAG, "::alignTimepulse GPS %u timepulse raised to %uHz", i+1, _pps_rate);
+            pps->setRate(_pps_rate);
+            _top_shift[i]       = 0;
+            _top_shift_count[i] = 0;
+            _top_settle[i]      = TOP_SHIFT_COUNT;
+            continue;
+        }
+        if (rate < 2)
+        {
+            continue;
+        }
+
+        uint32_t shift;
+        if (trusted)
+        {
+            // the RTC edge is held _target from the real top of second
+            pps_snapshot_t rtc;
+            _rtcpps.snapshot(&rtc);
+            shift = pps->getTopShift(rtc.last - (int32_t)roundf(_target * MicroSecondTimer::TICKS_PER_USEC));
+        }
+        else if (rate <= TOP_BURST_RATE_MAX)
+        {
+            // the output starts less than a pulse after the top of second
+            uint32_t half = (uint32_t)(pps->getSecondTicks() / rate / 2.0);
+            shift = pps->getTopShift(_receivers[i]->getBurstTimer() - half);
+        }
+        else
+        {
+            continue;
+        }
+
+        if (shift == 0 || shift != _top_shift[i])
+        {
+            if (shift == 0 && _top_settle[i] > 0)
+            {
+                _top_settle[i] -= 1;
+            }
+            _top_shift[i]       = shift;
+            _top_shift_count[i] = 0;
+            continue;
+        }
+
+        if (++_top_shift_count[i] >= TOP_SHIFT_COUNT)
+        {
+            ESP_LOGW(TAG, "::alignTimepulse moving GPS %u top of second by %u pulses", i+1, shift);
+            pps->shiftTop(shift);
+            _top_shift[i]       = 0;
+            _top_shift_count[i] = 0;
+            _top_settle[i]      = TOP_SHIFT_COUNT;
+        }
+    }
+    return _top_settle[_active] > 0 || _top_shift[_active] != 0;
+}
+
+void SyncManager::addOffset(int32_t offset)
+{
+#ifdef SYNC_OFFSET_STATS
+    recordOffsetStats(offset);
+#endif
+
+    // the first sample after the RTC was set shows how far off the set was
+    if (_rtc_set_calibrate)
+    {
+        _rtc_setter.calibrate((float)offset / MicroSecondTimer::TICKS_PER_USEC - _target);
+        _rtc_set_calibrate = false;
+    }
+
+    _offsets.add(offset);
+    _offset_samples += 1;
+    _offset_estimate = _offsets.getEstimate();
+    _offset_min      = _offsets.getMin();
+    _offset_max      = _offsets.getMax();
+
+    pps_snapshot_t gps;
+    pps_snapshot_t rtc;
+    _gpspps->snapshot(&gps);
+    _rtcpps.snapshot(&rtc);
+    if (rtc.interval < INTERVAL_MIN || rtc.interval > INTERVAL_MAX)
+    {
+        ESP_LOGW(TAG, "::recordOffset: RTC interval out of range: %u", rtc.interval);
+    }
+    if (gps.interval < INTERVAL_MIN || gps.interval > INTERVAL_MAX)
+    {
+        ESP_LOGW(TAG, "::recordOffset: GPS interval out of range: %u", gps.interval);
+    }
+}
+
+/**
+ * wrap a tick offset to the closest second, +/- half a second
+*/
+int32_t SyncManager::wrapOffset(int32_t offset)
+{
+    if (offset >= (int32_t)MicroSecondTimer::TICKS_PER_SEC/2)
+    {
+        offset -= MicroSecondTimer::TICKS_PER_SEC;
+    }
+    else if (offset <= -(int32_t)MicroSecondTimer::TICKS_PER_SEC/2)
+    {
+        offset += MicroSecondTimer::TICKS_PER_SEC;
+    }
+    return offset;
+}
+
+/**
+ * get the learned delay of the RTC clear edge vs the assert edge in microseconds
+*/
+RTCSetter& SyncManager::getRTCSetter()
+{
+    return _rtc_setter;
+}
+
+float SyncManager::getClearBias()
+{
+    return _clear_bias / MicroSecondTimer::TICKS_PER_USEC;
+}
+
+void SyncManager::setEngine(Engine engine)
+{
+    if (engine == _engine)
+    {
+        return;
+    }
+    ESP_LOGI(TAG, "::setEngine %s -> %s", getEngineName(_engine), getEngineName(engine));
+    _engine = engine;
+    _kalman.reset(0);
+    _kalman.invalidate();
+    resetOffset();
+}
+
+SyncManager::Engine SyncManager::getEngine()
+{
+    return _engine;
+}
+
+const ClockKalman& SyncManager::getKalman()
+{
+    return _kalman;
+}
+
+const char* SyncManager::getEngineName(Engine engine)
+{
+    switch (engine)
+    {
+        case ENGINE_PID:
+            return "pid";
+        case ENGINE_KALMAN:
+            return "kalman";
+    }
+    return "unknown";
+}
+
+bool SyncManager::parseEngine(const char* name, Engine* enginep)
+{
+    for (Engine engine : {ENGINE_PID, ENGINE_KALMAN})
+    {
+        if (strcasecmp(name, getEngineName(engine)) == 0)
+        {
+            *enginep = engine;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SyncManager::setGains(float kp, float ki, float kd)
+{
+    ESP_LOGI(TAG, "::setGains kp=%0.3f ki=%0.4f kd=%0.3f", kp, ki, kd);
+    _pid.setGains(kp, ki, kd);
+}
+
+float SyncManager::getKp()
+{
+    return _pid.getKp();
+}
+
+float SyncManager::getKi()
+{
+    return _pid.getKi();
+}
+
+float SyncManager::getKd()
+{
+    return _pid.getKd();
+}
+
+/**
+ * request an automatic tuning of the PID gains and bias, it starts on the next
+ * PID interval once the offset is valid and takes at most about 20 minutes.
+*/
+void SyncManager::startTune()
+{
+    _tune_request = true;
+}
+
+const PIDTuner& SyncManager::getTuner()
+{
+    return _tuner;
+}
+
+/**
+ * request a characterisation of the aging register, it starts on the next PID
+ * interval once the offset is valid and takes about 15 minutes.
+*/
+void SyncManager::startSweep()
+{
+    _sweep_request = true;
+}
+
+const AgingSweep& SyncManager::getSweep()
+{
+    return _sweep;
+}
+
+const AgingSweep::Result& SyncManager::getAgingCal()
+{
+    return _aging_cal;
+}
+
+/**
+ * RTC frequency change in ppm per aging LSB at the current output, from the
+ * characterisation if there is one and the nominal DS3231 value if not.
+*/
+float SyncManager::getPlantGain()
+{
+    if (!AgingSweep::isValid(_aging_cal))
+    {
+        return NOMINAL_GAIN;
+    }
+    return AgingSweep::getGain(_aging_cal, _output);
+}
+
+/**
+ * the aging value the active engine expects to hold the RTC frequency
+*/
+float SyncManager::getSteadyOutput()
+{
+    if (_engine == ENGINE_KALMAN && _kalman.isValid())
+    {
+        return -_kalman.getFrequency() / getPlantGain();
+    }
+    return getFeedForward() + _pid.getIntegralOutput();
+}
+
+const Holdover& SyncManager::getHoldover()
+{
+    return _holdover;
+}
+
+/**
+ * predicted bound of the RTC time error in microseconds
+*/
+float SyncManager::getErrorBound()
+{
+    return _error_bound;
+}
+
+/**
+ * NTP stratum for the current error bound, 16 if not synchronised
+*/
+uint8_t SyncManager::getStratum()
+{
+    return _stratum;
+}
+
+bool SyncManager::isSynchronized()
+{
+    return _stratum < 16;
+}
+
+/**
+ * NTP peers to include in the source selection, set before begin()
+*/
+void SyncManager::setPeerClient(PeerClient* peers)
+{
+    _peers = peers;
+}
+
+/**
+ * APLL frequency output to move to the active receiver on a switchover
+*/
+void SyncManager::setAPLL(APLLSteering* apll)
+{
+    _apll = apll;
+}
+
+const SourceSelector& SyncManager::getSelector()
+{
+    return _selector;
+}
+
+SourceSelector::Type SyncManager::getReference()
+{
+    return _reference;
+}
+
+uint32_t SyncManager::getReferenceSwitches()
+{
+    return _reference_switches;
+}
+
+uint32_t SyncManager::getSourceCount()
+{
+    return _source_count;
+}
+
+uint32_t SyncManager::getFalsetickers()
+{
+    return _falsetickers;
+}
+
+/**
+ * the NTP reference id as sent, "GPS " or the IPv4 address of the peer
+*/
+uint32_t SyncManager::getRefId()
+{
+    return _ref_id;
+}
+
+float SyncManager::getRootDelay()
+{
+    return _root_delay;
+}
+
+float SyncManager::getTemperature()
+{
+    return _temperature;
+}
+
+/**
+ * the feed-forward part of the PID output, the temperature model once it has
+ * learned the current temperature and the configured bias until then.
+*/
+float SyncManager::getFeedForward()
+{
+    float ff;
+    if (!_temperature_valid || !_temp_model.predict(_temperature, &ff))
+    {
+        ff = _bias;
+    }
+    return ff;
+}
+
+const TempModel& SyncManager::getTempModel()
+{
+    return _temp_model;
+}
+
+bool SyncManager::isOffsetValid()
+{
+    return _offsets.isFull();
+}
+
+float SyncManager::getBias()
+{
+    return _bias;
+}
+
+void SyncManager::setBias(float bias)
+{
+    ESP_LOGI(TAG, "setBias: %0f", bias);
+    _bias = bias;
+    resetOffset();
+}
+
+float SyncManager::getTarget()
+{
+    return _target;
+}
+
+void SyncManager::setTarget(float target)
+{
+    ESP_LOGI(TAG, "setTarget: %0f", target);
+    _target = target;
+    resetOffset();
+}
+
+bool SyncManager::isValid()
+{
+    return _validators[_active].isValid();
+}
+
+const char* SyncManager::getValidReason()
+{
+    return _validators[_active].getReason();
+}
+
+const GPSValidator& SyncManager::getValidator()
+{
+    return _validators[_active];
+}
+
+/**
+ * add a standby GPS receiver and its PPS, before begin()
+*/
+bool SyncManager::addReceiver(GPS& gps, PPS& pps)
+{
+    if (_receiver_count >= ReceiverSelector::MAX_RECEIVERS)
+    {
+        ESP_LOGE(TAG, "::addReceiver: only %u receivers are supported", ReceiverSelector::MAX_RECEIVERS);
+        return false;
+    }
+    _receivers[_receiver_count]    = &gps;
+    _receiver_pps[_receiver_count] = &pps;
+    _receiver_count += 1;
+    ESP_LOGI(TAG, "::addReceiver: %u receivers", _receiver_count);
+    return true;
+}
+
+uint32_t SyncManager::getReceiverCount()
+{
+    return _receiver_count;
+}
+
+uint32_t SyncManager::getActiveReceiver()
+{
+    return _active;
+}
+
+const ReceiverSelector& SyncManager::getReceiverSelector()
+{
+    return _receiver_selector;
+}
+
+const GPSValidator& SyncManager::getReceiverValidator(uint32_t index)
+{
+    return _validators[index];
+}
+
+/**
+ * gather the evidence for the GPS time once a GPS second (see GPSValidator) from
+ * each receiver, choose the active receiver and return if it is valid.
+*/
+bool SyncManager::validateGPS()
+{
+    struct timeval tv;
+    _gpspps->getTime(&tv);
+    int64_t now = esp_timer_get_time();
+    bool window = tv.tv_usec > GPS_CHECK_MIN && tv.tv_usec < GPS_CHECK_MAX;
+    bool due    = (window && tv.tv_sec != _validate_second) || now - _validate_time > GPS_CHECK_TIMEOUT;
+    if (!due)
+    {
+        return _validators[_active].isValid();
+    }
+    _validate_second = tv.tv_sec;
+    _validate_time   = now;
+
+    ReceiverSelector::Observation observations[ReceiverSelector::MAX_RECEIVERS];
+    for (uint32_t i = 0; i < _receiver_count; ++i)
+    {
+        validateReceiver(i, window, &observations[i]);
+    }
+
+    if (_receiver_count > 1)
+    {
+        struct timeval rtc_tv;
+        _rtcpps.getTime(&rtc_tv);
+        uint32_t active = _receiver_selector.update(observations, _holdover.getState() != Holdover::UNLOCKED,
+                                                    rtc_tv.tv_sec, _holdover.getErrorBound());
+        if (active != _active)
+        {
+            switchReceiver(active);
+        }
+        logReceivers();
+    }
+    return _validators[_active].isValid();
+}
+
+/**
+ * update the validator of a receiver and fill in its observation for the receiver
+ * selection.  The PPS second of a standby receiver is set from its RMC time here,
+ * the active one's in process().
+*/
+void SyncManager::validateReceiver(uint32_t index, bool window, ReceiverSelector::Observation* observationp)
+{
+    GPS&          gps       = *_receivers[index];
+    PPS&          pps       = *_receiver_pps[index];
+    GPSValidator& validator = _validators[index];
+
+    struct timeval tv;
+    pps.getTime(&tv);
+    if (index != _active && window && gps.getValid())
+    {
+        time_t gps_seconds = gps.getRMCTime();
+        if (gps_seconds != tv.tv_sec)
+        {
+            ESP_LOGW(TAG, "::validateReceiver: updating GPS %u PPS Time %ld -> %ld (%+ld seconds)",
+                          index+1, tv.tv_sec, gps_seconds, gps_seconds-tv.tv_sec);
+            pps.setTime(gps_seconds);
+            validator.ppsSet();
+            tv.tv_sec = gps_seconds;
+        }
+    }
+
+    pps_snapshot_t snap;
+    pps_snapshot_t rtc;
+    pps.snapshot(&snap);
+    _rtcpps.snapshot(&rtc);
+    GPSValidator::Evidence evidence;
+    evidence.rmc_valid      = gps.getValid();
+    evidence.rmc_time       = gps.getRMCTime();
+    evidence.zda_time       = gps.getZDATime();
+    evidence.pps_second     = tv.tv_sec;
+    evidence.pps_fresh      = snap.last != _validate_pps_last[index];
+    evidence.pps_interval   = (float)snap.interval / MicroSecondTimer::TICKS_PER_USEC;
+    evidence.fix_type       = gps.getFixType();
+    evidence.sats           = gps.getSatsTracked();
+    evidence.position_error = gps.getPositionError();
+    bool utc_valid;
+    evidence.utc            = !gps.getUTCStatus(&utc_valid) ? GPSValidator::UTC_UNKNOWN
+                            : utc_valid ? GPSValidator::UTC_VALID : GPSValidator::UTC_PENDING;
+    _validate_pps_last[index] = snap.last;
+
+    bool was_valid = validator.isValid();
+    const char* was_reason = validator.getReason();
+    bool valid = validator.update(evidence);
+    if (valid != was_valid || (!valid && validator.getReason() != was_reason))
+    {
+        ESP_LOGI(TAG, "::validateGPS: GPS %u %s: %s (%u/%u seconds) fix=%d sats=%d error=%0.1fm",
+                      index+1, valid ? "valid" : "not valid", validator.getReason(), validator.getConsistent(),
+                      validator.getRequired(), evidence.fix_type, evidence.sats, evidence.position_error);
+    }
+
+    observationp->valid     = valid;
+    observationp->pps_fresh = evidence.pps_fresh;
+    observationp->second    = tv.tv_sec;
+    observationp->phase     = (float)wrapOffset(snap.last - rtc.last) / MicroSecondTimer::TICKS_PER_USEC;
+}
+
+/**
+ * Make another receiver the reference.  The RTC PPS interpolation, the RTC setter
+ * and the edge wake follow it.  The PID integral and kalman frequency carry on so
+ * the output does not jump, the offsets measured against the old receiver are
+ * only dropped if the receivers disagreed.
+*/
+void SyncManager::switchReceiver(uint32_t index)
+{
+    PPS*     old      = _gpspps;
+    uint32_t previous = _active;
+    _active = index;
+    _gps    = _receivers[index];
+    _gpspps = _receiver_pps[index];
+    _rtcpps.setRef(_gpspps);
+    _rtc_setter.setReference(*_gpspps);
+    if (_apll != nullptr)
+    {
+        _apll->setReference(*_gpspps);
+    }
+#ifdef SYNC_EDGE_WAKE
+    if (_intr != nullptr)
+    {
+        old->setNotify(0);
+        _gpspps->setNotify(SYNC_SW_INTR_MASK);
+    }
+#else
+    (void)old;
+#endif
+
+    float difference = _receiver_selector.getDifference();
+    if (fabs(difference) > RECEIVER_MAX_PHASE)
+    {
+        clearOffset();
+    }
+    _edges.skip();
+    _gps_edge_valid      = false;
+    _rtc_edge_valid      = false;
+    _assert_offset_valid = false;
+    ESP_LOGW(TAG, "::switchReceiver: GPS %u -> GPS %u (%s) difference=%0.1fus (%u switches)",
+                  previous+1, index+1, _receiver_selector.getReason(), difference, _receiver_selector.getSwitches());
+}
+
+/**
+ * log the health of the receivers every RECEIVER_STATS_INTERVAL seconds
+*/
+void SyncManager::logReceivers()
+{
+    uint32_t now = getUptime();
+    if (now - _receiver_log_time < RECEIVER_STATS_INTERVAL)
+    {
+        return;
+    }
+    _receiver_log_time = now;
+    for (uint32_t i = 0; i < _receiver_count; ++i)
+    {
+        const ReceiverSelector::Health& h = _receiver_selector.getHealth(i);
+        ESP_LOGI(TAG, "::logReceivers: GPS %u%s %s valid %u/%us pps missing %u outvoted time %u phase %u active %us (%u times) phase=%0.1fus max difference=%0.1fus",
+                      i+1, i == _active ? "*" : "", _validators[i].getReason(), h.valid_seconds, h.seconds, h.pps_missing,
+                      h.time_mismatch, h.phase_outliers, h.active_seconds, h.activations, h.phase, h.max_difference);
+    }
+}
+
+uint32_t SyncManager::getValidDuration()
+{
+    return _gps->getValidDuration();
+}
+
+uint32_t SyncManager::getValidCount()
+{
+    return _gps->getValidCount();
+}
+
+int8_t SyncManager::getOutput()
+{
+    return _output;
+}
+
+/**
+ * return the filtered offset in microseconds.  0 is returnerd if the offset window is not full.
+*/
+float SyncManager::getOffset(int32_t* minp, int32_t* maxp)
+{
+    if (!_offsets.isFull())
+    {
+        return 0;
+    }
+
+    float offset = _offset_estimate / MicroSecondTimer::TICKS_PER_USEC;
+    if (minp != nullptr)
+    {
+        *minp = _offset_min / (int32_t)MicroSecondTimer::TICKS_PER_USEC;
+    }
+    if (maxp != nullptr)
+    {
+        *maxp = _offset_max / (int32_t)MicroSecondTimer::TICKS_PER_USEC;
+    }
+    return offset;
+}
+
+#ifdef SYNC_OFFSET_STATS
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_MCPWM)
+#define PPS_CAPTURE_NAME "mcpwm"
+#else
+#define PPS_CAPTURE_NAME "isr"
+#endif
+
+/**
+ * Benchmark of the offset noise, logs the mean and standard deviation of the raw
+ * offset samples in nanoseconds.  Comparing the 1MHz and 40MHz timer resolutions
+ * shows how much of the noise is timer quantisation, comparing ISR and MCPWM capture
+ * shows how much is interrupt latency (see also the PPS interval jitter).
+*/
+void SyncManager::recordOffsetStats(int32_t offset)
+{
+    double ns = MicroSecondTimer::ticksToNanos(offset);
+    _stats_sum    += ns;
+    _stats_sum_sq += ns*ns;
+    _stats_count  += 1;
+    if (_stats_count >= OFFSET_STATS_COUNT)
+    {
+        double mean = _stats_sum / _stats_count;
+        double var  = _stats_sum_sq / _stats_count - mean*mean;
+        ESP_LOGI(TAG, "::recordOffsetStats: %uHz timer %s capture n=%u mean=%0.1fns stddev=%0.1fns jitter gps=%0.1fns rtc=%0.1fns",
+                      MicroSecondTimer::TICKS_PER_SEC, PPS_CAPTURE_NAME, _stats_count, mean, sqrt(var > 0 ? var : 0),
+                      _gpspps->getJitter() * 1e9 / MicroSecondTimer::TICKS_PER_SEC, _rtcpps.getJitter() * 1e9 / MicroSecondTimer::TICKS_PER_SEC);
+        _stats_sum    = 0;
+        _stats_sum_sq = 0;
+        _stats_count  = 0;
+    }
+}
+#endif
+
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+/**
+ * the first receivers PPS is also captured by MCPWM, set before begin()
+*/
+void SyncManager::setCaptureBench(PPS* bench)
+{
+    _bench = bench;
+}
+
+/**
+ * Comparison of the ISR and MCPWM capture of the same GPS PPS edges.  The ISR time
+ * less the MCPWM time of each edge is the ISR latency (mean) and its variation
+ * (stddev, min, max), logged with the interval jitter each capture measures.
+*/
+void SyncManager::recordCaptureBench()
+{
+    pps_snapshot_t isr;
+    pps_snapshot_t mcpwm;
+    _receiver_pps[0]->snapshot(&isr);
+    _bench->snapshot(&mcpwm);
+    _bench->updateFrequency();
+    if (mcpwm.last == _bench_last)
+    {
+        return;
+    }
+    _bench_last = mcpwm.last;
+
+    int32_t delta = isr.last - mcpwm.last;
+    if (abs(delta) > (int32_t)CAPTURE_BENCH_MAX)
+    {
+        return;
+    }
+    if (_bench_count == 0 || delta < _bench_min)
+    {
+        _bench_min = delta;
+    }
+    if (_bench_count == 0 || delta > _bench_max)
+    {
+        _bench_max = delta;
+    }
+    double ns = MicroSecondTimer::ticksToNanos(delta);
+    _bench_sum    += ns;
+    _bench_sum_sq += ns*ns;
+    _bench_count  += 1;
+    if (_bench_count >= CAPTURE_BENCH_COUNT)
+    {
+        double mean = _bench_sum / _bench_count;
+        double var  = _bench_sum_sq / _bench_count - mean*mean;
+        ESP_LOGI(TAG, "::recordCaptureBench: %uHz timer n=%u isr-mcpwm mean=%0.1fns stddev=%0.1fns min=%lldns max=%lldns jitter isr=%0.1fns mcpwm=%0.1fns",
+                      MicroSecondTimer::TICKS_PER_SEC, _bench_count, mean, sqrt(var > 0 ? var : 0),
+                      (long long)MicroSecondTimer::ticksToNanos(_bench_min), (long long)MicroSecondTimer::ticksToNanos(_bench_max),
+                      _receiver_pps[0]->getJitter() * 1e9 / MicroSecondTimer::TICKS_PER_SEC,
+                      _bench->getJitter() * 1e9 / MicroSecondTimer::TICKS_PER_SEC);
+        _bench_sum    = 0;
+        _bench_sum_sq = 0;
+        _bench_count  = 0;
+    }
+}
+#endif
+
+void SyncManager::resetOffset()
+{
+    clearOffset();
+    // reset PID controler as its invalid when we set the or finish adjusting
+    _pid.resetIntegral();
+#ifdef SYNC_OFFSET_STATS
+    _control_start  = 0;
+    _settle_time    = 0;
+    _settle_count   = 0;
+    _control_sum_sq = 0;
+    _control_count  = 0;
+#endif
+}
+
+/**
+ * restart the offset measurement after a phase step or loss of GPS, the learned
+ * frequency (PID integral and kalman frequency) is kept.
+*/
+void SyncManager::clearOffset()
+{
+    _offsets.reset();
+    _clear_bias_valid = false;
+    _drift_start_time = 0;
+    _pid.clearError();
+    // the phase is no longer valid but the kalman filter keeps the learned frequency
+    _kalman.invalidate();
+    if (_tuner.isRunning())
+    {
+        _tuner.abort();
+        ESP_LOGW(TAG, "::resetOffset: PID tuning aborted");
+    }
+    if (_sweep.isRunning())
+    {
+        _sweep.abort();
+        ESP_LOGW(TAG, "::resetOffset: aging characterisation aborted");
+    }
+}
+
+#ifdef SYNC_OFFSET_STATS
+/**
+ * Benchmark of the control engine, logs the time it took to settle after a reset
+ * and the RMS error once settled.  Switching the engine at runtime resets this so
+ * PID and Kalman can be compared on the same RTC.
+*/
+void SyncManager::recordControlStats(float error)
+{
+    time_t now = time(nullptr);
+    if (_control_start == 0)
+    {
+        _control_start = now;
+    }
+
+    if (_settle_time == 0)
+    {
+        _settle_count = fabs(error) < SETTLE_ERROR ? _settle_count + 1 : 0;
+        if (_settle_count >= SETTLE_COUNT)
+        {
+            _settle_time = now - _control_start;
+            ESP_LOGI(TAG, "::recordControlStats: %s settled in %us", getEngineName(_engine), _settle_time);
+        }
+        return;
+    }
+
+    _control_sum_sq += error*error;
+    _control_count  += 1;
+    if (_control_count >= CONTROL_STATS_COUNT)
+    {
+        ESP_LOGI(TAG, "::recordControlStats: %s settle=%us n=%u rms=%0.3fus",
+                      getEngineName(_engine), _settle_time, _control_count, sqrt(_control_sum_sq / _control_count));
+        _control_sum_sq = 0;
+        _control_count  = 0;
+    }
+}
+#endif
+
+#ifdef SYNC_OFFSET_STATS
+/**
+ * Benchmark of the sync task itself, logs the wake ups per second and the share of
+ * the core spent in process() so polling and edge wake can be compared.
+*/
+void SyncManager::recordLoad(int64_t busy)
+{
+    int64_t now = esp_timer_get_time();
+    if (_load_start == 0)
+    {
+        _load_start = now;
+    }
+    _load_busy  += busy;
+    _load_wakes += 1;
+
+    int64_t elapsed = now - _load_start;
+    if (elapsed >= LOAD_STATS_INTERVAL*1000000LL)
+    {
+        ESP_LOGI(TAG, "::recordLoad: %s wakes=%0.1f/s busy=%0.3f%%", _intr != nullptr ? "edge" : "poll",
+                      _load_wakes * 1000000.0 / elapsed, _load_busy * 100.0 / elapsed);
+        _load_start = now;
+        _load_busy  = 0;
+        _load_wakes = 0;
+    }
+}
+#endif
+
+/**
+ * round and limit an output value and write it to the RTC aging register,
+ * returns true if the register was changed.
+*/
+bool SyncManager::setOutput(float output)
+{
+    output = round(output);
+    if (output > 127)
+    {
+        output = 127;
+    }
+    if (output < -127)
+    {
+        output = -127;
+    }
+
+    if (_rtc.getAgeOffset() == (int8_t)output)
+    {
+        return false;
+    }
+    _output = output;
+    _rtc.setAgeOffset((int8_t)output);
+    return true;
+}
+
+void SyncManager::manageDrift(float offset)
+{
+    time_t  now = time(nullptr); // we only need simple incrementing seconds
+
+    //
+    // if drift start time is 0 then we have no initial sample take it now
+    //
+    if (_drift_start_time == 0)
+    {
+        // only initialize on a non-zero offset
+        if (offset != 0)
+        {
+            _drift_start_time = now;
+        }
+        return;
+    }
+
+
+    uint32_t interval = now - _drift_start_time;
+    if (interval >= PID_INTERVAL)
+    {
+        if (_resume_pending)
+        {
+            _resume_pending = false;
+            ESP_LOGI(TAG, "::manageDrift: control loop resumed %lldms after reset", esp_timer_get_time() / 1000);
+        }
+        if (_tune_request)
+        {
+            _tune_request = false;
+            ESP_LOGI(TAG, "::manageDrift: starting PID tuning");
+            _tuner.start(_target, getFeedForward(), getUptime());
+        }
+        if (_sweep_request && !_tuner.isRunning())
+        {
+            _sweep_request = false;
+            ESP_LOGI(TAG, "::manageDrift: starting aging characterisation");
+            _sweep.start(getSteadyOutput(), offset, getUptime());
+        }
+
+        if (_tuner.isRunning())
+        {
+            manageTune(offset);
+        }
+        else if (_sweep.isRunning())
+        {
+            manageSweep(offset);
+        }
+        else if (_engine == ENGINE_KALMAN)
+        {
+            manageKalman();
+        }
+        else
+        {
+            managePID(offset);
+        }
+#ifdef SYNC_OFFSET_STATS
+        recordControlStats(_target - offset);
+#endif
+        _drift_start_time = now;
+    }
+}
+
+void SyncManager::managePID(float offset)
+{
+    float error = _target - (float)offset;
+    // limit the integral to affecting the frequency by INTEGRAL_LIMIT_PPM (64 LSB at
+    // the nominal gain).  Note that the integral is what builds up to compensate for
+    // any natural drift in the rtc, with a ds3231 (w/temperature controled oscillator)
+    // thats a max of 2ppm.  It is never more than the 127 we can adjust in either direction
+    float limit = INTEGRAL_LIMIT_PPM / getPlantGain();
+    if (limit > 127.0)
+    {
+        limit = 127.0;
+    }
+    float ff = getFeedForward();
+    float output = _pid.update(error, ff, limit);
+
+    if (setOutput(output))
+    {
+        int32_t min_offset;
+        int32_t max_offset;
+        getOffset(&min_offset, &max_offset);
+        ESP_LOGI(TAG, "::manageDrift: target=%0.1f offset=%0.1f/%d/%d error=%0.1f i=%0.1f d=%0.1f ff=%0.1f out=%d",
+                _target, offset, min_offset, max_offset, error, _pid.getIntegral(), _pid.getDerivative(), ff, _output);
+    }
+}
+
+/**
+ * PID tuning, the tuner drives the output until it is done and the resulting gains
+ * and bias are applied and saved to the config.
+*/
+void SyncManager::manageTune(float offset)
+{
+    PIDTuner::State state = _tuner.getState();
+    if (setOutput(_tuner.update(offset, getUptime())) || _tuner.getState() != state)
+    {
+        ESP_LOGI(TAG, "::manageTune: %s offset=%0.1f out=%d", PIDTuner::getStateName(_tuner.getState()), offset, _output);
+    }
+
+    switch (_tuner.getState())
+    {
+        case PIDTuner::DONE:
+            ESP_LOGI(TAG, "::manageTune: gain=%0.1fppb/LSB bias=%0.1f period=%0.1fs delay=%0.1fs ku=%0.2f",
+                          _tuner.getGain()*1000, _tuner.getBias(), _tuner.getPeriod(), _tuner.getDelay(), _tuner.getKu());
+            setGains(_tuner.getKp(), _tuner.getKi(), _tuner.getKd());
+            _bias           = _tuner.getBias();
+            _pid.reset();
+            // the bias is only used until the temperature model predicts, so teach it
+            // to the model at this temperature and hold any difference in the integral
+            if (_temperature_valid && _temp_model.add(_temperature, _bias))
+            {
+                _temp_model_dirty = true;
+            }
+            _pid.setIntegralOutput(_bias - getFeedForward());
+            _config.setKp(_pid.getKp());
+            _config.setKi(_pid.getKi());
+            _config.setKd(_pid.getKd());
+            _config.setBias(_bias);
+            if (!_config.save())
+            {
+                ESP_LOGE(TAG, "::manageTune: failed to save tuning");
+            }
+            break;
+
+        case PIDTuner::FAILED:
+            ESP_LOGE(TAG, "::manageTune: tuning failed: %s", _tuner.getReason());
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * aging characterisation, the sweep drives the output until it is done and the
+ * fitted gain is saved and used in place of the nominal gain.
+*/
+void SyncManager::manageSweep(float offset)
+{
+    uint32_t point = _sweep.getPoint();
+    float output = _sweep.update(offset, getUptime());
+    setOutput(output);
+    if (_sweep.getPoint() != point && _sweep.isRunning())
+    {
+        ESP_LOGI(TAG, "::manageSweep: point %u out=%d", _sweep.getPoint(), _output);
+    }
+
+    switch (_sweep.getState())
+    {
+        case AgingSweep::DONE:
+        {
+            _aging_cal = _sweep.getResult();
+            ESP_LOGI(TAG, "::manageSweep: gain=%0.1fppb/LSB curve=%0.3fppb/LSB^2 freq=%0.3fppm residual=%0.1fppb points=%u",
+                          _aging_cal.gain*1000, _aging_cal.curve*1000, _aging_cal.freq, _aging_cal.residual*1000, _aging_cal.points);
+            if (!_config.setBlob(AGING_CAL_KEY, &_aging_cal, sizeof(_aging_cal)))
+            {
+                ESP_LOGE(TAG, "::manageSweep: failed to save aging characterisation");
+            }
+            // continue from the aging value the fit says holds frequency, with the
+            // integral holding it over the feed-forward as it did before the sweep
+            float center = AgingSweep::getZero(_aging_cal);
+            center = center > 127 ? 127 : (center < -127 ? -127 : center);
+            _pid.setIntegralOutput(center - getFeedForward());
+            _pid.clearError();
+            setOutput(center);
+            break;
+        }
+
+        case AgingSweep::FAILED:
+            ESP_LOGE(TAG, "::manageSweep: characterisation failed: %s", _sweep.getReason());
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Kalman engine, the filter is fed the newest raw offset sample (the averaged offset
+ * is correlated from one second to the next) with the spread of the offset window
+ * as its measurement noise.  The output cancels the estimated RTC frequency error
+ * and pulls the estimated phase to the target over KALMAN_TAU seconds.
+*/
+void SyncManager::manageKalman()
+{
+    if (_offset_samples == _kalman_samples)
+    {
+        return;
+    }
+    _kalman_samples = _offset_samples;
+
+    int64_t now = esp_timer_get_time();
+    float   dt  = _kalman.isValid() ? (now - _kalman_time) / 1000000.0 : 0;
+    _kalman_time = now;
+
+    float    sample   = (float)_offsets.getLast() / MicroSecondTimer::TICKS_PER_USEC;
+    float    variance = _offsets.getVariance() / (MicroSecondTimer::TICKS_PER_USEC * MicroSecondTimer::TICKS_PER_USEC);
+    if (variance < KALMAN_VARIANCE_MIN)
+    {
+        variance = KALMAN_VARIANCE_MIN;
+    }
+
+    _kalman.setGain(getPlantGain());
+    if (!_kalman.update(sample, variance, _rtc.getAgeOffset(), dt))
+    {
+        ESP_LOGW(TAG, "::manageKalman: rejected offset %0.3f innovation %0.3f", sample, _kalman.getInnovation());
+        return;
+    }
+    _pid.setPreviousError(_target - _kalman.getPhase());
+
+    if (setOutput(_kalman.getControl(_target, KALMAN_TAU)))
+    {
+        ESP_LOGI(TAG, "::manageKalman: target=%0.1f sample=%0.1f r=%0.3f phase=%0.3f/%0.3f freq=%0.4f aging=%0.3g q=%0.2f out=%d",
+                _target, sample, variance, _kalman.getPhase(), _kalman.getPhaseStdDev(),
+                _kalman.getFrequency(), _kalman.getAging(), _kalman.getNoiseScale(), _output);
+    }
+}
+
+/**
+ * Sample the RTC temperature every TEMP_INTERVAL seconds.  While locked to GPS the
+ * settled aging value is learned against temperature (and the kalman frequency
+ * estimate is moved with the model as the temperature changes), without GPS the
+ * holdover applies the model to the frozen aging value.
+*/
+void SyncManager::updateTemperature(bool locked)
+{
+    time_t now = time(nullptr);
+    if (now - _temp_time < TEMP_INTERVAL)
+    {
+        return;
+    }
+    _temp_time = now;
+
+    float temp;
+    if (!_rtc.getTemperature(&temp))
+    {
+        return;
+    }
+    _temperature       = temp;
+    _temperature_valid = true;
+
+    if (!locked)
+    {
+        return;
+    }
+
+    if (isOffsetValid() && fabs(getError()) < TEMP_LEARN_ERROR && !_tuner.isRunning() && !_sweep.isRunning())
+    {
+        // the PID output is ff + Ki*I (+ the P and D terms which are transient), learn
+        // that settled total and move whatever the model now predicts out of the
+        // integral so the integral is counted once and the output does not step.
+        float ff = getFeedForward();
+        float settled = ff + _pid.getIntegralOutput();
+        if (_engine == ENGINE_KALMAN && _kalman.isValid())
+        {
+            settled = -_kalman.getFrequency() / getPlantGain();
+        }
+        _temp_model.add(temp, settled);
+        _temp_model_dirty = true;
+        if (_engine != ENGINE_KALMAN)
+        {
+            _pid.shiftOutput(getFeedForward() - ff);
+        }
+    }
+
+    float before;
+    float aging;
+    if (_engine == ENGINE_KALMAN && _kalman.isValid()
+        && _temp_model.predict(_ff_temperature, &before) && _temp_model.predict(temp, &aging))
+    {
+        _kalman.adjustFrequency(-(aging - before) * getPlantGain());
+    }
+    _ff_temperature = temp;
+}
+
+/**
+ * track the error bound while GPS disciplined, the first lock needs the error
+ * within HOLDOVER_LOCK_ERROR
+*/
+void SyncManager::updateLock(float offset)
+{
+    if (!isOffsetValid() || _holdover.isHolding())
+    {
+        return;
+    }
+    float error = fabs(_target - offset);
+    if (_holdover.getState() == Holdover::UNLOCKED)
+    {
+        if (error > HOLDOVER_LOCK_ERROR)
+        {
+            return;
+        }
+        ESP_LOGI(TAG, "::updateLock: locked error=%0.1fus after %us", error, getUptime());
+        _lock_time = getUptime();
+    }
+    int32_t min_offset;
+    int32_t max_offset;
+    getOffset(&min_offset, &max_offset);
+    _holdover.lock(error + (max_offset - min_offset) / 2.0);
+}
+
+/**
+ * uncertainty of the current frequency estimate in ppm, the configured value or
+ * the kalman estimate if larger.  driftp is set to the change of the steady state
+ * aging value in LSB/s from the kalman aging.
+*/
+float SyncManager::getFreqError(float* driftp)
+{
+    float freq_error = HOLDOVER_FREQ_ERROR;
+    *driftp = 0;
+    if (_engine == ENGINE_KALMAN && _kalman.isValid())
+    {
+        *driftp = -_kalman.getAging() / getPlantGain();
+        float sigma = HOLDOVER_SIGMA * _kalman.getFrequencyStdDev();
+        if (sigma > freq_error)
+        {
+            freq_error = sigma;
+        }
+    }
+    return freq_error;
+}
+
+/**
+ * the frequency uncertainty of the holdover in ppm, the uncertainty when it
+ * started plus the temperature change since.  deltap is set to the change of the
+ * aging value predicted by the temperature model.
+*/
+float SyncManager::getHoldoverFreqError(float* deltap)
+{
+    float freq_error = _holdover_freq_error;
+    *deltap = 0;
+    if (_temperature_valid && _holdover_temp_valid)
+    {
+        float coeff = HOLDOVER_TEMP_COEFF;
+        float before;
+        float after;
+        if (_temp_model.predict(_holdover_temp, &before) && _temp_model.predict(_temperature, &after))
+        {
+            *deltap = after - before;
+            coeff   = HOLDOVER_TEMP_MODEL_COEFF;
+        }
+        freq_error += fabs(_temperature - _holdover_temp) * coeff;
+    }
+    return freq_error;
+}
+
+/**
+ * Without GPS the steady state aging value is frozen (plus the kalman aging drift
+ * and the temperature model) and dithered so its average is not limited to whole
+ * LSBs.  When GPS comes back the PID integral and kalman frequency carry on from
+ * the held values.
+*/
+void SyncManager::manageHoldover(bool valid)
+{
+    uint32_t now = getUptime();
+    float    delta;
+
+    if (valid)
+    {
+        if (_holdover.getState() == Holdover::HOLDOVER)
+        {
+            uint32_t elapsed = _holdover.getElapsed(now);
+            _holdover.reacquire();
+            if (_engine == ENGINE_KALMAN)
+            {
+                _kalman.adjustFrequency(_kalman.getAging() * elapsed);
+            }
+            ESP_LOGI(TAG, "::manageHoldover: GPS back after %us, predicted bound %0.1fus", elapsed, _holdover.getErrorBound());
+        }
+        _holdover.update(now, getHoldoverFreqError(&delta));
+        return;
+    }
+
+    if (!_holdover.isHolding() || _holdover.getState() == Holdover::REACQUIRE)
+    {
+        bool  started    = !_holdover.isHolding();
+        float output     = getSteadyOutput();
+        float drift      = 0;
+        if (started)
+        {
+            _holdover_freq_error = getFreqError(&drift);
+            _holdover_temp       = _temperature;
+            _holdover_temp_valid = _temperature_valid;
+            _holdover_dither     = 0;
+        }
+        if (!_holdover.enter(now, output, drift, getHoldoverFreqError(&delta)))
+        {
+            return;
+        }
+        if (_tuner.isRunning())
+        {
+            _tuner.abort();
+        }
+        if (_sweep.isRunning())
+        {
+            _sweep.abort();
+        }
+        ESP_LOGW(TAG, "::manageHoldover: GPS lost, %s out=%0.2f drift=%0.3g freq error=%0.3fppm bound=%0.1fus",
+                      started ? "holding" : "holding again", _holdover.getOutput(now), drift,
+                      _holdover_freq_error, _holdover.getErrorBound());
+    }
+
+    if (now == _holdover_time)
+    {
+        return;
+    }
+    _holdover_time = now;
+
+    float freq_error = getHoldoverFreqError(&delta);
+    _holdover.update(now, freq_error);
+
+    // with a peer as the reference steer out its offset, a positive offset is
+    // the local clock behind which needs a lower aging value
+    float steer = 0;
+    if (_reference == SourceSelector::PEER)
+    {
+        steer = -(_peer_offset / PEER_TAU) / getPlantGain();
+        if (steer > PEER_STEER_MAX)
+        {
+            steer = PEER_STEER_MAX;
+        }
+        else if (steer < -PEER_STEER_MAX)
+        {
+            steer = -PEER_STEER_MAX;
+        }
+    }
+
+    // first order sigma delta, the average of the whole LSB outputs is the held value
+    _holdover_dither += _holdover.getOutput(now) + delta + steer;
+    float output = round(_holdover_dither);
+    _holdover_dither -= output;
+    setOutput(output);
 }
 
-float SyncManager::getError()
+/**
+ * the first measurement after GPS came back gives the actual holdover error,
+ * called late in the second when the RTC and GPS seconds can be compared.
+*/
+void SyncManager::measureHoldover(const struct timeval& gps_tv, const struct timeval& rtc_tv, float offset)
 {
-    return _target - (float)getOffset();
-}
+    if (_holdover.getState() != Holdover::REACQUIRE)
+    {
+        return;
+    }
+    int32_t seconds = rtc_tv.tv_sec - gps_tv.tv_sec;
+    if (!isOffsetValid() && seconds == 0)
+    {
+        return;
+    }
 
-float SyncManager::getPreviousError()
-{
-    return _previous_error;
+    // a positive offset is the RTC edge after the GPS edge, the RTC is behind
+    float error = seconds * 1000000.0 - (isOffsetValid() ? offset - _target : 0);
+    float bound = _holdover.getErrorBound();
+    uint32_t duration = _holdover.getElapsed(getUptime());
+    _holdover.measure(error);
+    _lock_time = getUptime();
+    ESP_LOGI(TAG, "::measureHoldover: %us holdover error=%0.1fus bound=%0.1fus (%u holdovers, %u over bound, worst %0.2f of bound)",
+                  duration, error, bound, _holdover.getCount(), _holdover.getViolations(), _holdover.getWorstRatio());
 }
 
-float SyncManager::getIntegral()
+/**
+ * publish the error bound, stratum, reference id and root delay for NTP.  With a
+ * peer as the reference the bound is the measured peer offset plus its bound if
+ * that is better than the holdover prediction, and the stratum one below the peer.
+*/
+void SyncManager::publishBound()
 {
-    return _integral;
+    float    bound      = _holdover.getErrorBound();
+    bool     locked     = _holdover.getState() != Holdover::UNLOCKED;
+    uint8_t  stratum    = 1;
+    uint32_t ref_id;
+    float    root_delay = 0;
+    memcpy(&ref_id, GPS_REF_ID, sizeof(ref_id));
+    if (_reference == SourceSelector::PEER)
+    {
+        float peer_bound = fabs(_peer_offset) + _peer_bound;
+        if (!locked || peer_bound < bound)
+        {
+            bound = peer_bound;
+        }
+        locked     = true;
+        stratum    = _peer_stratum + 1;
+        ref_id     = _peer_addr;
+        root_delay = _peer_root_delay;
+    }
+    stratum = Holdover::getStratum(locked, bound, stratum, HOLDOVER_STRATUM_BOUND, HOLDOVER_MAX_BOUND);
+    if (stratum != _stratum)
+    {
+        ESP_LOGI(TAG, "::publishBound: stratum %u -> %u bound=%0.1fus", _stratum, stratum, bound);
+    }
+    _error_bound = bound;
+    _stratum     = stratum;
+    _ref_id      = ref_id;
+    _root_delay  = root_delay;
 }
 
-uint32_t SyncManager::getUptime()
+/**
+ * add the fresh samples of the NTP peers to the selection
+*/
+void SyncManager::addPeers(uint32_t now)
 {
-    return (esp_timer_get_time() / 1000000);
+    if (_peers == nullptr)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < _peers->getCount(); ++i)
+    {
+        PeerClient::Peer peer;
+        if (!_peers->getPeer(i, &peer) || !peer.valid || now - peer.time > PEER_MAX_AGE || peer.stratum >= 15)
+        {
+            continue;
+        }
+        SourceSelector::Candidate candidate;
+        candidate.type    = SourceSelector::PEER;
+        candidate.id      = peer.addr;
+        candidate.stratum = peer.stratum;
+        candidate.offset  = peer.offset;
+        candidate.bound   = (peer.delay + peer.root_delay) / 2.0 + peer.root_dispersion + PEER_DRIFT * (now - peer.time);
+        _selector.add(candidate);
+    }
 }
 
-void SyncManager::recordOffset()
+/**
+ * Once a second select the reference from the GPS PPS, the RTC and the NTP peers.
+ * The RTC is a candidate at no offset with the error bound carried from the last
+ * second (or the holdover prediction), so it must be called before updateLock().
+ * Returns false while the GPS is rejected as a falseticker.
+*/
+bool SyncManager::selectSource(bool gps_valid, float offset)
 {
-    static time_t last_rtc = 0;
-    static time_t last_gps = 0;
-    time_t rtc_time = _rtcpps.getTime(nullptr);
-    time_t gps_time = _gpspps.getTime(nullptr);
-
-    // we want a change in both second counters before we take a new sample
-    if (gps_time == last_gps || rtc_time == last_rtc)
+    uint32_t now = getUptime();
+    if (now == _source_time)
     {
-        return;
+        return !_gps_falseticker;
     }
+    _source_time = now;
 
-    last_rtc = rtc_time;
-    last_gps = gps_time;
-
-    _offset_data[_offset_index++] = _rtcpps.getOffset();
+    _selector.clear();
+    SourceSelector::Candidate candidate;
+    candidate.id      = 0;
+    candidate.stratum = 0;
+    if (gps_valid && isOffsetValid())
+    {
+        int32_t min_offset;
+        int32_t max_offset;
+        getOffset(&min_offset, &max_offset);
+        candidate.type   = SourceSelector::GPS;
+        candidate.offset = offset - _target;
+        candidate.bound  = (max_offset - min_offset) / 2.0 + SOURCE_GPS_BOUND;
+        _selector.add(candidate);
+    }
+    if (_holdover.getState() != Holdover::UNLOCKED)
+    {
+        candidate.type   = SourceSelector::RTC;
+        candidate.offset = 0;
+        candidate.bound  = _holdover.getErrorBound();
+        _selector.add(candidate);
+    }
+    addPeers(now);
+    _selector.select();
 
-    if (_offset_index >= OFFSET_DATA_SIZE)
+    int gps = _selector.find(SourceSelector::GPS);
+    if (gps >= 0 && !_selector.isTruechimer(gps))
+    {
+        _gps_true_count = 0;
+        if (!_gps_falseticker && ++_gps_false_count >= SOURCE_REJECT)
+        {
+            _gps_falseticker = true;
+            ESP_LOGW(TAG, "::selectSource: GPS rejected, offset %0.1fus is outside the other %u sources",
+                          _selector.getCandidate(gps).offset, _selector.getCount()-1);
+        }
+    }
+    else if (gps >= 0)
     {
-        _offset_index = 0;
+        _gps_false_count = 0;
+        if (_gps_falseticker && ++_gps_true_count >= SOURCE_ACCEPT)
+        {
+            _gps_falseticker = false;
+            ESP_LOGI(TAG, "::selectSource: GPS accepted again, offset %0.1fus", _selector.getCandidate(gps).offset);
+        }
     }
 
-    if (_offset_count < OFFSET_DATA_SIZE)
+    // the GPS when usable, otherwise the best peer if it beats the holdover prediction
+    SourceSelector::Type reference = SourceSelector::RTC;
+    int peer = -1;
+    if (gps_valid && !_gps_falseticker)
+    {
+        reference = SourceSelector::GPS;
+    }
+    else
     {
-        _offset_count += 1;
+        for (uint32_t i = 0; i < _selector.getCount(); ++i)
+        {
+            const SourceSelector::Candidate& c = _selector.getCandidate(i);
+            if (c.type == SourceSelector::PEER && _selector.isTruechimer(i)
+                && (peer < 0 || c.bound < _selector.getCandidate(peer).bound))
+            {
+                peer = i;
+            }
+        }
+        if (peer >= 0 && (_holdover.getState() == Holdover::UNLOCKED
+                          || fabs(_selector.getCandidate(peer).offset) + _selector.getCandidate(peer).bound < _holdover.getErrorBound()))
+        {
+            reference = SourceSelector::PEER;
+        }
     }
 
-    uint32_t gps_interval = _gpspps.getTimerInterval();
-    uint32_t rtc_interval = _rtcpps.getTimerInterval();
-    if (rtc_interval < 999950 || rtc_interval > 1000050)
+    uint32_t peer_addr = 0;
+    if (reference == SourceSelector::PEER)
     {
-        ESP_LOGW(TAG, "::recordOffset: RTC interval out of range: %u", rtc_interval);
+        const SourceSelector::Candidate& c = _selector.getCandidate(peer);
+        PeerClient::Peer p;
+        peer_addr        = c.id;
+        _peer_stratum    = c.stratum;
+        _peer_offset     = c.offset;
+        _peer_bound      = c.bound;
+        for (uint32_t i = 0; i < _peers->getCount(); ++i)
+        {
+            if (_peers->getPeer(i, &p) && p.addr == c.id)
+            {
+                _peer_root_delay = p.root_delay + p.delay;
+                break;
+            }
+        }
     }
-    if (gps_interval < 999950 || gps_interval > 1000050)
+
+    if (reference != _reference || peer_addr != _peer_addr)
     {
-        ESP_LOGW(TAG, "::recordOffset: GPS interval out of range: %u", gps_interval);
+        _reference_switches += 1;
+        ESP_LOGW(TAG, "::selectSource: reference %s -> %s offset=%0.1fus bound=%0.1fus %u sources %u falsetickers (%u switches)",
+                      SourceSelector::getTypeName(_reference), SourceSelector::getTypeName(reference),
+                      reference == SourceSelector::PEER ? _peer_offset : 0.0, reference == SourceSelector::PEER ? _peer_bound : _holdover.getErrorBound(),
+                      _selector.getCount(), _selector.getFalsetickers(), _reference_switches);
     }
+    _reference    = reference;
+    _peer_addr    = peer_addr;
+    _source_count = _selector.getCount();
+    _falsetickers = _selector.getFalsetickers();
+    return !_gps_falseticker;
 }
 
-bool SyncManager::isOffsetValid()
+/**
+ * save the discipline state while locked and settled, writes are coalesced to
+ * spare the flash (see CHECKPOINT_INTERVAL).
+*/
+void SyncManager::checkpoint()
 {
-    return _offset_count == OFFSET_DATA_SIZE;
-}
+    if (_holdover.getState() != Holdover::LOCKED || !isOffsetValid() || fabs(getError()) > TEMP_LEARN_ERROR
+        || _tuner.isRunning() || _sweep.isRunning())
+    {
+        return;
+    }
+    uint32_t now = getUptime();
+    if (now - _lock_time < CHECKPOINT_FIRST || (_checkpoint_time != 0 && now - _checkpoint_time < CHECKPOINT_INTERVAL))
+    {
+        return;
+    }
+    _checkpoint_time = now;
 
-float SyncManager::getBias()
-{
-    return _bias;
-}
+    struct timeval tv;
+    _rtcpps.getTime(&tv);
+    float drift;
+    Checkpoint cp;
+    memset(&cp, 0, sizeof(cp));
+    cp.version     = CHECKPOINT_VERSION;
+    cp.engine      = _engine;
+    cp.time        = tv.tv_sec;
+    cp.output      = getSteadyOutput();
+    cp.integral    = _pid.getIntegralOutput();
+    cp.frequency   = _kalman.getFrequency();
+    cp.aging       = _kalman.getAging();
+    cp.freq_error  = getFreqError(&drift);
+    cp.temperature = _temperature;
+    cp.bound       = _holdover.getErrorBound();
 
-void SyncManager::setBias(float bias)
-{
-    ESP_LOGI(TAG, "setBias: %0f", bias);
-    _bias = bias;
-    resetOffset();
-}
+    bool moved = !_checkpoint_valid
+                 || cp.engine != _checkpoint.engine
+                 || fabs(cp.output - _checkpoint.output) >= CHECKPOINT_OUTPUT
+                 || fabs(cp.temperature - _checkpoint.temperature) >= CHECKPOINT_TEMP
+                 || cp.time - _checkpoint.time >= CHECKPOINT_REFRESH;
+    if (moved)
+    {
+        if (_config.setBlob(CHECKPOINT_KEY, &cp, sizeof(cp)))
+        {
+            _checkpoint       = cp;
+            _checkpoint_valid = true;
+            _checkpoint_writes += 1;
+            ESP_LOGI(TAG, "::checkpoint: saved out=%0.2f freq=%0.4fppm temp=%0.2f bound=%0.1fus (%u writes)",
+                          cp.output, cp.frequency, cp.temperature, cp.bound, _checkpoint_writes);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "::checkpoint: failed to save clock state");
+        }
+    }
 
-float SyncManager::getTarget()
-{
-    return _target;
+    if (_temp_model_dirty)
+    {
+        const TempModel::Data& data = _temp_model.getData();
+        if (_config.setBlob(TEMP_MODEL_KEY, &data, sizeof(data)))
+        {
+            ESP_LOGI(TAG, "::checkpoint: saved temperature model with %u bins", _temp_model.getBins());
+            _temp_model_dirty = false;
+        }
+    }
 }
 
-void SyncManager::setTarget(float target)
+/**
+ * Restore the saved discipline state at startup.  The learned frequency is used if
+ * the checkpoint is sane and for the same engine.  If the RTC kept time since then
+ * (its oscillator did not stop and the checkpoint is not too old) the RTC time is
+ * also trusted and we start in holdover with the bound grown over the time we were
+ * off, so NTP can serve right away and GPS is reacquired without a reset.
+*/
+void SyncManager::restoreCheckpoint()
 {
-    ESP_LOGI(TAG, "setTarget: %0f", target);
-    _target = target;
-    resetOffset();
-}
+    Checkpoint cp;
+    if (!_config.getBlob(CHECKPOINT_KEY, &cp, sizeof(cp)) || cp.version != CHECKPOINT_VERSION)
+    {
+        return;
+    }
+    if (!isfinite(cp.output) || fabs(cp.output) > 127 || !isfinite(cp.frequency) || !isfinite(cp.bound))
+    {
+        ESP_LOGW(TAG, "::restoreCheckpoint: ignoring invalid checkpoint");
+        return;
+    }
+    _checkpoint       = cp;
+    _checkpoint_valid = true;
 
-bool SyncManager::isValid()
-{
-    return _gps.getValid();
-}
+    struct timeval tv;
+    _rtcpps.getTime(&tv);
+    int32_t age = tv.tv_sec - cp.time;
+    if (age > CHECKPOINT_MAX_AGE)
+    {
+        ESP_LOGW(TAG, "::restoreCheckpoint: checkpoint is %d days old, ignored", age / 86400);
+        return;
+    }
+    bool trusted = !_rtc.getOscillatorStopped() && age >= 0;
 
-uint32_t SyncManager::getValidDuration()
-{
-    return _gps.getValidDuration();
-}
+    if (cp.engine == _engine && _engine == ENGINE_KALMAN)
+    {
+        _kalman.reset(0, cp.frequency + (trusted ? cp.aging * age : 0));
+        _kalman.invalidate();
+        _ff_temperature = cp.temperature;
+    }
+    else if (cp.engine == _engine)
+    {
+        _pid.setIntegralOutput(cp.integral);
+    }
 
-uint32_t SyncManager::getValidCount()
-{
-    return _gps.getValidCount();
-}
+    if (!trusted)
+    {
+        setOutput(cp.output);
+        ESP_LOGW(TAG, "::restoreCheckpoint: restored out=%0.2f, RTC time not trusted (age %ds%s)",
+                      cp.output, age, _rtc.getOscillatorStopped() ? " oscillator stopped" : "");
+        return;
+    }
 
-int8_t SyncManager::getOutput()
-{
-    return _output;
+    // the RTC ran at the saved aging value while we were off at an unknown temperature
+    float drift = 0;
+    if (cp.engine == ENGINE_KALMAN)
+    {
+        drift = -cp.aging / getPlantGain();
+    }
+    float freq_error = cp.freq_error;
+    float temp;
+    if (_rtc.getTemperature(&temp))
+    {
+        _temperature       = temp;
+        _temperature_valid = true;
+        freq_error += fabs(temp - cp.temperature) * HOLDOVER_TEMP_COEFF;
+    }
+    float bound = cp.bound + freq_error * age + 0.5 * HOLDOVER_AGING_RATE * (float)age * (float)age;
+
+    _holdover_freq_error = cp.freq_error;
+    _holdover_temp       = cp.temperature;
+    _holdover_temp_valid = true;
+    _holdover_dither     = 0;
+    _holdover.resume(getUptime(), cp.output + drift * age, drift, bound);
+    setOutput(_holdover.getOutput(getUptime()));
+    publishBound();
+    ESP_LOGI(TAG, "::restoreCheckpoint: %s age=%ds out=%0.2f integral=%0.2f freq=%0.4fppm bound=%0.1fus",
+                  getEngineName((Engine)cp.engine), age, cp.output, cp.integral, cp.frequency, bound);
 }
 
 /**
- * return the average offset.  0 is returnerd if the offset data is not full.
+ * Pick up from the resume block after a soft reset: the controller state, the lock
+ * or holdover state and bound, the GPS validity history and, when locked, the
+ * offset window so the control loop runs again within a couple of seconds.
 */
-float SyncManager::getOffset(int32_t* minp, int32_t* maxp)
+bool SyncManager::resume()
 {
-    if (_offset_count < OFFSET_DATA_SIZE)
+    if (!_resume.begin())
     {
-        return 0;
+        return false;
     }
+    const ResumeData& data = _resume.getData();
 
-    float total        = _offset_data[0];
-    int32_t min_offset = _offset_data[0];
-    int32_t max_offset = _offset_data[0];
+    struct timeval tv;
+    _rtcpps.getTime(&tv);
+    int32_t age = tv.tv_sec - data.rtc_seconds;
+    if (age < 0 || age > RESUME_MAX_AGE || data.engine != _engine)
+    {
+        ESP_LOGW(TAG, "::resume: not resuming, age=%ds engine=%s", age, getEngineName((Engine)data.engine));
+        _resume.invalidate();
+        return false;
+    }
 
-    for(uint32_t i = 1; i < _offset_count; ++i)
+    if (data.gps_validated)
     {
-        total += _offset_data[i];
-        if (_offset_data[i] < min_offset)
-        {
-            min_offset = _offset_data[i];
-        }
-        if (_offset_data[i] > max_offset)
-        {
-            max_offset = _offset_data[i];
-        }
+        _validators[_active].setValidated();
     }
-    // throw out the min and max values
-    total -= min_offset;
-    total -= max_offset;
-    float offset = total / ((float)OFFSET_DATA_SIZE-2);
-    if (minp != nullptr)
+    _clear_bias       = data.clear_bias;
+    _clear_bias_valid = true;
+    if (_engine == ENGINE_KALMAN)
     {
-        *minp = min_offset;
+        _kalman.reset(0, data.frequency);
+        _kalman.invalidate();
     }
-    if (maxp != nullptr)
+    else
     {
-        *maxp = max_offset;
+        _pid.setIntegralOutput(data.integral);
+    }
+    if (_rtc.getAgeOffset() == data.output)
+    {
+        _output = data.output;
     }
-    return offset;
-}
 
-void SyncManager::resetOffset()
-{
-    _offset_index = 0;
-    _offset_count = 0;
-    // reset PID controler as its invalid when we set the or finish adjusting
-    _drift_start_time = 0;
-    _integral = 0;
-    _previous_error = 0;
+    switch ((Holdover::State)data.holdover_state)
+    {
+        case Holdover::LOCKED:
+            _holdover.lock(data.bound);
+            _lock_time = getUptime();
+            for (uint32_t i = 0; i < data.offset_count && i < ResumeData::MAX_OFFSETS; ++i)
+            {
+                _offsets.add(data.offsets[i]);
+                _offset_samples += 1;
+            }
+            _offset_estimate = _offsets.getEstimate();
+            _offset_min      = _offsets.getMin();
+            _offset_max      = _offsets.getMax();
+            // locked the GPS and RTC edges are microseconds apart and we are just past
+            // the RTC second, the RMC check corrects this if not.
+            _gpspps->setTime(tv.tv_sec);
+            break;
+
+        case Holdover::HOLDOVER:
+        case Holdover::REACQUIRE:
+            _holdover_freq_error = data.holdover_freq_error;
+            _holdover_temp       = data.holdover_temp;
+            _holdover_temp_valid = true;
+            _holdover_dither     = 0;
+            _holdover.resume(getUptime(), data.holdover_output, data.holdover_drift,
+                             data.bound + data.holdover_freq_error * age);
+            break;
+
+        case Holdover::UNLOCKED:
+            break;
+    }
+    publishBound();
+    _resume_pending = true;
+    ESP_LOGI(TAG, "::resume: %s %s age=%ds offsets=%u bound=%0.1fus gps %s",
+                  getEngineName(_engine), Holdover::getStateName(_holdover.getState()), age,
+                  _offsets.getCount(), _holdover.getErrorBound(), data.gps_validated ? "validated" : "not validated");
+    return true;
 }
 
-void SyncManager::manageDrift(float offset)
+/**
+ * save the resume block once a second
+*/
+void SyncManager::saveResume()
 {
-    time_t  now = time(nullptr); // we only need simple incrementing seconds
-
-    //
-    // if drift start time is 0 then we have no initial sample take it now
-    //
-    if (_drift_start_time == 0)
+    uint32_t now = getUptime();
+    if (now == _resume_time)
     {
-        // only initialize on a non-zero offset
-        if (offset != 0)
-        {
-            _drift_start_time = now;
-        }
         return;
     }
+    _resume_time = now;
+    if (!_resume_stable && now >= RESUME_STABLE)
+    {
+        _resume.markStable();
+        _resume_stable = true;
+    }
 
+    struct timeval tv;
+    _rtcpps.getTime(&tv);
+    ResumeData data;
+    memset(&data, 0, sizeof(data));
+    data.rtc_seconds         = tv.tv_sec;
+    data.engine              = _engine;
+    data.holdover_state      = _holdover.getState();
+    data.gps_validated       = _validators[_active].isValidated();
+    data.output              = _output;
+    data.integral            = _pid.getIntegralOutput();
+    data.frequency           = _kalman.getFrequency();
+    data.bound               = _holdover.getErrorBound();
+    data.holdover_output     = _holdover.getOutput(now);
+    data.holdover_drift      = _holdover.getDrift();
+    data.holdover_freq_error = _holdover_freq_error;
+    data.holdover_temp       = _holdover_temp;
+    data.clear_bias          = _clear_bias;
+    uint32_t count = _offsets.getCount();
+    if (count > ResumeData::MAX_OFFSETS)
+    {
+        count = ResumeData::MAX_OFFSETS;
+    }
+    data.offset_count = count;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        data.offsets[i] = _offsets.getSample(count - 1 - i);
+    }
+    _resume.save(data);
+}
 
-    uint32_t interval = now - _drift_start_time;
-    if (interval >= PID_INTERVAL)
+void SyncManager::process()
+{
+    // the RTC is not touched while a set is pending, once done restart from the new time
+    switch (_rtc_setter.finish())
     {
-        float error = _target - (float)offset;
-        _integral += error;
-        // limit the integral to affecting the output by 64 max (thats about 6-7 PPM)
-        // Note that the integral is what builds up to compensate for any natural drift
-        // in the rtc, with a ds3231 (w/temperature controled oscillator) thats a max
-        // of 2ppm.  Also 64 is half the max we can adjust in either direction
-        if ((_integral*_Ki) > 64.0)
-        {
-            _integral = 64.0/_Ki;
-        }
-        else if ((_integral*_Ki) < -64.0)
-        {
-            _integral = -64.0/_Ki;
-        }
-        float derivative = error - _previous_error;
-        _previous_error = error;
-        float output = _Kp*error + _Ki*_integral + _Kd*derivative + _bias;
-        output = round(output);
-        if (output > 127)
-        {
-            output = 127;
-        }
-        if (output < -127)
-        {
-            output = -127;
-        }
+        case RTCSetter::PENDING:
+            return;
 
-        int32_t min_offset = _offset_data[0];
-        int32_t max_offset = _offset_data[0];
-        for (size_t i = 1; i < OFFSET_DATA_SIZE; ++i)
+        case RTCSetter::DONE:
         {
-            if (_offset_data[i] > max_offset)
-            {
-                max_offset = _offset_data[i];
-            }
-            if (_offset_data[i] < min_offset)
-            {
-                min_offset = _offset_data[i];
-            }
-
+            struct timeval tv;
+            _rtcpps.getTime(&tv);
+            settimeofday(&tv, nullptr);
+            clearOffset();
+            _edges.skip();
+            _gps_edge_valid      = false;
+            _rtc_edge_valid      = false;
+            _assert_offset_valid = false;
+            _rtc_check           = true;
+            _rtc_delta           = 0;
+            _rtc_set_calibrate   = true;
+            ESP_LOGW(TAG, "time correction happened!");
+            break;
         }
 
-        if (_rtc.getAgeOffset() != (int8_t)output)
-        {
-            _output = output;
-            _rtc.setAgeOffset((int8_t)output);
-            ESP_LOGI(TAG, "::manageDrift: target=%0.1f offset=%0.1f/%d/%d error=%0.1f i=%0.1f d=%0.1f bias=%0.1f out=%d",
-                    _target, offset, min_offset, max_offset, error, _integral, derivative, _bias, (int8_t)output);
-        }
+        case RTCSetter::FAILED:
+            ESP_LOGW(TAG, "time correction failed, will retry");
+            break;
 
-        _drift_start_time = now;
+        case RTCSetter::IDLE:
+            break;
     }
-}
 
-void SyncManager::process()
-{
     // update value of RTC display (we are the only thread allowed to talk in i2c)
-    struct tm tm;
-    _rtc.getTime(&tm);
-    _rtc_time = mktime(&tm);
+    updateRTCTime();
+    saveResume();
+
+#ifdef PPS_MODEL_CHECK
+    _model_check.process();
+#endif
+
+    // track the local oscillator against the GPS and RTC PPS signals for interpolation
+    for (uint32_t i = 0; i < _receiver_count; ++i)
+    {
+        _receiver_pps[i]->updateFrequency();
+    }
+    _rtcpps.updateFrequency();
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+    if (_bench != nullptr)
+    {
+        recordCaptureBench();
+    }
+#endif
+
+    // if the GPS is not valid then hold over, restart the offset and return
+    if (!validateGPS())
+    {
+        selectSource(false, 0);
+        updateTemperature(false);
+        manageHoldover(false);
+        clearOffset();
+        _edges.skip();
+        _gps_edge_valid      = false;
+        _rtc_edge_valid      = false;
+        _assert_offset_valid = false;
+        publishBound();
+        return;
+    }
 
-    // if the GPS is not valid then reset the offset and return
-    if (!_gps.getValid())
+    // offsets against a GPS top of second that is being moved are not used, the
+    // learned frequency carries the RTC like a short holdover
+    if (alignTimepulse())
     {
-        resetOffset();
+        clearOffset();
+        _edges.skip();
+        _gps_edge_valid      = false;
+        _rtc_edge_valid      = false;
+        _assert_offset_valid = false;
+        updateTemperature(false);
+        manageHoldover(false);
+        publishBound();
         return;
     }
 
     recordOffset();
     float offset = getOffset();
 
+    // a GPS the other sources disagree with is held over like a lost one, its
+    // offset is still measured so it can be accepted again
+    if (!selectSource(true, offset))
+    {
+        updateTemperature(false);
+        manageHoldover(false);
+        publishBound();
+        return;
+    }
+
+    manageHoldover(true);
+    updateTemperature(true);
+    updateLock(offset);
+    publishBound();
+    checkpoint();
+
     struct timeval gps_tv;
     struct timeval rtc_tv;
-    _gpspps.getTime(&gps_tv);
+    _gpspps->getTime(&gps_tv);
     _rtcpps.getTime(&rtc_tv);
  
     uint32_t interval = gps_tv.tv_sec - _last_time;
 
     // ~10 sec but only if GPS is valid and not too close to the start or end of a second!
-    if (gps_tv.tv_usec > 800000
-        && gps_tv.tv_usec < 900000
+    if (gps_tv.tv_usec > GPS_CHECK_MIN
+        && gps_tv.tv_usec < GPS_CHECK_MAX
         && interval > 10)
     {
         // since we are almost at teh end of a second the gps message for the current sencond should have arrived
         // and we can compare it with the gps_pps second counter and update the counter if different.
-        time_t gps_seconds = _gps.getRMCTime();
+        time_t gps_seconds = _gps->getRMCTime();
         if (gps_seconds != gps_tv.tv_sec)
         {
             ESP_LOGW(TAG, "updating GPS PPS Time PPS %ld -> %ld (%+ld seconds)",
                           gps_tv.tv_sec, gps_seconds, gps_seconds-gps_tv.tv_sec);
-            _gpspps.setTime(gps_seconds);
+            _gpspps->setTime(gps_seconds);
+            _validators[_active].ppsSet();
             gps_tv.tv_sec = gps_seconds;
         }
         ESP_LOGV(TAG, "pps offset %0.3f", offset);
         _last_time = gps_tv.tv_sec;
+        measureHoldover(gps_tv, rtc_tv, offset);
 
         if (abs(offset) > RTC_DRIFT_MAX || gps_tv.tv_sec != rtc_tv.tv_sec)
         {
-            setTime(offset);
-            ESP_LOGW(TAG, "time correction happened!  PPS offset=%0.3fus gps_time=%ld rtc_time=%ld (%+ld seconds)",
-                          offset, gps_tv.tv_sec, rtc_tv.tv_sec, gps_tv.tv_sec-rtc_tv.tv_sec);
-            struct timeval tv;
-            _rtcpps.getTime(&tv);
-            settimeofday(&tv, nullptr);
-            resetOffset();
+            if (_rtc_setter.schedule())
+            {
+                ESP_LOGW(TAG, "time correction scheduled!  PPS offset=%0.3fus gps_time=%ld rtc_time=%ld (%+ld seconds)",
+                              offset, gps_tv.tv_sec, rtc_tv.tv_sec, gps_tv.tv_sec-rtc_tv.tv_sec);
+            }
         }
         return;
     }
@@ -378,53 +2519,19 @@ void SyncManager::task(void* data)
     SyncManager* syncman = static_cast<SyncManager*>(data);
     //we dont start for a few seconds so that times can be set and initial seconds and offsets are computed
 
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    vTaskDelay(pdMS_TO_TICKS(syncman->_resume.isValid() ? RESUME_DELAY : 5000));
 
     while(true)
     {
+#ifdef SYNC_OFFSET_STATS
+        int64_t start = esp_timer_get_time();
         syncman->process();
-        vTaskDelay(pdMS_TO_TICKS(10));
+        syncman->recordLoad(esp_timer_get_time() - start);
+#else
+        syncman->process();
+#endif
+        syncman->wait();
     }
     ESP_LOGE(TAG, "::task - terminating (should never happen)!");
     vTaskDelete(nullptr);
 }
-
-void SyncManager::setTime(int32_t delta)
-{
-    uint32_t target = 1000000 - 200; // just shy of the second mark to compensate for time to write seconds
-    struct timeval tv;
-    uint32_t loops = 0;
-    do {
-        _gpspps.getTime(&tv);
-        ++loops;
-    } while (tv.tv_usec < target); // busy wait for microseconds!
-
-#ifdef SYNC_LATENCY_OUTPUT
-    gpio_set_level(LATENCY_PIN, 1);
-#endif
-
-    // we are targeting the next second
-    tv.tv_sec += 1; 
-
-    // disable time incrementing in the RTC PPS so we dont accidentally increment
-    // then set the RTC PPS counter time. It wil be re-enabled after the RTC has been set
-    _rtcpps.setDisable(true);
-    _rtcpps.setTime(tv.tv_sec);
-
-    struct tm* tm = gmtime(&tv.tv_sec);
-    if (!_rtc.setTime(tm))
-    {
-#ifdef SYNC_LATENCY_OUTPUT
-        gpio_set_level(LATENCY_PIN, 0);
-#endif
-        ESP_LOGE(TAG, "setTime: failed to set time for DS3231");
-        return;
-    }
-    _rtcpps.setDisable(false);
-
-#ifdef SYNC_LATENCY_OUTPUT
-    gpio_set_level(LATENCY_PIN, 0);
-#endif
-
-    ESP_LOGI(TAG, "setTime: success setting time! microsecond value=%ld loops=%u", tv.tv_usec, loops);
-}
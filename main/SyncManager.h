@@ -26,16 +26,46 @@
 #define _SYNC_MANAGER_H
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "esp_intr_alloc.h"
 #include "GPS.h"
 #include "PPS.h"
 #include "DS3231.h"
+#include "PPSEdgeReader.h"
+#include "ClockKalman.h"
+#include "TempModel.h"
+#include "RTCSetter.h"
+#include "OffsetFilter.h"
+#include "PIDControl.h"
+#include "PIDTuner.h"
+#include "AgingSweep.h"
+#include "Holdover.h"
+#include "ResumeState.h"
+#include "GPSValidator.h"
+#include "SourceSelector.h"
+#include "ReceiverSelector.h"
+#include "PeerClient.h"
+#include "APLLSteering.h"
+#include "Config.h"
+#ifdef PPS_MODEL_CHECK
+#include "PPSModelCheck.h"
+#endif
 
 class SyncManager {
 public:
-    SyncManager(GPS& gps, DS3231& rtc, PPS& gpspps, PPS& rtcpps);
+    //
+    // control engine that drives the RTC aging register
+    //
+    enum Engine : uint8_t
+    {
+        ENGINE_PID    = 0,
+        ENGINE_KALMAN = 1,
+    };
+
+    SyncManager(Config& config, GPS& gps, DS3231& rtc, PPS& gpspps, PPS& rtcpps);
     bool     begin();
     time_t   getGPSTime();
     time_t   getRTCTime();
+    uint32_t getRTCMismatchCount();
     void     getRTCPPSTime(struct timeval* tv);
     void     getGPSPPSTime(struct timeval* tv);
     bool     isOffsetValid();
@@ -49,23 +79,98 @@ public:
     float    getTarget();
     void     setTarget(float target);
     bool     isValid(); // is GPS valid
+    const char* getValidReason();
+    const GPSValidator& getValidator();
+    bool     addReceiver(GPS& gps, PPS& pps);
+    uint32_t getReceiverCount();
+    uint32_t getActiveReceiver();
+    const ReceiverSelector& getReceiverSelector();
+    const GPSValidator& getReceiverValidator(uint32_t index);
     uint32_t getValidDuration();
     uint32_t getValidCount();
     int8_t   getOutput();
+    float    getClearBias();
+    RTCSetter& getRTCSetter();
+    void     setEngine(Engine engine);
+    Engine   getEngine();
+    const ClockKalman& getKalman();
+    static const char* getEngineName(Engine engine);
+    static bool parseEngine(const char* name, Engine* enginep);
+    void     setGains(float kp, float ki, float kd);
+    float    getKp();
+    float    getKi();
+    float    getKd();
+    void     startTune();
+    const PIDTuner& getTuner();
+    void     startSweep();
+    const AgingSweep& getSweep();
+    const AgingSweep::Result& getAgingCal();
+    float    getPlantGain();
+    const Holdover& getHoldover();
+    float    getErrorBound();
+    uint8_t  getStratum();
+    bool     isSynchronized();
+    void     setPeerClient(PeerClient* peers);
+    void     setAPLL(APLLSteering* apll);
+    void     setTimepulseRate(uint32_t rate);
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+    void     setCaptureBench(PPS* bench);
+#endif
+    const SourceSelector& getSelector();
+    SourceSelector::Type getReference();
+    uint32_t getReferenceSwitches();
+    uint32_t getSourceCount();
+    uint32_t getFalsetickers();
+    uint32_t getRefId();
+    float    getRootDelay();
+    float    getTemperature();
+    float    getFeedForward();
+    const TempModel& getTempModel();
     static const uint32_t PID_INTERVAL = 1;
+#if defined(CONFIG_GPSNTP_OFFSET_WINDOW)
+    static const uint32_t OFFSET_DATA_SIZE = CONFIG_GPSNTP_OFFSET_WINDOW;
+#else
     static const uint32_t OFFSET_DATA_SIZE = 10;
+#endif
 
 private:
-    float           _Kp = 3.2;
-    float           _Ki = 0.1;
-    float           _Kd = 0.8;
+    //
+    // learned discipline state saved to NVS so a restart begins close to where it left off
+    //
+    struct Checkpoint
+    {
+        uint32_t version;
+        uint8_t  engine;
+        int32_t  time;        // RTC time of the checkpoint, the last time GPS was good
+        float    output;      // steady state aging value
+        float    integral;    // PID integral term (Ki * integral)
+        float    frequency;   // kalman frequency, ppm
+        float    aging;       // kalman aging, ppm/s
+        float    freq_error;  // frequency uncertainty, ppm
+        float    temperature;
+        float    bound;       // error bound, us
+    };
+    static const uint32_t CHECKPOINT_VERSION = 1;
+
+    PIDControl      _pid{3.2, 0.1, 0.8}; // Kp, Ki, Kd
 
-    int32_t         _offset_data[OFFSET_DATA_SIZE] = {0};
-    GPS&            _gps;
+    OffsetFilter    _offsets;
+    volatile float  _offset_estimate    = 0; // ticks, updated with each sample
+    volatile int32_t _offset_min        = 0;
+    volatile int32_t _offset_max        = 0;
+    Config&         _config;
+    GPS*            _gps;                     // the active receiver
     DS3231&         _rtc;
-    PPS&            _gpspps;
+    PPS*            _gpspps;                  // and its PPS
     PPS&            _rtcpps;
-    TaskHandle_t    _task;
+    PPSEdgeReader   _edges;
+    RTCSetter       _rtc_setter;
+    bool            _rtc_set_calibrate  = false; // calibrate the set lead with the next offset
+#ifdef PPS_MODEL_CHECK
+    PPSModelCheck   _model_check;
+#endif
+    TaskHandle_t    _task               = nullptr;
+    intr_handle_t   _intr               = nullptr; // software interrupt raised by PPS edges, null when polling
 
     //
     // Target is an offset in microseconds that we try to keep the RTC PPS from teh GPS PPS
@@ -75,23 +180,154 @@ private:
     // We can optionally bias the output to compensate for natural drift from the RTC. This
     // makes initial syncing faster as the integral does not need to build up to compensate.
     // A good value for that can be found by setting bias to zero, letting Sync match the target.
-    // than take the synced integral value and multiply it by Ki.
+    // than take the synced integral value and multiply it by Ki.  Once the temperature
+    // model has learned the current temperature its prediction is used instead.
     //
     float           _bias               = 0.0;
 
     volatile time_t _last_time          = 0;
     volatile time_t _rtc_time           = 0;
+    bool            _rtc_check          = true;  // compare the RTC calendar with the RTC PPS seconds
+    uint32_t        _rtc_check_time     = 0;     // uptime of the last comparison
+    int32_t         _rtc_delta          = 0;     // calendar - RTC PPS seconds at the last comparison
+    uint32_t        _rtc_mismatch       = 0;     // comparisons that did not agree
     time_t          _drift_start_time   = 0; // start of drift timeing (if 0 means no initial sample)
-    uint32_t        _offset_index       = 0;
-    uint32_t        _offset_count       = 0;
-    float           _integral           = 0.0;
-    float           _previous_error     = 0.0;
+    uint32_t        _gps_edge           = 0; // timer value of the last GPS PPS edge
+    bool            _gps_edge_valid     = false;
+    int32_t         _assert_offset      = 0; // offset of the last RTC assert edge
+    bool            _assert_offset_valid = false;
+    float           _clear_bias         = 0.0; // ticks the RTC clear edge is late by
+    bool            _clear_bias_valid   = false; // seeded from a clear edge since clearOffset()
+    uint32_t        _rtc_edge           = 0; // timer value of the last RTC PPS assert edge
+    bool            _rtc_edge_valid     = false;
+    uint32_t        _pps_rate           = 1; // configured GPS timepulse rate
+    uint32_t        _align_last[ReceiverSelector::MAX_RECEIVERS] = {}; // GPS PPS edge of the last alignment check
+    uint32_t        _top_shift[ReceiverSelector::MAX_RECEIVERS] = {};
+    uint32_t        _top_shift_count[ReceiverSelector::MAX_RECEIVERS] = {};
+    uint32_t        _top_settle[ReceiverSelector::MAX_RECEIVERS] = {}; // aligned checks needed before its offsets are used
     int8_t          _output             = 0;
+    Engine          _engine             = ENGINE_PID;
+    ClockKalman     _kalman;
+    PIDTuner        _tuner;
+    volatile bool   _tune_request       = false; // start tuning from the sync task
+    AgingSweep      _sweep;
+    AgingSweep::Result _aging_cal;
+    volatile bool   _sweep_request      = false; // start a characterisation from the sync task
+    Holdover        _holdover;
+    float           _holdover_freq_error = 0; // frequency uncertainty when holdover started, ppm
+    float           _holdover_temp      = 0;  // temperature when holdover started
+    bool            _holdover_temp_valid = false;
+    uint32_t        _holdover_time      = 0;  // uptime of the last holdover output
+    float           _holdover_dither    = 0;  // output rounding carried to the next second
+    volatile float  _error_bound        = 0;  // published for NTP, us
+    volatile uint8_t _stratum           = 16;
+    uint32_t        _lock_time          = 0;  // uptime when last locked
+    PeerClient*     _peers              = nullptr;
+    APLLSteering*   _apll               = nullptr;
+    SourceSelector  _selector;
+    uint32_t        _source_time        = 0;  // uptime of the last selection
+    bool            _gps_falseticker    = false; // GPS rejected by the selection
+    uint32_t        _gps_false_count    = 0;  // consecutive selections the GPS was a falseticker
+    uint32_t        _gps_true_count     = 0;  // consecutive selections the GPS was a truechimer
+    volatile SourceSelector::Type _reference = SourceSelector::GPS;
+    uint32_t        _reference_switches = 0;
+    volatile uint32_t _source_count     = 0;
+    volatile uint32_t _falsetickers     = 0;
+    uint32_t        _peer_addr          = 0;  // the referenced peer
+    uint8_t         _peer_stratum       = 0;
+    float           _peer_offset        = 0;  // peer - local, us
+    float           _peer_bound         = 0;  // us
+    float           _peer_root_delay    = 0;  // us
+    volatile uint32_t _ref_id           = 0;  // published for NTP, as sent
+    volatile float  _root_delay         = 0;  // published for NTP, us
+    Checkpoint      _checkpoint;              // last saved (or restored) checkpoint
+    bool            _checkpoint_valid   = false;
+    uint32_t        _checkpoint_time    = 0;  // uptime of the last checkpoint check
+    uint32_t        _checkpoint_writes  = 0;
+    GPS*            _receivers[ReceiverSelector::MAX_RECEIVERS];
+    PPS*            _receiver_pps[ReceiverSelector::MAX_RECEIVERS];
+    GPSValidator    _validators[ReceiverSelector::MAX_RECEIVERS];
+    ReceiverSelector _receiver_selector;
+    uint32_t        _receiver_count     = 1;
+    uint32_t        _active             = 0;  // index of the active receiver
+    uint32_t        _receiver_log_time  = 0;  // uptime of the last receiver health log
+    int64_t         _validate_time      = 0;  // esp_timer time of the last validation
+    time_t          _validate_second    = 0;  // GPS PPS second of the last validation
+    uint32_t        _validate_pps_last[ReceiverSelector::MAX_RECEIVERS] = {}; // GPS PPS edge seen by the last validation
+    ResumeState     _resume;
+    uint32_t        _resume_time        = 0;  // uptime of the last resume block save
+    bool            _resume_pending     = false; // resumed, control loop not running yet
+    bool            _resume_stable      = false;
+    uint32_t        _offset_samples     = 0; // total offset samples recorded
+    uint32_t        _kalman_samples     = 0; // _offset_samples at the last kalman update
+    int64_t         _kalman_time        = 0; // esp_timer time of the last kalman update
+    TempModel       _temp_model;
+    float           _temperature        = 0.0;
+    bool            _temperature_valid  = false;
+    float           _ff_temperature     = 0.0; // temperature the kalman frequency is adjusted for
+    time_t          _temp_time          = 0;
+    bool            _temp_model_dirty   = false;
+#ifdef SYNC_OFFSET_STATS
+    double          _stats_sum          = 0;
+    double          _stats_sum_sq       = 0;
+    uint32_t        _stats_count        = 0;
+    time_t          _control_start      = 0; // when the controller was (re)started
+    uint32_t        _settle_time        = 0; // seconds to settle, 0 if not settled yet
+    uint32_t        _settle_count       = 0;
+    double          _control_sum_sq     = 0;
+    uint32_t        _control_count      = 0;
+    int64_t         _load_start         = 0;
+    int64_t         _load_busy          = 0; // us spent in process() since _load_start
+    uint32_t        _load_wakes         = 0;
+    void recordOffsetStats(int32_t offset);
+    void recordControlStats(float error);
+    void recordLoad(int64_t busy);
+#endif
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+    PPS*            _bench              = nullptr; // MCPWM capture of the first receivers PPS
+    uint32_t        _bench_last         = 0;
+    double          _bench_sum          = 0;
+    double          _bench_sum_sq       = 0;
+    int32_t         _bench_min          = 0;
+    int32_t         _bench_max          = 0;
+    uint32_t        _bench_count        = 0;
+    void recordCaptureBench();
+#endif
+    static int32_t wrapOffset(int32_t offset);
     void recordOffset();
+    void recordAveragedOffset(const pps_edge_t& edge);
+    bool alignTimepulse();
+    void addOffset(int32_t offset);
     void resetOffset();
+    void clearOffset();
     void manageDrift(float offset);
+    void managePID(float offset);
+    void manageKalman();
+    void manageTune(float offset);
+    void manageSweep(float offset);
+    float getSteadyOutput();
+    bool setOutput(float output);
+    void updateLock(float offset);
+    void manageHoldover(bool valid);
+    float getHoldoverFreqError(float* deltap);
+    void measureHoldover(const struct timeval& gps_tv, const struct timeval& rtc_tv, float offset);
+    void publishBound();
+    void addPeers(uint32_t now);
+    bool selectSource(bool gps_valid, float offset);
+    float getFreqError(float* driftp);
+    void checkpoint();
+    void restoreCheckpoint();
+    bool resume();
+    bool validateGPS();
+    void validateReceiver(uint32_t index, bool window, ReceiverSelector::Observation* observationp);
+    void switchReceiver(uint32_t index);
+    void logReceivers();
+    void saveResume();
+    void updateTemperature(bool locked);
+    void updateRTCTime();
     void process();
-    void setTime(int32_t delta);
+    void wait();
+    static void edge(void* data);
     static void task(void* data);
 
 };
@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "TempModel.h"
+#include <string.h>
+#include <math.h>
+
+// new samples are averaged with a weight of 1/count until the count reaches
+// AVERAGE_MAX, after that the bin follows slow changes (crystal aging)
+#define AVERAGE_MAX 256
+
+TempModel::TempModel()
+{
+    clear();
+}
+
+void TempModel::clear()
+{
+    memset(&_data, 0, sizeof(_data));
+    _data.version = VERSION;
+}
+
+int TempModel::bin(float temp)
+{
+    int b = (int)floor(temp + 0.5) - TEMP_MIN;
+    if (b < 0 || b >= BINS)
+    {
+        return -1;
+    }
+    return b;
+}
+
+/**
+ * add a settled aging value observed at temp, returns false if temp is out of range
+*/
+bool TempModel::add(float temp, float aging)
+{
+    int b = bin(temp);
+    if (b < 0)
+    {
+        return false;
+    }
+    if (_data.count[b] < AVERAGE_MAX)
+    {
+        _data.count[b] += 1;
+    }
+    _data.aging[b] += (aging - _data.aging[b]) / _data.count[b];
+    return true;
+}
+
+/**
+ * predict the aging value at temp by interpolating between the closest learned
+ * bins on either side, or the closest one if there is only one side.  Returns
+ * false if nothing has been learned yet.
+*/
+bool TempModel::predict(float temp, float* agingp) const
+{
+    int b = bin(temp);
+    if (b < 0)
+    {
+        b = temp < TEMP_MIN ? 0 : BINS-1;
+    }
+
+    int lo = -1;
+    for (int i = b; i >= 0; --i)
+    {
+        if (_data.count[i] >= MIN_COUNT)
+        {
+            lo = i;
+            break;
+        }
+    }
+    int hi = -1;
+    for (int i = b; i < BINS; ++i)
+    {
+        if (_data.count[i] >= MIN_COUNT)
+        {
+            hi = i;
+            break;
+        }
+    }
+
+    if (lo < 0 && hi < 0)
+    {
+        return false;
+    }
+    if (lo < 0 || lo == hi)
+    {
+        *agingp = _data.aging[hi];
+        return true;
+    }
+    if (hi < 0)
+    {
+        *agingp = _data.aging[lo];
+        return true;
+    }
+
+    float pos = temp - TEMP_MIN - lo;
+    if (pos < 0)
+    {
+        pos = 0;
+    }
+    else if (pos > hi - lo)
+    {
+        pos = hi - lo;
+    }
+    *agingp = _data.aging[lo] + (_data.aging[hi] - _data.aging[lo]) * pos / (hi - lo);
+    return true;
+}
+
+/**
+ * the number of bins with enough samples to be used
+*/
+uint32_t TempModel::getBins() const
+{
+    uint32_t n = 0;
+    for (int i = 0; i < BINS; ++i)
+    {
+        if (_data.count[i] >= MIN_COUNT)
+        {
+            n += 1;
+        }
+    }
+    return n;
+}
+
+bool TempModel::setData(const Data& data)
+{
+    if (data.version != VERSION)
+    {
+        return false;
+    }
+    _data = data;
+    return true;
+}
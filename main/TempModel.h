@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _TEMP_MODEL_H
+#define _TEMP_MODEL_H
+
+#include <stdint.h>
+
+//
+// Learned model of the RTC aging value needed to hold frequency as a function of
+// temperature.  The DS3231 compensates its crystal but the residual still moves
+// with temperature, so the aging value the sync loop settles on is averaged into
+// one degree bins and interpolated to give a feed-forward (and a holdover value
+// when GPS is lost).  The data is a plain struct so it can be stored as an NVS blob.
+//
+class TempModel
+{
+public:
+    static const int      BINS      = 64;
+    static const int      TEMP_MIN  = -10;  // temperature of bin 0 (C)
+    static const uint32_t VERSION   = 1;
+    static const uint16_t MIN_COUNT = 8;    // samples before a bin is used
+
+    struct Data
+    {
+        uint32_t version;
+        float    aging[BINS];
+        uint16_t count[BINS];
+    };
+
+    TempModel();
+    void  clear();
+    bool  add(float temp, float aging);
+    bool  predict(float temp, float* agingp) const;
+    uint32_t getBins() const;
+
+    const Data& getData() const { return _data; }
+    bool  setData(const Data& data);
+
+private:
+    Data _data;
+    static int bin(float temp);
+};
+
+#endif // _TEMP_MODEL_H
@@ -34,18 +34,23 @@
 #include "DS3231.h"
 #include "MicroSecondTimer.h"
 #include "PPS.h"
+#include "PPSOutput.h"
+#include "APLLSteering.h"
 #include "GPS.h"
 #include "NTP.h"
+#include "PeerClient.h"
 #include "SyncManager.h"
 
 #include "PageAbout.h"
 #include "PageConfig.h"
 #include "PagePPS.h"
+#include "PageISR.h"
 #include "PageDelta.h"
 #include "PageSync.h"
 #include "PageGPS.h"
 #include "PageSats.h"
 #include "PageNTP.h"
+#include "PageReceivers.h"
 
 #define LATENCY_PIN 2
 #define LATENCY_SEL (1<<LATENCY_PIN)
@@ -68,7 +73,53 @@ extern "C" {
 #define GPS_RX_PIN (GPIO_NUM_33)
 #define GPS_TX_PIN (GPIO_NUM_32)
 #define GPS_PPS_PIN ((gpio_num_t)CONFIG_GPSNTP_PPS_PIN)
+#if defined(CONFIG_GPSNTP_PPS_RATE)
+#define GPS_PPS_RATE CONFIG_GPSNTP_PPS_RATE
+#else
+#define GPS_PPS_RATE 1
+#endif
+#if defined(CONFIG_GPSNTP_GPS2)
+#define GPS2_RX_PIN ((gpio_num_t)CONFIG_GPSNTP_GPS2_RX_PIN)
+#define GPS2_TX_PIN ((gpio_num_t)CONFIG_GPSNTP_GPS2_TX_PIN)
+#define GPS2_PPS_PIN ((gpio_num_t)CONFIG_GPSNTP_GPS2_PPS_PIN)
+#endif
 #define RTC_PPS_PIN ((gpio_num_t)CONFIG_GPSNTP_SQW_PIN)
+#if defined(CONFIG_GPSNTP_NTP_PEERS)
+#define NTP_PEERS CONFIG_GPSNTP_NTP_PEERS
+#else
+#define NTP_PEERS ""
+#endif
+#if defined(CONFIG_GPSNTP_NTP_PEER_POLL)
+#define NTP_PEER_POLL CONFIG_GPSNTP_NTP_PEER_POLL
+#else
+#define NTP_PEER_POLL 64
+#endif
+#if defined(CONFIG_GPSNTP_RTC_BOTH_EDGES)
+#define RTC_BOTH_EDGES true
+#else
+#define RTC_BOTH_EDGES false
+#endif
+#if defined(CONFIG_GPSNTP_PPS_OUT_PIN) && CONFIG_GPSNTP_PPS_OUT_PIN >= 0
+#define PPS_OUT_PIN ((gpio_num_t)CONFIG_GPSNTP_PPS_OUT_PIN)
+#if defined(CONFIG_GPSNTP_PPS_OUT_RATE_10HZ)
+#define PPS_OUT_PERIOD PPSOutput::PERIOD_10HZ
+#elif defined(CONFIG_GPSNTP_PPS_OUT_RATE_1KHZ)
+#define PPS_OUT_PERIOD PPSOutput::PERIOD_1KHZ
+#elif defined(CONFIG_GPSNTP_PPS_OUT_RATE_PP2S)
+#define PPS_OUT_PERIOD PPSOutput::PERIOD_PP2S
+#elif defined(CONFIG_GPSNTP_PPS_OUT_RATE_PPM)
+#define PPS_OUT_PERIOD PPSOutput::PERIOD_PPM
+#else
+#define PPS_OUT_PERIOD PPSOutput::PERIOD_PPS
+#endif
+#endif
+#if defined(CONFIG_GPSNTP_PPS_OUT_LOOPBACK_PIN) && CONFIG_GPSNTP_PPS_OUT_LOOPBACK_PIN >= 0
+#define PPS_LOOPBACK_PIN ((gpio_num_t)CONFIG_GPSNTP_PPS_OUT_LOOPBACK_PIN)
+#endif
+// the MCPWM capture has two channels, the GPS and RTC PPS (Kconfig keeps the rest off it)
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_MCPWM) && (defined(CONFIG_GPSNTP_GPS2) || defined(PPS_LOOPBACK_PIN))
+#error "the MCPWM capture has only two channels, the second GPS and the loopback need the ISR capture"
+#endif
 #define SDA_PIN (GPIO_NUM_16)
 #define SCL_PIN (GPIO_NUM_17)
 #define TFT_LED_PIN (GPIO_NUM_4)
@@ -85,21 +136,45 @@ static const char* TAG = "main";
 
 extern pps_data_t rtc_pps_data; // in highint5.S
 extern pps_data_t gps_pps_data; // in highint5.S
+extern pps_data_t out_pps_data; // in highint5.S
+extern pps_data_t gps2_pps_data; // in highint5.S
 
 static Config config;
 static MicroSecondTimer usec_timer;
 static PPS gps_pps(usec_timer, &gps_pps_data);
 static PPS rtc_pps(usec_timer, &rtc_pps_data, &gps_pps); // use gps_pps as ref.
+#if defined(PPS_OUT_PIN)
+#if defined(PPS_LOOPBACK_PIN)
+static PPS out_pps(usec_timer, &out_pps_data, &rtc_pps); // loopback of pps_out, rtc_pps as ref.
+static PPSOutput pps_out(usec_timer, rtc_pps, &out_pps);
+#else
+static PPSOutput pps_out(usec_timer, rtc_pps);
+#endif
+#endif
+#if defined(CONFIG_GPSNTP_APLL_OUTPUT)
+static APLLSteering apll(gps_pps);
+#endif
 static GPS gps(usec_timer);
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+static pps_data_t bench_pps_data;
+static PPS bench_pps(usec_timer, &bench_pps_data);
+#endif
+#if defined(CONFIG_GPSNTP_GPS2)
+static PPS gps2_pps(usec_timer, &gps2_pps_data);
+static GPS gps2(usec_timer, UART_NUM_2);
+#endif
 static DS3231 rtc;
-static NTP ntp(rtc_pps);
-static SyncManager syncman(gps, rtc, gps_pps, rtc_pps);
+static SyncManager syncman(config, gps, rtc, gps_pps, rtc_pps);
+static NTP ntp(rtc_pps, syncman);
+static PeerClient peers(rtc_pps); // timestamps from the clock we serve
 
 static void apply_config()
 {
     ESP_LOGI(TAG, "apply_config()");
     syncman.setBias(config.getBias());
     syncman.setTarget(config.getTarget());
+    syncman.setEngine((SyncManager::Engine)config.getEngine());
+    syncman.setGains(config.getKp(), config.getKi(), config.getKd());
 }
 
 static void init(void* data)
@@ -177,14 +252,53 @@ static void init(void* data)
         ESP_LOGE(TAG, "failed to start gps!");
     }
 
+    // the timepulse starts at 1Hz (it may still be fast from before a restart), the
+    // sync manager raises it once the RTC can tell which pulse is the top of second
+    if (GPS_PPS_RATE > 1)
+    {
+        gps.setTimepulseRate(1);
+    }
+    syncman.setTimepulseRate(GPS_PPS_RATE);
+
     // start pps watching gps
     if (!gps_pps.begin(GPS_PPS_PIN))
     {
         ESP_LOGE(TAG, "failed to start GPS pps!");
     }
+#if defined(CONFIG_GPSNTP_PPS_CAPTURE_BENCH)
+    // and the same pin with the MCPWM capture to compare the two
+    if (bench_pps.beginBench(GPS_PPS_PIN))
+    {
+        syncman.setCaptureBench(&bench_pps);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "failed to start the capture bench!");
+    }
+#endif
+
+#if defined(CONFIG_GPSNTP_GPS2)
+    // the second receiver is a standby for the sync manager
+    if (!gps2.begin(GPS2_RX_PIN, GPS2_TX_PIN))
+    {
+        ESP_LOGE(TAG, "failed to start second gps!");
+    }
+    if (GPS_PPS_RATE > 1)
+    {
+        gps2.setTimepulseRate(1);
+    }
+    if (!gps2_pps.begin(GPS2_PPS_PIN))
+    {
+        ESP_LOGE(TAG, "failed to start second GPS pps!");
+    }
+    else
+    {
+        syncman.addReceiver(gps2, gps2_pps);
+    }
+#endif
 
     // start pps watching rtc
-    if (!rtc_pps.begin(RTC_PPS_PIN, true))
+    if (!rtc_pps.begin(RTC_PPS_PIN, true, RTC_BOTH_EDGES))
     {
         ESP_LOGE(TAG, "failed to start RTC pps!");
     }
@@ -192,8 +306,8 @@ static void init(void* data)
     // wait for the RTC PPS signal to be low, the first half of a secondm, so we
     // don't do this on a second boundry as the RTC PPS could get or miss an increment.
     ESP_LOGI(TAG, " waiting a change in seconds");
-    time_t now = rtc_pps.getTime(nullptr);
-    while(rtc_pps.getTime(nullptr) == now)
+    time_t now = rtc_pps.getSeconds();
+    while(rtc_pps.getSeconds() == now)
     {
         vTaskDelay(pdMS_TO_TICKS(50));
     }
@@ -202,15 +316,53 @@ static void init(void* data)
     rtc.getTime(&tm);
     rtc_pps.setTime(mktime(&tm));
 
+#if defined(PPS_OUT_PIN)
+#if defined(PPS_LOOPBACK_PIN)
+    // start pps watching our own output, only at 1PPS as every loopback edge is
+    // taken as a top of second
+    if (PPS_OUT_PERIOD == PPSOutput::PERIOD_PPS && !out_pps.begin(PPS_LOOPBACK_PIN))
+    {
+        ESP_LOGE(TAG, "failed to start loopback pps!");
+    }
+#endif
+    // start the timing pulse output
+    if (!pps_out.begin(PPS_OUT_PIN, PPS_OUT_PERIOD))
+    {
+        ESP_LOGE(TAG, "failed to start pps output!");
+    }
+#endif
+
+#if defined(CONFIG_GPSNTP_APLL_OUTPUT)
+    // start the frequency output
+    if (apll.begin())
+    {
+        syncman.setAPLL(&apll);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "failed to start APLL steering!");
+    }
+#endif
+
     // start NTP services
     ntp.begin();
 
+    // start polling the NTP peers, if any, as extra sources for the sync manager
+    if (peers.begin(NTP_PEERS, NTP_PEER_POLL))
+    {
+        syncman.setPeerClient(&peers);
+    }
+
     // start the sync manager
     syncman.begin();
 
     new PageNTP(ntp, syncman);
     new PagePPS(gps_pps, rtc_pps);
+    new PageISR(gps_pps, rtc_pps);
     new PageSync(syncman);
+#if defined(CONFIG_GPSNTP_GPS2)
+    new PageReceivers(syncman);
+#endif
     new PageDelta(syncman);
     new PageGPS(gps);
     new PageSats(gps);
@@ -248,7 +400,7 @@ void app_main()
     {
         struct timeval gps_tv;
         gps_pps.getTime(&gps_tv);
-        bool now_valid = gps.getValid();
+        bool now_valid = syncman.isValid();
         if (was_valid != now_valid)
         {
             ESP_LOGW(TAG, "gps %s validity!", now_valid ? "gained" : "lost");
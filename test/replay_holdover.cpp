@@ -0,0 +1,270 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+
+//
+// Offline replay of holdover accuracy.  An RTC is disciplined by the PID engine the
+// way SyncManager runs it, then GPS is taken away for a set of holdover durations
+// and the RTC runs on the held aging value while Holdover grows its error bound.
+// When GPS comes back the actual RTC time error is measured against the predicted
+// bound, the same as SyncManager::measureHoldover.
+//
+// The RTC is a recorded offset log, one sample per second: seconds, RTC - GPS offset
+// (us), the aging value that was in effect and optionally the temperature (C),
+// separated by spaces or commas ('#' starts a comment).  As in replay_offsets the
+// natural drift of the RTC is whatever the recording shows with the recorded aging
+// taken out, so the replayed offset is
+//
+//   offset(t) = recorded(t) + gain * sum((aging - recorded aging) * dt)
+//
+// and a holdover in the replay runs on the recorded frequency, aging and
+// temperature drift of the real RTC.
+//
+//   replay_holdover [log]
+//
+// Without a log a synthetic RTC with a frequency offset, aging, a daily temperature
+// cycle and phase noise is replayed and no holdover may exceed its bound.
+//
+#include "PIDControl.h"
+#include "OffsetFilter.h"
+#include "Holdover.h"
+#include "check.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// as in SyncManager
+#define GAIN                0.1     // ppm/LSB
+#define WINDOW              10
+#define INTEGRAL_LIMIT_PPM  6.4
+#define HOLDOVER_FREQ_ERROR 0.02    // ppm
+#define HOLDOVER_AGING_RATE (1.0/(365.0*86400.0))
+#define HOLDOVER_TEMP_COEFF 0.1     // ppm/C without a temperature model
+#define HOLDOVER_LOCK_ERROR 10.0    // us
+
+// seconds locked before each holdover and the holdovers replayed in turn
+#define LOCK_TIME           3600
+static const uint32_t durations[] = {300, 900, 1800, 3600, 7200};
+
+// offsets are kept in the filter as ns
+#define NS_PER_US           1000.0
+
+struct Sample
+{
+    double seconds;
+    double offset;  // us
+    double aging;   // LSB
+    double temp;    // C
+};
+
+struct Measured
+{
+    uint32_t duration;  // seconds
+    float    error;     // us
+    float    bound;     // us
+};
+
+static float round_aging(float output)
+{
+    output = round(output);
+    return output > 127 ? 127 : (output < -127 ? -127 : output);
+}
+
+/**
+ * replay the samples, alternating LOCK_TIME locked with the next holdover duration
+*/
+static void replay(const std::vector<Sample>& samples, Holdover* holdoverp, std::vector<Measured>* measuredp)
+{
+    PIDControl   pid(3.2, 0.1, 0.8);
+    OffsetFilter offsets(WINDOW);
+    Holdover&    holdover = *holdoverp;
+
+    float    aging     = 0;
+    double   shift     = 0;     // us added by our aging against the recorded aging
+    float    limit     = INTEGRAL_LIMIT_PPM / GAIN > 127.0 ? 127.0 : INTEGRAL_LIMIT_PPM / GAIN;
+    size_t   next      = 0;     // next holdover duration
+    double   phase     = 0;     // start of the current lock or holdover
+    double   start_temp = 0;
+
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const Sample& s = samples[i];
+        if (i > 0)
+        {
+            double dt = s.seconds - samples[i-1].seconds;
+            shift += GAIN * (aging - samples[i-1].aging) * dt;
+        }
+        double   offset = s.offset + shift;
+        uint32_t now    = (uint32_t)(s.seconds - samples[0].seconds);
+
+        if (holdover.isHolding())
+        {
+            holdover.update(now, HOLDOVER_FREQ_ERROR + fabs(s.temp - start_temp) * HOLDOVER_TEMP_COEFF);
+            if (s.seconds - phase < durations[next])
+            {
+                aging = holdover.getOutput(now);
+                continue;
+            }
+
+            // GPS is back, the first offset is the holdover error
+            holdover.reacquire();
+            float bound = holdover.getErrorBound();
+            holdover.measure(-offset);
+            measuredp->push_back({durations[next], (float)-offset, bound});
+            next  = (next + 1) % (sizeof(durations) / sizeof(durations[0]));
+            phase = s.seconds;
+            offsets.reset();
+            pid.clearError();
+        }
+
+        offsets.add((int32_t)lround(offset * NS_PER_US));
+        if (!offsets.isFull())
+        {
+            continue;
+        }
+        float estimate = offsets.getEstimate() / NS_PER_US;
+        float error    = 0 - estimate;
+        aging = round_aging(pid.update(error, 0, limit));
+
+        // the same lock as SyncManager::updateLock
+        if (holdover.getState() == Holdover::UNLOCKED)
+        {
+            if (fabs(error) > HOLDOVER_LOCK_ERROR)
+            {
+                continue;
+            }
+            phase = s.seconds;
+        }
+        holdover.lock(fabs(error) + (offsets.getMax() - offsets.getMin()) / NS_PER_US / 2.0);
+
+        // GPS lost, hold the steady state output
+        if (s.seconds - phase >= LOCK_TIME)
+        {
+            holdover.enter(now, pid.getIntegralOutput(), 0, HOLDOVER_FREQ_ERROR);
+            aging      = holdover.getOutput(now);
+            phase      = s.seconds;
+            start_temp = s.temp;
+        }
+    }
+}
+
+static bool load(const char* path, std::vector<Sample>* samplesp)
+{
+    FILE* f = fopen(path, "r");
+    if (f == nullptr)
+    {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f) != nullptr)
+    {
+        char* comment = strchr(line, '#');
+        if (comment != nullptr)
+        {
+            *comment = '\0';
+        }
+        for (char* p = line; *p != '\0'; ++p)
+        {
+            if (*p == ',')
+            {
+                *p = ' ';
+            }
+        }
+        Sample s = {0, 0, 0, 0};
+        if (sscanf(line, "%lf %lf %lf %lf", &s.seconds, &s.offset, &s.aging, &s.temp) >= 3)
+        {
+            samplesp->push_back(s);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static double gaussian(uint32_t* seedp)
+{
+    *seedp = *seedp * 1103515245 + 12345;
+    double u1 = ((*seedp >> 8) & 0xffff) / 65536.0 + 1e-9;
+    *seedp = *seedp * 1103515245 + 12345;
+    double u2 = ((*seedp >> 8) & 0xffff) / 65536.0;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * two days of a free running TCXO RTC: 1.2ppm fast, aging at 1ppm a year, 0.05ppm/C
+ * over a daily 3C temperature swing, a little frequency wander and 0.3us of white
+ * phase noise on the PPS edges.
+*/
+static void synthesize(std::vector<Sample>* samplesp)
+{
+    uint32_t seed   = 4321;
+    double   phase  = 20.0;
+    double   wander = 0;
+    for (int t = 0; t < 2 * 86400; ++t)
+    {
+        double temp = 25.0 + 3.0 * sin(t * 2.0 * M_PI / 86400.0);
+        wander += 0.00002 * gaussian(&seed);
+        double freq = -1.2 - HOLDOVER_AGING_RATE * t + 0.05 * (temp - 25.0) + wander;
+        phase += freq;
+        samplesp->push_back({(double)t, phase + 0.3 * gaussian(&seed), 0, temp});
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<Sample> samples;
+    if (argc > 1)
+    {
+        if (!load(argv[1], &samples))
+        {
+            return 2;
+        }
+    }
+    else
+    {
+        synthesize(&samples);
+    }
+    printf("%zu samples\n", samples.size());
+
+    Holdover holdover(HOLDOVER_AGING_RATE);
+    std::vector<Measured> measured;
+    replay(samples, &holdover, &measured);
+    for (const Measured& m : measured)
+    {
+        printf("holdover %5us error=%8.2fus bound=%8.2fus ratio=%0.2f%s\n", m.duration, m.error, m.bound,
+               m.bound > 0 ? fabs(m.error) / m.bound : 0, fabs(m.error) > m.bound ? " OVER" : "");
+    }
+    printf("%u holdovers, %u over bound, worst %0.2f of bound\n",
+           holdover.getCount(), holdover.getViolations(), holdover.getWorstRatio());
+
+    if (argc > 1)
+    {
+        return 0;
+    }
+    CHECK(holdover.getCount() >= 20);
+    CHECK_EQ(holdover.getViolations(), 0);
+    CHECK(holdover.getWorstRatio() < 1.0);
+    return TEST_RESULT();
+}
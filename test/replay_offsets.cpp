@@ -0,0 +1,252 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+//
+// Offline replay of a recorded offset log through both sync engines.  The log is
+// one sample per line: seconds, RTC - GPS offset (us) and the aging value that was
+// in effect, separated by spaces or commas ('#' starts a comment).  The natural
+// drift of the RTC is whatever the recording shows with the recorded aging taken
+// out, so each engine sees the recorded offset plus the effect of the difference
+// between its aging value and the recorded one:
+//
+//   offset(t) = recorded(t) + gain * sum((aging - recorded aging) * dt)
+//
+// Each engine is run the way SyncManager runs it, the PID on the filtered offset
+// window and the Kalman filter on the last sample with the window variance, and
+// the time to settle and the RMS error after that are compared.
+//
+//   replay_offsets [log]
+//
+// Without a log a synthetic free running recording is replayed and both engines
+// must settle, which is how it runs as a test.
+//
+#include "PIDControl.h"
+#include "ClockKalman.h"
+#include "OffsetFilter.h"
+#include "check.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// as in SyncManager
+#define GAIN                0.1     // ppm/LSB
+#define WINDOW              10
+#define INTEGRAL_LIMIT_PPM  6.4
+#define KALMAN_TAU          30.0
+#define KALMAN_VARIANCE_MIN 0.01
+#define SETTLE_ERROR        1.0
+#define SETTLE_COUNT        60
+
+// offsets are kept in the filter as ns
+#define NS_PER_US           1000.0
+
+struct Sample
+{
+    double seconds;
+    double offset;  // us
+    double aging;   // LSB
+};
+
+struct Result
+{
+    const char* engine;
+    double      settle;     // seconds, negative if never settled
+    double      rms;        // us after settling
+    uint32_t    count;      // samples in the rms
+    double      max;        // largest error after settling, us
+};
+
+static float round_aging(float output)
+{
+    output = round(output);
+    return output > 127 ? 127 : (output < -127 ? -127 : output);
+}
+
+/**
+ * replay samples through one engine, kalman or PID
+*/
+static Result replay(const std::vector<Sample>& samples, bool kalman)
+{
+    PIDControl   pid(3.2, 0.1, 0.8);
+    ClockKalman  filter(GAIN);
+    OffsetFilter offsets(WINDOW);
+    Result       result = {kalman ? "kalman" : "pid", -1, 0, 0, 0};
+
+    float  aging   = 0;
+    double shift   = 0;     // us added by our aging against the recorded aging
+    uint32_t run   = 0;
+    double sum_sq  = 0;
+    float  limit   = INTEGRAL_LIMIT_PPM / GAIN > 127.0 ? 127.0 : INTEGRAL_LIMIT_PPM / GAIN;
+
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        if (i > 0)
+        {
+            double dt = samples[i].seconds - samples[i-1].seconds;
+            shift += GAIN * (aging - samples[i-1].aging) * dt;
+        }
+        double offset = samples[i].offset + shift;
+        offsets.add((int32_t)lround(offset * NS_PER_US));
+        if (!offsets.isFull())
+        {
+            continue;
+        }
+        float estimate = offsets.getEstimate() / NS_PER_US;
+        float error    = 0 - estimate;
+
+        if (kalman)
+        {
+            float dt       = filter.isValid() ? samples[i].seconds - samples[i-1].seconds : 0;
+            float variance = offsets.getVariance() / (NS_PER_US * NS_PER_US);
+            if (variance < KALMAN_VARIANCE_MIN)
+            {
+                variance = KALMAN_VARIANCE_MIN;
+            }
+            if (filter.update(offset, variance, aging, dt))
+            {
+                aging = round_aging(filter.getControl(0, KALMAN_TAU));
+            }
+        }
+        else
+        {
+            aging = round_aging(pid.update(error, 0, limit));
+        }
+
+        // the same settling and RMS as SyncManager::recordControlStats
+        if (result.settle < 0)
+        {
+            run = fabs(error) < SETTLE_ERROR ? run + 1 : 0;
+            if (run >= SETTLE_COUNT)
+            {
+                result.settle = samples[i].seconds - samples[0].seconds;
+            }
+            continue;
+        }
+        sum_sq       += error * error;
+        result.count += 1;
+        if (fabs(error) > result.max)
+        {
+            result.max = fabs(error);
+        }
+    }
+    result.rms = result.count > 0 ? sqrt(sum_sq / result.count) : 0;
+    return result;
+}
+
+static bool load(const char* path, std::vector<Sample>* samplesp)
+{
+    FILE* f = fopen(path, "r");
+    if (f == nullptr)
+    {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f) != nullptr)
+    {
+        char* comment = strchr(line, '#');
+        if (comment != nullptr)
+        {
+            *comment = '\0';
+        }
+        for (char* p = line; *p != '\0'; ++p)
+        {
+            if (*p == ',')
+            {
+                *p = ' ';
+            }
+        }
+        Sample s;
+        if (sscanf(line, "%lf %lf %lf", &s.seconds, &s.offset, &s.aging) == 3)
+        {
+            samplesp->push_back(s);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/**
+ * three hours of a free running RTC: 20us off, 1.2ppm fast with a slow frequency
+ * wander and 0.3us of white phase noise on the PPS edges.
+*/
+static void synthesize(std::vector<Sample>* samplesp)
+{
+    uint32_t seed  = 12345;
+    double   phase = 20.0;
+    for (int t = 0; t < 3 * 3600; ++t)
+    {
+        double freq = -1.2 + 0.05 * sin(t * 2.0 * M_PI / 3600.0);
+        phase += freq;
+        seed = seed * 1103515245 + 12345;
+        double u1 = ((seed >> 8) & 0xffff) / 65536.0 + 1e-9;
+        seed = seed * 1103515245 + 12345;
+        double u2 = ((seed >> 8) & 0xffff) / 65536.0;
+        double noise = 0.3 * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+        samplesp->push_back({(double)t, phase + noise, 0});
+    }
+}
+
+static void report(const Result& r)
+{
+    if (r.settle < 0)
+    {
+        printf("%-7s did not settle\n", r.engine);
+        return;
+    }
+    printf("%-7s settled in %6.0fs rms=%0.3fus max=%0.3fus (%u samples)\n", r.engine, r.settle, r.rms, r.max, r.count);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<Sample> samples;
+    if (argc > 1)
+    {
+        if (!load(argv[1], &samples))
+        {
+            return 2;
+        }
+    }
+    else
+    {
+        synthesize(&samples);
+    }
+    printf("%zu samples\n", samples.size());
+
+    Result pid    = replay(samples, false);
+    Result kalman = replay(samples, true);
+    report(pid);
+    report(kalman);
+
+    if (argc > 1)
+    {
+        return 0;
+    }
+    CHECK(pid.settle >= 0 && pid.settle < 3600);
+    CHECK(kalman.settle >= 0 && kalman.settle < 3600);
+    CHECK(pid.rms < SETTLE_ERROR);
+    CHECK(kalman.rms < SETTLE_ERROR);
+    return TEST_RESULT();
+}
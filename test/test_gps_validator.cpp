@@ -0,0 +1,268 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+//
+// GPSValidator replayed with per second evidence from a receiver as it starts,
+// loses the PPS or fix, steps and comes back, checking the valid decision and the
+// reason given at each step.
+//
+#include "GPSValidator.h"
+#include "check.h"
+#include <string.h>
+
+static const GPSValidator::Thresholds thresholds =
+{
+    .seconds            = 10,
+    .revalidate_seconds = 3,
+    .revalidate_window  = 1800,
+    .min_fix_type       = 3,
+    .min_sats           = 4,
+    .max_position_error = 50,
+    .max_jitter         = 10,
+    .max_interval_error = 100,
+    .utc_wait_seconds   = 1200,
+};
+
+// a receiver with a good fix and a clean PPS, each step() is the next second
+class Receiver
+{
+public:
+    GPSValidator::Evidence e;
+
+    Receiver()
+    {
+        e.rmc_valid      = true;
+        e.rmc_time       = 1600000000;
+        e.zda_time       = 0;
+        e.pps_second     = 1600000000;
+        e.pps_fresh      = true;
+        e.pps_interval   = 1000000.0;
+        e.fix_type       = 3;
+        e.sats           = 8;
+        e.position_error = 5.0;
+        e.utc            = GPSValidator::UTC_VALID;
+    }
+
+    bool step(GPSValidator& validator)
+    {
+        e.rmc_time   += 1;
+        e.pps_second += 1;
+        if (e.zda_time != 0)
+        {
+            e.zda_time = e.rmc_time;
+        }
+        return validator.update(e);
+    }
+
+    // seconds until valid, 0 if not within max
+    uint32_t untilValid(GPSValidator& validator, uint32_t max)
+    {
+        for (uint32_t i = 1; i <= max; ++i)
+        {
+            if (step(validator))
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+};
+
+static void test_becomes_valid()
+{
+    GPSValidator validator(thresholds);
+    Receiver rx;
+    CHECK(strcmp(validator.getReason(), "starting") == 0);
+    for (int i = 0; i < 9; ++i)
+    {
+        CHECK(!rx.step(validator));
+        CHECK(strcmp(validator.getReason(), "checking") == 0);
+        CHECK_EQ(validator.getConsistent(), i + 1);
+    }
+    CHECK(rx.step(validator));
+    CHECK(validator.isValid());
+    CHECK(validator.isValidated());
+    CHECK(strcmp(validator.getReason(), "consistent") == 0);
+}
+
+static void test_utc_status()
+{
+    // leap seconds still the firmware default, never valid
+    GPSValidator pending(thresholds);
+    Receiver rx;
+    rx.e.utc = GPSValidator::UTC_PENDING;
+    CHECK_EQ(rx.untilValid(pending, 100), 0);
+    CHECK(strcmp(pending.getReason(), "leap seconds unknown") == 0);
+    rx.e.utc = GPSValidator::UTC_VALID;
+    CHECK_EQ(rx.untilValid(pending, 100), 10);
+
+    // a receiver that doesn't say needs the long wait
+    GPSValidator unknown(thresholds);
+    Receiver rx2;
+    rx2.e.utc = GPSValidator::UTC_UNKNOWN;
+    CHECK_EQ(unknown.getRequired(), 1200);
+    CHECK_EQ(rx2.untilValid(unknown, 2000), 1200);
+
+    // once the receiver has said UTC is valid the normal count applies
+    GPSValidator seen(thresholds);
+    Receiver rx3;
+    rx3.step(seen);
+    rx3.e.utc = GPSValidator::UTC_UNKNOWN;
+    CHECK_EQ(rx3.untilValid(seen, 100), 9);
+
+    // losing the leap seconds ends validity
+    rx3.e.utc = GPSValidator::UTC_PENDING;
+    CHECK(!rx3.step(seen));
+    CHECK(!seen.isValid());
+}
+
+static void test_gates()
+{
+    struct
+    {
+        const char* reason;
+        void (*bad)(GPSValidator::Evidence*);
+    } gates[] = {
+        {"PPS interval",       [](GPSValidator::Evidence* e) { e->pps_interval = 1000200.0; }},
+        {"no 3D fix",          [](GPSValidator::Evidence* e) { e->fix_type = 2; }},
+        {"too few satellites", [](GPSValidator::Evidence* e) { e->sats = 3; }},
+        {"position error",     [](GPSValidator::Evidence* e) { e->position_error = 60.0; }},
+    };
+    for (auto& gate : gates)
+    {
+        GPSValidator validator(thresholds);
+        Receiver rx;
+        for (int i = 0; i < 5; ++i)
+        {
+            rx.step(validator);
+        }
+        gate.bad(&rx.e);
+        CHECK(!rx.step(validator));
+        CHECK(strcmp(validator.getReason(), gate.reason) == 0);
+        CHECK_EQ(validator.getConsistent(), 0);
+
+        // once valid the fix quality is not checked again
+        Receiver good;
+        GPSValidator valid(thresholds);
+        CHECK_EQ(good.untilValid(valid, 10), 10);
+        gate.bad(&good.e);
+        CHECK(good.step(valid));
+    }
+
+    // an unknown position error is not a reason to reject
+    GPSValidator validator(thresholds);
+    Receiver rx;
+    rx.e.position_error = -1;
+    CHECK_EQ(rx.untilValid(validator, 10), 10);
+}
+
+static void test_jitter()
+{
+    GPSValidator validator(thresholds);
+    Receiver rx;
+    rx.step(validator);
+    rx.e.pps_interval = 1000020.0;
+    CHECK(!rx.step(validator));
+    CHECK(strcmp(validator.getReason(), "PPS jitter") == 0);
+    // a steady offset interval is fine
+    CHECK_EQ(rx.untilValid(validator, 20), 10);
+}
+
+static void test_invalidation()
+{
+    GPSValidator validator(thresholds);
+    Receiver rx;
+    CHECK_EQ(rx.untilValid(validator, 10), 10);
+
+    // a missed PPS, back after 3 seconds as the receiver was valid recently
+    rx.e.pps_fresh = false;
+    CHECK(!rx.step(validator));
+    CHECK(strcmp(validator.getReason(), "no PPS") == 0);
+    rx.e.pps_fresh = true;
+    CHECK_EQ(validator.getRequired(), 3);
+    CHECK_EQ(rx.untilValid(validator, 10), 3);
+
+    // receiver not valid
+    rx.e.rmc_valid = false;
+    CHECK(!rx.step(validator));
+    CHECK(strcmp(validator.getReason(), "receiver not valid") == 0);
+    rx.e.rmc_valid = true;
+    CHECK_EQ(rx.untilValid(validator, 10), 3);
+
+    // the RMC time steps against the PPS count
+    rx.e.rmc_time += 1;
+    CHECK(!rx.step(validator));
+    CHECK(strcmp(validator.getReason(), "time step against PPS") == 0);
+    CHECK_EQ(rx.untilValid(validator, 10), 3);
+
+    // unless the PPS second was just set from it
+    rx.e.pps_second = rx.e.rmc_time + 1;
+    validator.ppsSet();
+    CHECK(rx.step(validator));
+
+    // ZDA and RMC disagree
+    rx.e.zda_time = rx.e.rmc_time;
+    CHECK(rx.step(validator));
+    rx.e.zda_time -= 1;
+    rx.e.rmc_time += 1;
+    rx.e.pps_second += 1;
+    CHECK(!validator.update(rx.e));
+    CHECK(strcmp(validator.getReason(), "ZDA and RMC disagree") == 0);
+}
+
+static void test_revalidate_window()
+{
+    GPSValidator validator(thresholds);
+    Receiver rx;
+    CHECK_EQ(rx.untilValid(validator, 10), 10);
+
+    // an outage longer than the window needs the full check again
+    rx.e.rmc_valid = false;
+    for (uint32_t i = 0; i <= thresholds.revalidate_window + 1; ++i)
+    {
+        rx.step(validator);
+    }
+    rx.e.rmc_valid = true;
+    CHECK_EQ(validator.getRequired(), 10);
+    CHECK_EQ(rx.untilValid(validator, 20), 10);
+
+    // after a soft reset a validated receiver only needs the short check
+    GPSValidator resumed(thresholds);
+    resumed.setValidated();
+    Receiver rx2;
+    rx2.e.utc = GPSValidator::UTC_UNKNOWN;
+    CHECK_EQ(rx2.untilValid(resumed, 20), 3);
+}
+
+int main()
+{
+    RUN_TEST(test_becomes_valid);
+    RUN_TEST(test_utc_status);
+    RUN_TEST(test_gates);
+    RUN_TEST(test_jitter);
+    RUN_TEST(test_invalidation);
+    RUN_TEST(test_revalidate_window);
+    return TEST_RESULT();
+}
@@ -0,0 +1,194 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+//
+// Holdover replayed second by second through lock, holdover, reacquire and the
+// measured error, checking the state transitions, the growth of the error bound
+// and the NTP stratum (and so the leap indicator) it maps to.
+//
+#include "Holdover.h"
+#include "check.h"
+
+#define AGING_RATE      0.0001  // ppm/s
+#define FREQ_ERROR      0.05    // ppm
+#define STRATUM_BOUND   100.0   // us
+#define MAX_BOUND       10000.0 // us
+
+static uint8_t stratum(const Holdover& holdover)
+{
+    return Holdover::getStratum(holdover.getState() != Holdover::UNLOCKED, holdover.getErrorBound(),
+                                1, STRATUM_BOUND, MAX_BOUND);
+}
+
+static float expected_bound(float start_bound, uint32_t t)
+{
+    return start_bound + FREQ_ERROR * t + 0.5 * AGING_RATE * t * t;
+}
+
+static void test_unlocked()
+{
+    Holdover holdover(AGING_RATE);
+    CHECK_EQ(holdover.getState(), Holdover::UNLOCKED);
+    CHECK(!holdover.enter(10, 5.0, 0.0, FREQ_ERROR));
+    CHECK_EQ(holdover.getState(), Holdover::UNLOCKED);
+    CHECK_EQ(stratum(holdover), 16);
+    holdover.reacquire();
+    holdover.measure(3.0);
+    CHECK_EQ(holdover.getState(), Holdover::UNLOCKED);
+    CHECK_EQ(holdover.getCount(), 0);
+}
+
+static void test_holdover_replay()
+{
+    Holdover holdover(AGING_RATE);
+    holdover.lock(0.5);
+    CHECK_EQ(holdover.getState(), Holdover::LOCKED);
+    CHECK_EQ(stratum(holdover), 1);
+    CHECK_EQ(holdover.getElapsed(100), 0);
+
+    const uint32_t start = 1000;
+    CHECK(holdover.enter(start, 10.0, 0.001, FREQ_ERROR));
+    CHECK_EQ(holdover.getState(), Holdover::HOLDOVER);
+    CHECK(holdover.isHolding());
+    CHECK(!holdover.enter(start + 1, 10.0, 0.001, FREQ_ERROR));
+
+    // the bound grows every second, linearly with the frequency error and
+    // quadratically with the aging, the stratum drops as it passes the limits
+    uint32_t stratum2_at = 0;
+    uint32_t stratum16_at = 0;
+    float    previous = holdover.getErrorBound();
+    for (uint32_t t = 1; t <= 20000; ++t)
+    {
+        holdover.update(start + t, FREQ_ERROR);
+        float bound = holdover.getErrorBound();
+        CHECK(bound > previous);
+        previous = bound;
+        if (t % 1000 == 0)
+        {
+            CHECK_NEAR(bound, expected_bound(0.5, t), expected_bound(0.5, t) * 1e-4);
+        }
+        if (stratum2_at == 0 && stratum(holdover) == 2)
+        {
+            stratum2_at = t;
+        }
+        if (stratum16_at == 0 && stratum(holdover) == 16)
+        {
+            stratum16_at = t;
+        }
+    }
+    CHECK(stratum2_at > 0 && expected_bound(0.5, stratum2_at - 1) <= STRATUM_BOUND);
+    CHECK(expected_bound(0.5, stratum2_at) > STRATUM_BOUND);
+    CHECK(stratum16_at > 0 && expected_bound(0.5, stratum16_at - 1) <= MAX_BOUND * 1.0001);
+    CHECK(expected_bound(0.5, stratum16_at) > MAX_BOUND * 0.9999);
+    CHECK_EQ(holdover.getElapsed(start + 20000), 20000);
+
+    // the held output follows the drift
+    CHECK_NEAR(holdover.getOutput(start + 5000), 10.0 + 0.001 * 5000, 1e-3);
+}
+
+static void test_reacquire()
+{
+    Holdover holdover(AGING_RATE);
+    holdover.lock(1.0);
+    const uint32_t start = 50;
+    holdover.enter(start, 0.0, 0.0, FREQ_ERROR);
+    for (uint32_t t = 1; t <= 600; ++t)
+    {
+        holdover.update(start + t, FREQ_ERROR);
+    }
+    holdover.reacquire();
+    CHECK_EQ(holdover.getState(), Holdover::REACQUIRE);
+    CHECK(holdover.isHolding());
+
+    // locking does not end the holdover, the bound keeps growing until measured
+    holdover.lock(0.1);
+    CHECK_EQ(holdover.getState(), Holdover::REACQUIRE);
+    holdover.update(start + 610, FREQ_ERROR);
+    CHECK_NEAR(holdover.getErrorBound(), expected_bound(1.0, 610), 1e-2);
+
+    // lost again before measured carries on from the first holdover
+    CHECK(holdover.enter(start + 620, 99.0, 0.0, FREQ_ERROR));
+    CHECK_EQ(holdover.getState(), Holdover::HOLDOVER);
+    CHECK_NEAR(holdover.getErrorBound(), expected_bound(1.0, 620), 1e-2);
+    CHECK_NEAR(holdover.getOutput(start + 620), 0.0, 1e-6);
+
+    // a measured error inside the bound
+    holdover.reacquire();
+    float bound = holdover.getErrorBound();
+    holdover.measure(-bound / 2);
+    CHECK_EQ(holdover.getState(), Holdover::LOCKED);
+    CHECK_EQ(holdover.getCount(), 1);
+    CHECK_EQ(holdover.getViolations(), 0);
+    CHECK_EQ(holdover.getLastDuration(), 620);
+    CHECK_NEAR(holdover.getLastBound(), bound, 1e-6);
+    CHECK_NEAR(holdover.getLastError(), bound / 2, 1e-6);
+    CHECK_NEAR(holdover.getWorstRatio(), 0.5, 1e-6);
+    CHECK_NEAR(holdover.getErrorBound(), bound / 2, 1e-6);
+
+    // and one outside it
+    holdover.enter(start + 1000, 0.0, 0.0, FREQ_ERROR);
+    holdover.update(start + 1010, FREQ_ERROR);
+    holdover.reacquire();
+    bound = holdover.getErrorBound();
+    holdover.measure(bound * 2);
+    CHECK_EQ(holdover.getCount(), 2);
+    CHECK_EQ(holdover.getViolations(), 1);
+    CHECK_NEAR(holdover.getWorstRatio(), 2.0, 1e-6);
+}
+
+static void test_resume()
+{
+    Holdover holdover(AGING_RATE);
+    holdover.resume(5, 12.0, 0.0, 40.0);
+    CHECK_EQ(holdover.getState(), Holdover::HOLDOVER);
+    CHECK_NEAR(holdover.getErrorBound(), 40.0, 1e-6);
+    CHECK_EQ(stratum(holdover), 1);
+    holdover.update(105, FREQ_ERROR);
+    CHECK_NEAR(holdover.getErrorBound(), expected_bound(40.0, 100), 1e-3);
+    CHECK_NEAR(holdover.getOutput(105), 12.0, 1e-6);
+}
+
+static void test_stratum_mapping()
+{
+    CHECK_EQ(Holdover::getStratum(false, 0.0, 1, STRATUM_BOUND, MAX_BOUND), 16);
+    CHECK_EQ(Holdover::getStratum(true, 0.0, 1, STRATUM_BOUND, MAX_BOUND), 1);
+    CHECK_EQ(Holdover::getStratum(true, STRATUM_BOUND, 1, STRATUM_BOUND, MAX_BOUND), 1);
+    CHECK_EQ(Holdover::getStratum(true, STRATUM_BOUND + 1, 1, STRATUM_BOUND, MAX_BOUND), 2);
+    CHECK_EQ(Holdover::getStratum(true, MAX_BOUND, 1, STRATUM_BOUND, MAX_BOUND), 2);
+    CHECK_EQ(Holdover::getStratum(true, MAX_BOUND + 1, 1, STRATUM_BOUND, MAX_BOUND), 16);
+    // a peer reference keeps its own stratum until the bound is too large
+    CHECK_EQ(Holdover::getStratum(true, STRATUM_BOUND + 1, 3, STRATUM_BOUND, MAX_BOUND), 3);
+    CHECK_EQ(Holdover::getStratum(true, MAX_BOUND + 1, 3, STRATUM_BOUND, MAX_BOUND), 16);
+}
+
+int main()
+{
+    RUN_TEST(test_unlocked);
+    RUN_TEST(test_holdover_replay);
+    RUN_TEST(test_reacquire);
+    RUN_TEST(test_resume);
+    RUN_TEST(test_stratum_mapping);
+    return TEST_RESULT();
+}
@@ -0,0 +1,263 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+//
+// PPSModel driven with synthetic edge sequences, the model is the reference for
+// highint5.S so these pin down what the ISR does to pps_data_t.
+//
+#include "PPSModel.h"
+#include "check.h"
+#include <string.h>
+
+#define TICKS_PER_SEC 1000000
+#define FIRST_STATS   12    // edges before the stats are kept (PPS_FIRST_STATS_TIME)
+
+static const PPSModel model(TICKS_PER_SEC);
+
+static void init(pps_data_t* data)
+{
+    memset(data, 0, sizeof(*data));
+}
+
+/**
+ * feed count edges interval ticks apart starting after *timerp, returns the
+ * number of top of second edges.
+*/
+static uint32_t run(pps_data_t* data, uint32_t* timerp, uint32_t interval, uint32_t count)
+{
+    uint32_t tops = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        *timerp += interval;
+        if (model.edge(data, *timerp))
+        {
+            tops += 1;
+        }
+    }
+    return tops;
+}
+
+static void test_one_hz()
+{
+    pps_data_t data;
+    init(&data);
+    uint32_t timer = 1000;
+
+    // no stats until the seconds counter could have been set
+    CHECK_EQ(run(&data, &timer, TICKS_PER_SEC, FIRST_STATS), FIRST_STATS);
+    CHECK_EQ(data.pps_time, FIRST_STATS);
+    CHECK_EQ(data.pps_last, timer);
+    CHECK_EQ(data.pps_interval, 0);
+    CHECK_EQ(data.pps_min, 0);
+    CHECK_EQ(data.pps_max, 0);
+
+    run(&data, &timer, TICKS_PER_SEC + 3, 1);
+    run(&data, &timer, TICKS_PER_SEC - 2, 1);
+    run(&data, &timer, TICKS_PER_SEC, 1);
+    CHECK_EQ(data.pps_time, FIRST_STATS + 3);
+    CHECK_EQ(data.pps_interval, TICKS_PER_SEC);
+    CHECK_EQ(data.pps_min, TICKS_PER_SEC - 2);
+    CHECK_EQ(data.pps_max, TICKS_PER_SEC + 3);
+    CHECK_EQ(data.pps_short, 0);
+    CHECK_EQ(data.pps_long, 0);
+    // every update is bracketed by two generation increments
+    CHECK_EQ(data.pps_gen, 2 * (FIRST_STATS + 3));
+}
+
+static void test_wrap_around()
+{
+    pps_data_t data;
+    init(&data);
+    uint32_t timer = 0xffffffff - (FIRST_STATS + 2) * TICKS_PER_SEC + 17;
+
+    run(&data, &timer, TICKS_PER_SEC, FIRST_STATS);
+    CHECK_EQ(run(&data, &timer, TICKS_PER_SEC + 1, 5), 5);
+    CHECK(timer < TICKS_PER_SEC * 4);   // the timer wrapped
+    CHECK_EQ(data.pps_interval, TICKS_PER_SEC + 1);
+    CHECK_EQ(data.pps_min, TICKS_PER_SEC + 1);
+    CHECK_EQ(data.pps_max, TICKS_PER_SEC + 1);
+    CHECK_EQ(data.pps_short, 0);
+    CHECK_EQ(data.pps_long, 0);
+}
+
+static void test_missing_pulse()
+{
+    pps_data_t data;
+    init(&data);
+    uint32_t timer = 0;
+    run(&data, &timer, TICKS_PER_SEC, FIRST_STATS + 2);
+
+    // a missed edge is a long interval, it is counted and not taken as the max
+    run(&data, &timer, 2 * TICKS_PER_SEC, 1);
+    CHECK_EQ(data.pps_long, 1);
+    CHECK_EQ(data.pps_short, 0);
+    CHECK_EQ(data.pps_max, 0);
+    CHECK_EQ(data.pps_interval, 2 * TICKS_PER_SEC);
+    CHECK_EQ(data.pps_time, FIRST_STATS + 3);
+
+    run(&data, &timer, TICKS_PER_SEC, 1);
+    CHECK_EQ(data.pps_max, TICKS_PER_SEC);
+
+    // a glitch is a short interval, counted and not taken as the min
+    run(&data, &timer, TICKS_PER_SEC / 2, 1);
+    CHECK_EQ(data.pps_short, 1);
+    CHECK_EQ(data.pps_min, 0);
+    run(&data, &timer, TICKS_PER_SEC / 2, 1);
+    CHECK_EQ(data.pps_short, 2);
+    run(&data, &timer, TICKS_PER_SEC, 1);
+    CHECK_EQ(data.pps_min, TICKS_PER_SEC);
+
+    // the limits are 500us either side of a second
+    run(&data, &timer, model.getLongValue() - 1, 1);
+    run(&data, &timer, model.getShortValue() + 1, 1);
+    CHECK_EQ(data.pps_long, 1);
+    CHECK_EQ(data.pps_short, 2);
+    run(&data, &timer, model.getLongValue(), 1);
+    run(&data, &timer, model.getShortValue(), 1);
+    CHECK_EQ(data.pps_long, 2);
+    CHECK_EQ(data.pps_short, 3);
+}
+
+static void test_disabled()
+{
+    pps_data_t data;
+    init(&data);
+    uint32_t timer = 0;
+    run(&data, &timer, TICKS_PER_SEC, FIRST_STATS + 2);
+
+    data.pps_disabled = 1;
+    pps_data_t before = data;
+    CHECK_EQ(run(&data, &timer, TICKS_PER_SEC, 3), 0);
+    model.clear(&data, timer + 100);
+    CHECK(memcmp(&before, &data, sizeof(data)) == 0);
+
+    // re-enabled the first interval covers the disabled edges
+    data.pps_disabled = 0;
+    run(&data, &timer, TICKS_PER_SEC, 1);
+    CHECK_EQ(data.pps_interval, 4 * TICKS_PER_SEC);
+    CHECK_EQ(data.pps_long, 1);
+    CHECK_EQ(data.pps_time, FIRST_STATS + 3);
+}
+
+static void test_reference_offset()
+{
+    pps_data_t gps;
+    pps_data_t rtc;
+    init(&gps);
+    init(&rtc);
+    rtc.pps_ref = &gps;
+    uint32_t gps_timer = 0;
+    uint32_t rtc_timer = 250;
+    run(&gps, &gps_timer, TICKS_PER_SEC, FIRST_STATS);
+    run(&rtc, &rtc_timer, TICKS_PER_SEC, FIRST_STATS);
+
+    run(&gps, &gps_timer, TICKS_PER_SEC, 1);
+    run(&rtc, &rtc_timer, TICKS_PER_SEC, 1);
+    CHECK_EQ(rtc.pps_offset, 250);
+
+    // an RTC edge just before the GPS edge wraps to a negative offset
+    rtc_timer = gps_timer + TICKS_PER_SEC - 300 - TICKS_PER_SEC;
+    run(&gps, &gps_timer, TICKS_PER_SEC, 1);
+    run(&rtc, &rtc_timer, TICKS_PER_SEC, 1);
+    CHECK_EQ(rtc.pps_offset, -300);
+    CHECK_EQ(gps.pps_offset, 0);    // no reference
+}
+
+static void test_sub_second()
+{
+    const uint32_t rate   = 4;
+    const uint32_t period = TICKS_PER_SEC / rate;
+    pps_data_t data;
+    init(&data);
+    data.pps_rate = rate;
+    uint32_t timer = 0;
+
+    // a new channel counts the first edges as sub second pulses, then one in
+    // every rate is a top of second
+    CHECK_EQ(run(&data, &timer, period, rate - 1), 0);
+    CHECK_EQ(data.pps_time, 0);
+    CHECK_EQ(run(&data, &timer, period, 1), 1);
+    CHECK_EQ(run(&data, &timer, period, rate * (FIRST_STATS + 2)), FIRST_STATS + 2);
+    CHECK_EQ(data.pps_time, FIRST_STATS + 3);
+    CHECK_EQ(data.pps_interval, TICKS_PER_SEC);
+    CHECK_EQ(data.pps_sub, 0);
+
+    // the sub second phases of the last full second are 1, 2 and 3 periods
+    CHECK_EQ(data.pps_avg_count, rate - 1);
+    CHECK_EQ(data.pps_avg_hi, 0);
+    CHECK_EQ(data.pps_avg_lo, period * (1 + 2 + 3));
+    CHECK_EQ(data.pps_phase_count, 0);
+
+    // moving the top of second by a pulse makes the next second one pulse short
+    data.pps_sub_adjust = 1;
+    uint32_t last = data.pps_last;
+    CHECK_EQ(run(&data, &timer, period, rate), 1);
+    CHECK_EQ(data.pps_sub_adjust, 0);
+    CHECK_EQ(data.pps_sub, 1);
+    CHECK_EQ(data.pps_last, last + TICKS_PER_SEC);
+    CHECK_EQ(run(&data, &timer, period, rate - 1), 1);
+    CHECK_EQ(data.pps_last, last + TICKS_PER_SEC + (rate - 1) * period);
+    CHECK_EQ(data.pps_avg_count, rate - 2);
+}
+
+static void test_phase_carry()
+{
+    // the phase sum is 64 bits, the low word carries into the high word
+    pps_data_t data;
+    init(&data);
+    data.pps_rate     = 2;
+    data.pps_phase_lo = 0xffffff00;
+    uint32_t timer = 0;
+    CHECK_EQ(run(&data, &timer, TICKS_PER_SEC / 2, 1), 0);  // sub second pulse
+    CHECK_EQ(data.pps_phase_hi, 1);
+    CHECK_EQ(data.pps_phase_lo, (uint32_t)(0xffffff00 + TICKS_PER_SEC / 2));
+    CHECK_EQ(data.pps_phase_count, 1);
+}
+
+static void test_clear_edge()
+{
+    pps_data_t data;
+    init(&data);
+    uint32_t timer = 0;
+    run(&data, &timer, TICKS_PER_SEC, 2);
+    model.clear(&data, timer + 100000);
+    CHECK_EQ(data.pps_clear_last, timer + 100000);
+    CHECK_EQ(data.pps_width, 100000);
+    CHECK_EQ(data.pps_time, 2);
+    CHECK_EQ(data.pps_gen, 2 * 3);
+}
+
+int main()
+{
+    RUN_TEST(test_one_hz);
+    RUN_TEST(test_wrap_around);
+    RUN_TEST(test_missing_pulse);
+    RUN_TEST(test_disabled);
+    RUN_TEST(test_reference_offset);
+    RUN_TEST(test_sub_second);
+    RUN_TEST(test_phase_carry);
+    RUN_TEST(test_clear_edge);
+    return TEST_RESULT();
+}
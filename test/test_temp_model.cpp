@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Christopher B. Liebman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+//
+// TempModel replayed with a synthetic temperature sweep of settled aging values,
+// checking when bins become usable, the interpolation between them and the
+// extrapolation past the learned range.
+//
+#include "TempModel.h"
+#include "check.h"
+
+// residual of a compensated crystal, LSB of aging against C
+static float curve(float temp)
+{
+    return 3.0 - 0.02 * (temp - 25.0) * (temp - 25.0);
+}
+
+static void test_empty()
+{
+    TempModel model;
+    float aging = 123;
+    CHECK(!model.predict(25.0, &aging));
+    CHECK_NEAR(aging, 123, 0);
+    CHECK_EQ(model.getBins(), 0);
+}
+
+static void test_min_count()
+{
+    TempModel model;
+    float aging;
+    for (int i = 0; i < TempModel::MIN_COUNT - 1; ++i)
+    {
+        CHECK(model.add(20.2, 5.0));
+    }
+    CHECK(!model.predict(20.0, &aging));
+    CHECK(model.add(19.8, 5.0));
+    CHECK_EQ(model.getBins(), 1);
+    CHECK(model.predict(20.0, &aging));
+    CHECK_NEAR(aging, 5.0, 1e-6);
+
+    // one bin is used flat on both sides
+    CHECK(model.predict(-5.0, &aging));
+    CHECK_NEAR(aging, 5.0, 1e-6);
+    CHECK(model.predict(45.0, &aging));
+    CHECK_NEAR(aging, 5.0, 1e-6);
+}
+
+static void test_range()
+{
+    TempModel model;
+    CHECK(!model.add(TempModel::TEMP_MIN - 1.0, 1.0));
+    CHECK(!model.add(TempModel::TEMP_MIN + TempModel::BINS, 1.0));
+    for (int i = 0; i < TempModel::MIN_COUNT; ++i)
+    {
+        model.add(TempModel::TEMP_MIN, 1.0);
+        model.add(TempModel::TEMP_MIN + TempModel::BINS - 1, 2.0);
+    }
+    float aging;
+    CHECK(model.predict(-100.0, &aging));
+    CHECK_NEAR(aging, 1.0, 1e-6);
+    CHECK(model.predict(100.0, &aging));
+    CHECK_NEAR(aging, 2.0, 1e-6);
+}
+
+static void test_sweep_replay()
+{
+    // a slow daily swing between 18 and 32C sampled every 16s with noise on the
+    // settled value, only every other degree is visited long enough to learn
+    TempModel model;
+    uint32_t seed = 1;
+    for (int day = 0; day < 3; ++day)
+    {
+        for (int i = 0; i < 5400; ++i)
+        {
+            float temp = 25.0 + 7.0 * sin(i * 2.0 * M_PI / 5400);
+            if (((int)floor(temp + 0.5)) % 2 != 0)
+            {
+                continue;
+            }
+            seed = seed * 1103515245 + 12345;
+            float noise = ((int)((seed >> 16) % 1000) - 500) / 2500.0;   // +-0.2
+            model.add(temp, curve(temp) + noise);
+        }
+    }
+    CHECK_EQ(model.getBins(), 8);   // 18, 20 .. 32
+
+    // learned bins average out the noise, the odd degrees are interpolated and
+    // within a learned bin the value is flat (the curve moves 0.1 in half a degree)
+    float aging;
+    for (float temp = 18.0; temp <= 32.0; temp += 0.5)
+    {
+        CHECK(model.predict(temp, &aging));
+        CHECK_NEAR(aging, curve(temp), 0.15);
+    }
+    CHECK(model.predict(21.0, &aging));
+    CHECK_NEAR(aging, curve(21.0), 0.05);
+
+    // beyond the learned range the nearest bin is used
+    CHECK(model.predict(40.0, &aging));
+    CHECK_NEAR(aging, curve(32.0), 0.1);
+    CHECK(model.predict(0.0, &aging));
+    CHECK_NEAR(aging, curve(18.0), 0.1);
+}
+
+static void test_follows_aging()
+{
+    // once a bin is full it follows a slow change instead of averaging forever
+    TempModel model;
+    for (int i = 0; i < 1000; ++i)
+    {
+        model.add(25.0, 1.0);
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        model.add(25.0, 2.0);
+    }
+    float aging;
+    CHECK(model.predict(25.0, &aging));
+    CHECK(aging > 1.9);
+}
+
+static void test_data()
+{
+    TempModel model;
+    for (int i = 0; i < TempModel::MIN_COUNT; ++i)
+    {
+        model.add(30.0, 7.0);
+    }
+    TempModel copy;
+    CHECK(copy.setData(model.getData()));
+    float aging;
+    CHECK(copy.predict(30.0, &aging));
+    CHECK_NEAR(aging, 7.0, 1e-6);
+
+    TempModel::Data bad = model.getData();
+    bad.version += 1;
+    TempModel other;
+    CHECK(!other.setData(bad));
+    CHECK_EQ(other.getBins(), 0);
+}
+
+int main()
+{
+    RUN_TEST(test_empty);
+    RUN_TEST(test_min_count);
+    RUN_TEST(test_range);
+    RUN_TEST(test_sweep_replay);
+    RUN_TEST(test_follows_aging);
+    RUN_TEST(test_data);
+    return TEST_RESULT();
+}